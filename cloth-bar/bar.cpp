@@ -5,6 +5,7 @@
 
 #include "client.hpp"
 
+#include "util/algorithm.hpp"
 #include "util/chrono.hpp"
 #include "util/logging.hpp"
 
@@ -88,24 +89,126 @@ namespace cloth::bar {
     WorkspaceSelectorWidget(Bar& bar) : bar(bar)
     {
       box.get_style_context()->add_class("workspace-selector");
-      bar.client.signals.workspace_state.connect(
-        [&](int current, int count) { update(current, count); });
+      auto& client = bar.client;
+      for (auto& [index, name] : client.workspace_names) add(index, name);
+      set_current(client.current_workspace);
+
+      client.signals.workspace_added.connect(
+        [this](int index, std::string name) { add(index, name); });
+      client.signals.workspace_removed.connect([this](int index) { remove(index); });
+      client.signals.workspace_state.connect([this](int current, int) {
+        // Until the compositor tells us about our own output, show the focused one
+        if (!has_output_state) set_current(current);
+      });
+      client.signals.output_workspace_state.connect([this](wl_output* output, int current) {
+        if (output != this->bar.output->c_ptr()) return;
+        has_output_state = true;
+        set_current(current);
+      });
     }
 
-    auto update(int current, int count) -> void
+    /// Add a button, or rename it if it exists
+    auto add(int index, const std::string& name) -> void
     {
-      if (count != buttons.size()) {
-        buttons.clear();
-        for (int i = 0; i < count; i++) {
-          auto& button = buttons.emplace_back(std::to_string(i + 1));
-          button.signal_clicked().connect([this, i] { bar.client.workspaces.switch_to(i); });
-          box.pack_start(button, false, false, 0);
-        }
+      auto label = name.empty() ? std::to_string(index + 1) : name;
+      auto [iter, inserted] = buttons.try_emplace(index, label);
+      auto& button = iter->second;
+      if (!inserted) {
+        button.set_label(label);
+        return;
       }
-      for (auto& button : buttons) {
-        button.get_style_context()->remove_class("current");
+      button.signal_clicked().connect([this, index] { bar.client.workspaces.switch_to(index); });
+      box.pack_start(button, false, false, 0);
+      box.reorder_child(button, std::distance(buttons.begin(), iter));
+      button.show();
+      if (index == current) button.get_style_context()->add_class("current");
+    }
+
+    auto remove(int index) -> void
+    {
+      buttons.erase(index);
+    }
+
+    auto set_current(int index) -> void
+    {
+      if (auto found = buttons.find(current); found != buttons.end()) {
+        found->second.get_style_context()->remove_class("current");
+      }
+      current = index;
+      if (auto found = buttons.find(current); found != buttons.end()) {
+        found->second.get_style_context()->add_class("current");
+      }
+    }
+
+    operator Gtk::Widget&()
+    {
+      return box;
+    }
+
+  private:
+    Bar& bar;
+    Gtk::Box box;
+    /// Ordered by index, like the buttons in the box
+    std::map<int, Gtk::Button> buttons;
+    int current = 0;
+    bool has_output_state = false;
+  };
+
+  /// A button for each window on the output of the bar
+  struct TaskListWidget {
+    TaskListWidget(Bar& bar) : bar(bar)
+    {
+      box.get_style_context()->add_class("task-list");
+      auto& client = bar.client;
+      for (auto& toplevel : client.toplevels) update(toplevel);
+
+      client.signals.toplevel_changed.connect([this](Toplevel& toplevel) { update(toplevel); });
+      client.signals.toplevel_closed.connect([this](Toplevel& toplevel) { buttons.erase(&toplevel); });
+    }
+
+    /// Add, relabel or remove the button of a window
+    auto update(Toplevel& toplevel) -> void
+    {
+      auto* output = bar.output->c_ptr();
+      if (!util::any_of(toplevel.outputs, [&](wl_output* o) { return o == output; })) {
+        buttons.erase(&toplevel);
+        return;
+      }
+      auto [iter, inserted] = buttons.try_emplace(&toplevel);
+      auto& button = iter->second;
+      if (inserted) {
+        button.signal_clicked().connect([this, &toplevel] { activate(toplevel); });
+        box.pack_start(button, false, false, 0);
+        button.show();
+      }
+      auto label = toplevel.title.empty() ? toplevel.app_id : toplevel.title;
+      if (label.size() > 30) {
+        label.erase(27);
+        label += "...";
+      }
+      button.set_label(label);
+      auto style = button.get_style_context();
+      if (toplevel.activated) {
+        style->add_class("active");
+      } else {
+        style->remove_class("active");
+      }
+      if (toplevel.minimized) {
+        style->add_class("minimized");
+      } else {
+        style->remove_class("minimized");
+      }
+    }
+
+    /// Focus a window, or minimize it if it has focus already
+    auto activate(Toplevel& toplevel) -> void
+    {
+      auto& client = bar.client;
+      if (toplevel.activated) {
+        toplevel.handle.set_minimized();
+      } else if (client.seat) {
+        toplevel.handle.activate(client.seat);
       }
-      buttons.at(current).get_style_context()->add_class("current");
     }
 
     operator Gtk::Widget&()
@@ -116,7 +219,7 @@ namespace cloth::bar {
   private:
     Bar& bar;
     Gtk::Box box;
-    std::vector<Gtk::Button> buttons;
+    std::map<Toplevel*, Gtk::Button> buttons;
   };
 
   struct ClockWidget {
@@ -185,7 +288,8 @@ namespace cloth::bar {
     auto& clock = *new ClockWidget();
 
     auto& workspace_selector = *new WorkspaceSelectorWidget(*this);
-    workspace_selector.update(1, 10);
+
+    auto& task_list = *new TaskListWidget(*this);
 
     auto& battery = *new widgets::Battery();
 
@@ -193,6 +297,7 @@ namespace cloth::bar {
     left.pack_start(cmd_button("M", "maximize", "win-btn"), false, false, 0);
     left.pack_start(cmd_button("C", "center", "win-btn"), false, false, 0);
     left.pack_start(focused_window, false, true, 0);
+    left.pack_start(task_list, false, false, 0);
     center.pack_start(workspace_selector, true, false, 10);
     right.pack_end(rofi_btn, false, true, 0);
     right.pack_end(vkbd_btn, false, false, 0);
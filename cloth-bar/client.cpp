@@ -1,5 +1,6 @@
 #include "client.hpp"
 
+#include "util/algorithm.hpp"
 #include "util/logging.hpp"
 
 namespace cloth::bar {
@@ -12,13 +13,35 @@ namespace cloth::bar {
       if (interface == workspaces.interface_name) {
         registry.bind(name, workspaces, version);
         workspaces.on_state() = [&] (unsigned current, unsigned count) {
+          current_workspace = current;
           signals.workspace_state.emit(current, count);
         };
+        workspaces.on_workspace_added() = [&] (unsigned index, const std::string& name) {
+          workspace_names[index] = name;
+          signals.workspace_added.emit(index, name);
+        };
+        workspaces.on_workspace_removed() = [&] (unsigned index) {
+          workspace_names.erase(index);
+          signals.workspace_removed.emit(index);
+        };
+        workspaces.on_output_state() = [&] (wl::output_t output, unsigned current) {
+          signals.output_workspace_state.emit(output.c_ptr(), current);
+        };
       } else if (interface == window_manager.interface_name) {
         registry.bind(name, window_manager, version);
         window_manager.on_focused_window_name() = [&] (const std::string& name, unsigned ws) {
           signals.focused_window_name.emit(name);
         };
+        if (window_manager.get_version() >= 2) {
+          window_manager.subscribe(wl::cloth_window_manager_event_class::focus);
+        }
+      } else if (interface == toplevel_manager.interface_name) {
+        registry.bind(name, toplevel_manager, version);
+        toplevel_manager.on_toplevel() = [&] (wl::zwlr_foreign_toplevel_handle_v1_t handle) {
+          add_toplevel(std::move(handle));
+        };
+      } else if (interface == seat.interface_name) {
+        if (!seat) registry.bind(name, seat, version);
       } else if (interface == layer_shell.interface_name) {
         registry.bind(name, layer_shell, version);
       } else if (interface == wl::output_t::interface_name) {
@@ -30,6 +53,35 @@ namespace cloth::bar {
     display.roundtrip();
   }
 
+  auto Client::add_toplevel(wl::zwlr_foreign_toplevel_handle_v1_t handle) -> void
+  {
+    using state = wl::zwlr_foreign_toplevel_handle_v1_state;
+    auto& toplevel = toplevels.emplace_back();
+    toplevel.handle = std::move(handle);
+    auto& h = toplevel.handle;
+    h.on_title() = [&toplevel] (const std::string& title) { toplevel.title = title; };
+    h.on_app_id() = [&toplevel] (const std::string& app_id) { toplevel.app_id = app_id; };
+    h.on_state() = [&toplevel] (wl::array_t array) {
+      std::vector<uint32_t> states = array;
+      auto has = [&] (state s) { return util::any_of(states, [&] (uint32_t x) { return x == uint32_t(s); }); };
+      toplevel.activated = has(state::activated);
+      toplevel.minimized = has(state::minimized);
+    };
+    h.on_output_enter() = [&toplevel] (wl::output_t output) {
+      toplevel.outputs.push_back(output.c_ptr());
+    };
+    h.on_output_leave() = [&toplevel] (wl::output_t output) {
+      auto& outputs = toplevel.outputs;
+      outputs.erase(util::remove(outputs, output.c_ptr()), outputs.end());
+    };
+    h.on_done() = [this, &toplevel] { signals.toplevel_changed.emit(toplevel); };
+    h.on_closed() = [this, &toplevel] {
+      signals.toplevel_closed.emit(toplevel);
+      // Not from inside the handler of the handle
+      Glib::signal_idle().connect_once([this, &toplevel] { util::erase_this(toplevels, &toplevel); });
+    };
+  }
+
   auto Client::dbus_main() -> void
   {
     DBus::default_dispatcher = &dispatcher;
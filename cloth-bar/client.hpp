@@ -4,6 +4,7 @@
 
 #include <gtkmm.h>
 #include <wayland-client.hpp>
+#include <map>
 #include <thread>
 
 #include <protocols.hpp>
@@ -22,6 +23,17 @@ namespace cloth::bar {
 
   namespace wl = wayland;
 
+  /// A window, as told by the foreign toplevel manager
+  struct Toplevel {
+    wl::zwlr_foreign_toplevel_handle_v1_t handle;
+    std::string title;
+    std::string app_id;
+    bool activated = false;
+    bool minimized = false;
+    /// The outputs the window is visible on
+    std::vector<wl_output*> outputs;
+  };
+
   struct Client {
     int height = 26;
     bool show_help = false;
@@ -35,13 +47,27 @@ namespace cloth::bar {
     wl::workspace_manager_t workspaces;
     wl::cloth_window_manager_t window_manager;
     wl::zwlr_layer_shell_v1_t layer_shell;
+    wl::zwlr_foreign_toplevel_manager_v1_t toplevel_manager;
+    /// The seat windows are activated on
+    wl::seat_t seat;
     util::ptr_vec<Bar> bars;
+    /// Names of the existing workspaces, by index
+    std::map<int, std::string> workspace_names;
+    int current_workspace = 0;
+    util::ptr_vec<Toplevel> toplevels;
     DBus::BusDispatcher dispatcher;
     std::thread dbus_thread;
 
     struct {
       sigc::signal<void(int, int)> workspace_state;
+      /// The workspace shown on a single output
+      sigc::signal<void(wl_output*, int)> output_workspace_state;
+      sigc::signal<void(int, std::string)> workspace_added;
+      sigc::signal<void(int)> workspace_removed;
       sigc::signal<void(std::string)> focused_window_name;
+      /// Sent once all the changes to a window are in
+      sigc::signal<void(Toplevel&)> toplevel_changed;
+      sigc::signal<void(Toplevel&)> toplevel_closed;
     } signals;
 
     Client(int argc, char* argv[])
@@ -51,6 +77,7 @@ namespace cloth::bar {
     {}
 
     auto bind_interfaces();
+    auto add_toplevel(wl::zwlr_foreign_toplevel_handle_v1_t handle) -> void;
 
     auto dbus_main() -> void;
 
@@ -1,8 +1,13 @@
+#include <poll.h>
+#include <algorithm>
+#include <deque>
+
 #include <clara.hpp>
 
 #include <wayland-client.hpp>
 #include <tablecloth-shell-protocol.hpp>
 
+#include "util/chrono.hpp"
 #include "util/logging.hpp"
 
 
@@ -16,6 +21,11 @@ namespace cloth::msg {
     bool show_help = false;
     bool listen = false;
     bool cycle_focus = false;
+    bool tree = false;
+    bool client_stats = false;
+    bool batch = false;
+    bool report = false;
+    int bench = 0;
 
     std::string commands;
 
@@ -39,6 +49,8 @@ namespace cloth::msg {
           if (listen) cloth_windows.on_focused_window_name() = [&] (const std::string& name, uint32_t ws) {
             std::cout << fmt::format("focused {}:{}", ws + 1, name) << std::endl;
           };
+          if (listen || tree) bind_tree_events();
+          if (client_stats) bind_client_stats_events();
         } else if (interface == wl::output_t::interface_name) {
           auto& output = outputs.emplace_back();
           registry.bind(name, output, version);
@@ -47,6 +59,53 @@ namespace cloth::msg {
       display.roundtrip();
     }
 
+    auto bind_tree_events() -> void
+    {
+      cloth_windows.on_output() = [&] (const std::string& name, int x, int y, int w, int h,
+                                        uint32_t ws) {
+        std::cout << fmt::format("output {} {},{} {}x{} workspace {}", name, x, y, w, h, ws + 1)
+                  << std::endl;
+      };
+      cloth_windows.on_output_removed() = [&] (const std::string& name) {
+        std::cout << fmt::format("output_removed {}", name) << std::endl;
+      };
+      cloth_windows.on_workspace() = [&] (uint32_t ws, const std::string& name,
+                                          const std::string& output, uint32_t focused) {
+        std::cout << fmt::format("workspace {} '{}' output '{}' focused {}", ws + 1, name, output,
+                                 focused)
+                  << std::endl;
+      };
+      cloth_windows.on_workspace_removed() = [&] (uint32_t ws) {
+        std::cout << fmt::format("workspace_removed {}", ws + 1) << std::endl;
+      };
+      cloth_windows.on_view() = [&] (uint32_t id, uint32_t ws, int x, int y, int w, int h,
+                                     const std::string& app_id, const std::string& title,
+                                     wl::cloth_window_manager_view_state state) {
+        std::cout << fmt::format("view {} workspace {} {},{} {}x{} state {} app_id '{}' title '{}'",
+                                 id, ws + 1, x, y, w, h, uint32_t(state), app_id, title)
+                  << std::endl;
+      };
+      cloth_windows.on_view_removed() = [&] (uint32_t id) {
+        std::cout << fmt::format("view_removed {}", id) << std::endl;
+      };
+    }
+
+    auto bind_client_stats_events() -> void
+    {
+      std::cout << fmt::format("{:>7} {:<16} {:>8} {:>10} {:>9} {:>10} {:>7}", "pid", "name",
+                               "commit/s", "damage/s", "time/s", "buffers", "limits")
+                << std::endl;
+      cloth_windows.on_client_stats() = [&] (int pid, const std::string& name, uint32_t commits,
+                                             uint32_t damage, uint32_t handler_time,
+                                             uint32_t buffer_size, uint32_t max_commit_rate,
+                                             uint32_t max_frame_rate) {
+        std::cout << fmt::format("{:>7} {:<16} {:>8} {:>8}kp {:>7}us {:>7}KiB {:>3}/{:<3}", pid,
+                                 name, commits, damage, handler_time, buffer_size, max_commit_rate,
+                                 max_frame_rate)
+                  << std::endl;
+      };
+    }
+
     auto make_cli()
     {
       // clang-format off
@@ -63,6 +122,21 @@ namespace cloth::msg {
              | Opt(listen)
                ["-l"]["--listen"]
                ("Listen for events")
+             | Opt(tree)
+               ["-t"]["--tree"]
+               ("Print all outputs, workspaces and views")
+             | Opt(client_stats)
+               ["-c"]["--clients"]
+               ("Print what each client costs the compositor")
+             | Opt(batch)
+               ["-b"]["--batch"]["--stdin"]
+               ("Run cloth commands from stdin, one per line, over one connection")
+             | Opt(report)
+               ["--report"]
+               ("With --batch, print each command once the compositor handled it")
+             | Opt(bench, "count")
+               ["--bench"]
+               ("Measure roundtrip latency and command throughput")
              | Help(show_help);
 
       // clang-format on
@@ -76,7 +150,107 @@ namespace cloth::msg {
       }
       if (cycle_focus) cloth_windows.cycle_focus();
       if (!commands.empty()) cloth_windows.run_command(commands);
+      if (cloth_windows.get_version() >= 2) {
+        using ec = wl::cloth_window_manager_event_class;
+        if (listen) cloth_windows.subscribe(ec::view | ec::workspace | ec::output | ec::focus);
+        if (tree) cloth_windows.get_tree();
+      } else if (tree) {
+        LOGE("The compositor doesn't support --tree");
+      }
+      if (client_stats) {
+        if (cloth_windows.get_version() >= 3) {
+          cloth_windows.get_client_stats();
+        } else {
+          LOGE("The compositor doesn't support --clients");
+        }
+      }
+      display.roundtrip();
+    }
+
+    /// A batched command the compositor hasn't handled yet
+    struct Pending {
+      wl::callback_t sync;
+      std::string command;
+      chrono::steady_clock::time_point sent;
+      bool done = false;
+    };
+    std::deque<Pending> pending;
+
+    /// Send the queued requests, and handle the events that came in, without waiting for any
+    auto pump() -> void
+    {
+      auto* wl_display = display.c_ptr();
+      pollfd fds = {wl_display_get_fd(wl_display), POLLOUT, 0};
+      // The socket is full, wait for the compositor to catch up
+      while (wl_display_flush(wl_display) < 0 && errno == EAGAIN) poll(&fds, 1, -1);
+
+      fds.events = POLLIN;
+      while (wl_display_prepare_read(wl_display) != 0) wl_display_dispatch_pending(wl_display);
+      if (poll(&fds, 1, 0) > 0) {
+        wl_display_read_events(wl_display);
+      } else {
+        wl_display_cancel_read(wl_display);
+      }
+      wl_display_dispatch_pending(wl_display);
+
+      while (!pending.empty() && pending.front().done) pending.pop_front();
+    }
+
+    /// Run commands from stdin. Requests are only flushed when stdin has no more input buffered
+    /// or waiting in the pipe, and there is a single roundtrip at the end.
+    /// std::cin must not be synced with stdio, or nothing ever shows as buffered
+    auto run_batch() -> void
+    {
+      std::string line;
+      int count = 0;
+      while (std::getline(std::cin, line)) {
+        auto start = line.find_first_not_of(" \t");
+        if (start == std::string::npos || line[start] == '#') continue;
+        auto command = line.substr(start);
+        cloth_windows.run_command(command);
+        if (report) {
+          // Sync callbacks are answered in order, once the requests before them are handled
+          auto& p = pending.emplace_back(Pending{display.sync(), command, chrono::steady_clock::now()});
+          p.sync.on_done() = [&p, n = count] (uint32_t) {
+            auto latency = chrono::duration<double, std::milli>(chrono::steady_clock::now() - p.sent);
+            std::cout << fmt::format("ok {} {:.3f}ms {}", n + 1, latency.count(), p.command) << std::endl;
+            p.done = true;
+          };
+        }
+        count++;
+        if (std::cin.rdbuf()->in_avail() <= 0) pump();
+      }
+      display.roundtrip();
+    }
+
+    /// Time roundtrips one at a time, then a burst of commands with a single roundtrip
+    auto run_bench() -> void
+    {
+      using namespace chrono;
+      using ms = duration<double, std::milli>;
+
+      std::vector<double> latencies;
+      for (int i = 0; i < bench; i++) {
+        auto start = steady_clock::now();
+        display.roundtrip();
+        latencies.push_back(ms(steady_clock::now() - start).count());
+      }
+      std::sort(latencies.begin(), latencies.end());
+      auto percentile = [&] (double p) { return latencies[std::min<size_t>(latencies.size() * p, latencies.size() - 1)]; };
+      std::cout << fmt::format("roundtrip: min {:.3f}ms median {:.3f}ms p99 {:.3f}ms max {:.3f}ms",
+                               latencies.front(), percentile(0.5), percentile(0.99), latencies.back())
+                << std::endl;
+
+      auto start = steady_clock::now();
+      for (int i = 0; i < bench; i++) {
+        cloth_windows.run_command("nop");
+        pump();
+      }
       display.roundtrip();
+      auto elapsed = duration<double>(steady_clock::now() - start).count();
+      std::cout << fmt::format("throughput: {} commands in {:.3f}ms, {:.0f} commands/s", bench,
+                               elapsed * 1000, bench / elapsed)
+                << std::endl;
     }
 
     int main(int argc, char* argv[])
@@ -91,6 +265,8 @@ namespace cloth::msg {
         std::cout << cli;
         return 1;
       }
+      // Before any other I/O. Gives std::cin its own buffer, which run_batch looks at
+      if (batch) std::ios::sync_with_stdio(false);
 
       bind_interfaces();
 
@@ -100,6 +276,8 @@ namespace cloth::msg {
       }
 
       send_messages();
+      if (batch) run_batch();
+      if (bench > 0) run_bench();
 
       while (listen) display.dispatch();
 
@@ -97,10 +97,7 @@ namespace cloth::notifications {
     auto image = get_image(hints, app_icon);
 
     Glib::signal_idle().connect_once([=] {
-      notifications.underlying().erase(
-        util::remove_if(notifications.underlying(),
-                        [&](auto& n_ptr) { return n_ptr->id == notification_id; }),
-        notifications.underlying().end());
+      notifications.erase_if([&](const Notification& n) { return n.id == notification_id; });
       notifications.emplace_back(*this, notification_id, summary, body, actions, urgency,
                                  expire_timeout, image);
     });
@@ -116,8 +113,7 @@ namespace cloth::notifications {
   auto NotificationServer::CloseNotification(const uint32_t& id, DBus::Error& e) -> void
   {
     Glib::signal_idle().connect_once([this, id = id] {
-      auto found = util::find_if(notifications, [id](Notification& n) { return n.id == id; });
-      if (found != notifications.end()) notifications.underlying().erase(found.data());
+      notifications.erase_if([id](const Notification& n) { return n.id == id; });
     });
   }
 
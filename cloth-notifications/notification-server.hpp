@@ -6,6 +6,7 @@
 
 #include <protocols.hpp>
 #include <util/ptr_vec.hpp>
+#include <util/slab.hpp>
 #include <util/chrono.hpp>
 
 #include <dbus-notifications-adaptor.hpp>
@@ -85,7 +86,7 @@ namespace cloth::notifications {
 
     Client& client;
 
-    util::ptr_vec<Notification> notifications;
+    util::slab_vec<Notification, 8> notifications;
 
   private:
     unsigned _id;
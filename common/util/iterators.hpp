@@ -9,6 +9,8 @@
 
 #include <type_traits>
 
+#include "algorithm.hpp"
+
 namespace cloth::util {
 
   namespace detail {
@@ -923,27 +925,28 @@ namespace cloth::util {
   ///
   /// Transform iterator
   ///
+  /// Holds a pointer to the callable, which is owned by the range it came from.
+  ///
   template<typename WrappedIter, typename Callable>
   class TransformIteratorImpl{
   public:
-    using reference = std::invoke_result_t<Callable, typename WrappedIter::reference>;
+    using reference = std::invoke_result_t<const Callable&, decltype(*std::declval<WrappedIter>())>;
     using value_type = std::decay_t<reference>;
-    using iterator_category = typename WrappedIter::iterator_category;
-
-    TransformIteratorImpl(WrappedIter iter, Callable callable)
-      : iter (std::move(iter)), callable {std::make_shared<Callable>(std::move(callable))}
-    {}
+    using pointer = std::add_pointer_t<std::remove_reference_t<reference>>;
+    using iterator_category = std::common_type_t<
+      typename std::iterator_traits<WrappedIter>::iterator_category,
+      std::bidirectional_iterator_tag>;
 
-    TransformIteratorImpl(WrappedIter iter, TransformIteratorImpl other)
-      : iter (std::move(iter)), callable {other.callable}
+    TransformIteratorImpl(WrappedIter iter, const Callable& callable)
+      : iter (std::move(iter)), callable {&callable}
     {}
 
     void advance(int n)
     {
-      std::advance(iter);
+      std::advance(iter, n);
     }
 
-    value_type& dereference()
+    reference dereference() const
     {
       return std::invoke(*callable, *iter);
     }
@@ -953,13 +956,8 @@ namespace cloth::util {
       return iter == o.iter;
     }
 
-    auto difference(const TransformIteratorImpl& o) const
-    {
-      return iter - o.iter;
-    }
-
     WrappedIter iter;
-    std::shared_ptr<Callable> callable;
+    const Callable* callable;
   };
 
   ///
@@ -970,44 +968,66 @@ namespace cloth::util {
 
   namespace view {
 
+    /// A lazy range, applying `Callable` to each element when dereferenced.
+    ///
+    /// Does not allocate. Iterators are valid as long as the range object is alive.
     template<typename Range, typename Callable>
-    auto transform(Range&& r, Callable&& c) {
-      using std::begin, std::end;
-      using transformiter = transform_iterator<decltype(begin(r)), std::decay_t<Callable>>;
-      auto first = transformiter(begin(r), std::forward<Callable>(c));
-      auto last = transformiter(end(r), first);
-      return sequence(first, last);
+    struct transform {
+      transform(Range&& r, Callable c) noexcept
+        : _range(std::forward<Range>(r)), _callable(std::move(c))
+      {}
+
+      auto begin()
+      {
+        using std::begin;
+        using iter = transform_iterator<decltype(begin(_range)), Callable>;
+        return iter(begin(_range), _callable);
+      }
+
+      auto end()
+      {
+        using std::end;
+        using iter = transform_iterator<decltype(end(_range)), Callable>;
+        return iter(end(_range), _callable);
+      }
+
+      detail::store_or_ref_t<Range&&> _range;
+      Callable _callable;
     };
+
+    template<typename Range, typename Callable>
+    transform(Range&& r, Callable c)->transform<Range&&, Callable>;
   }
 
   ///
   /// Filter iterator
   ///
+  /// Holds a pointer to the predicate, which is owned by the range it came from.
+  ///
   template<typename WrappedIter, typename Predicate>
   class FilterIterImpl{
   public:
 
-    using value_type = typename WrappedIter::value_type;
-    using iterator_category = typename WrappedIter::iterator_category;
-
-    static_assert(std::is_same_v<std::decay_t<decltype(*std::declval<WrappedIter>())>, value_type>);
-
-    FilterIterImpl(WrappedIter iter, WrappedIter last, Predicate callable)
-      : iter (std::move(iter)), last(last), callable {std::make_shared<Predicate>(std::move(callable))}
-    {}
+    using reference = decltype(*std::declval<WrappedIter>());
+    using value_type = std::decay_t<reference>;
+    using pointer = std::add_pointer_t<std::remove_reference_t<reference>>;
+    using iterator_category = std::forward_iterator_tag;
 
-    FilterIterImpl(WrappedIter iter, WrappedIter last, FilterIterImpl other)
-      : iter (std::move(iter)), last(last), callable {other.callable}
-    {}
+    FilterIterImpl(WrappedIter iter, WrappedIter last, const Predicate& predicate)
+      : iter (std::move(iter)), last(std::move(last)), predicate {&predicate}
+    {
+      skip();
+    }
 
     void advance(int n)
     {
       for (int i = 0; i < n; i++) {
-        while (++iter != last && !std::invoke(*callable, *iter) );
+        ++iter;
+        skip();
       }
     }
 
-    value_type& dereference()
+    reference dereference() const
     {
       return *iter;
     }
@@ -1017,14 +1037,16 @@ namespace cloth::util {
       return iter == o.iter;
     }
 
-    auto difference(const FilterIterImpl& o) const
-    {
-      return iter - o.iter;
-    }
-
     WrappedIter iter;
     WrappedIter last;
-    std::shared_ptr<Predicate> callable;
+    const Predicate* predicate;
+
+  private:
+    /// Move forward to the next element matching the predicate
+    void skip()
+    {
+      while (iter != last && !std::invoke(*predicate, *iter)) ++iter;
+    }
   };
 
   ///
@@ -1035,14 +1057,40 @@ namespace cloth::util {
 
   namespace view {
 
+    /// A lazy range of the elements matching `Predicate`
+    ///
+    /// Does not allocate. Iterators are valid as long as the range object is alive.
     template<typename Range, typename Predicate>
-    auto filter(Range&& r, Predicate&& c) {
-      using std::begin, std::end;
-      using filteriter = filter_iterator<decltype(begin(r)), std::decay_t<Predicate>>;
-      auto first = filteriter(begin(r), end(r), std::forward<Predicate>(c));
-      auto last = filteriter(end(r), end(r), first);
-      return sequence(first, last);
+    struct filter {
+      filter(Range&& r, Predicate p) noexcept
+        : _range(std::forward<Range>(r)), _predicate(std::move(p))
+      {}
+
+      auto begin()
+      {
+        using std::begin, std::end;
+        using iter = filter_iterator<decltype(begin(_range)), Predicate>;
+        return iter(begin(_range), end(_range), _predicate);
+      }
+
+      auto end()
+      {
+        using std::end;
+        using iter = filter_iterator<decltype(end(_range)), Predicate>;
+        return iter(end(_range), end(_range), _predicate);
+      }
+
+      auto empty()
+      {
+        return begin() == end();
+      }
+
+      detail::store_or_ref_t<Range&&> _range;
+      Predicate _predicate;
     };
+
+    template<typename Range, typename Predicate>
+    filter(Range&& r, Predicate p)->filter<Range&&, Predicate>;
   }
 
 }
@@ -634,14 +634,15 @@ namespace cloth::util {
       return push_back(v);
     }
 
-    std::unique_ptr<value_type> erase(const value_type& v)
+    /// Remove the reference. Returns the element, or nullptr if it wasn't found
+    value_type* erase(const value_type& v)
     {
       auto iter =
         std::find_if(_order.begin(), _order.end(), [&v](auto&& ptr) { return ptr == &v; });
       if (iter != _order.end()) {
-        auto uptr = std::move(*iter);
+        auto ptr = *iter;
         _order.erase(iter);
-        return uptr;
+        return ptr;
       }
       return nullptr;
     }
@@ -0,0 +1,457 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "algorithm.hpp"
+
+namespace cloth::util {
+
+  /// A weak reference to an element of a slab_vec.
+  ///
+  /// Slots are reused once their element is erased. The generation tells a stale handle apart
+  /// from one to the new occupant of the slot.
+  template<typename T>
+  struct handle {
+    static constexpr std::uint32_t invalid = ~std::uint32_t(0);
+
+    std::uint32_t index = invalid;
+    std::uint32_t generation = 0;
+
+    explicit operator bool() const noexcept
+    {
+      return index != invalid;
+    }
+
+    bool operator==(const handle& rhs) const noexcept
+    {
+      return index == rhs.index && generation == rhs.generation;
+    }
+
+    bool operator!=(const handle& rhs) const noexcept
+    {
+      return !(*this == rhs);
+    }
+  };
+
+  /// A pool backed alternative to ptr_vec, for element types that are created and destroyed often.
+  ///
+  /// Elements are stored in fixed size chunks which are never moved, so references stay valid
+  /// until the element is erased. Erased slots go on a free list and are reused, so opening and
+  /// closing things doesn't hit the allocator once the pool is warm. The order of the elements is
+  /// kept as a vector of slot indices, which supports the same reordering as ptr_vec.
+  template<typename T, std::size_t ChunkSize = 32>
+  struct slab_vec {
+    using value_type = T;
+    using handle_type = handle<T>;
+
+  private:
+    struct Slot {
+      /// Has to be the first member, see slot_of
+      std::aligned_storage_t<sizeof(T), alignof(T)> storage;
+      std::uint32_t index = 0;
+      std::uint32_t generation = 0;
+      bool alive = false;
+
+      T& get() noexcept
+      {
+        return *std::launder(reinterpret_cast<T*>(&storage));
+      }
+    };
+    static_assert(std::is_standard_layout_v<Slot>);
+
+    using Chunk = std::array<Slot, ChunkSize>;
+
+    template<bool Const, typename Iter>
+    struct basic_iterator {
+      using slab_t = std::conditional_t<Const, const slab_vec, slab_vec>;
+      using value_type = T;
+      using difference_type = typename std::iterator_traits<Iter>::difference_type;
+      using reference = std::conditional_t<Const, const T&, T&>;
+      using pointer = std::conditional_t<Const, const T*, T*>;
+      using iterator_category = std::random_access_iterator_tag;
+
+      using self_t = basic_iterator;
+
+      basic_iterator() = default;
+      basic_iterator(slab_t* slab, Iter iter) : _slab(slab), _iter(iter) {}
+
+      reference operator*() const
+      {
+        return _slab->slot(*_iter).get();
+      }
+      pointer operator->() const
+      {
+        return &**this;
+      }
+
+      self_t& operator++()
+      {
+        ++_iter;
+        return *this;
+      }
+      self_t operator++(int)
+      {
+        return {_slab, _iter++};
+      }
+      self_t& operator--()
+      {
+        --_iter;
+        return *this;
+      }
+      self_t operator--(int)
+      {
+        return {_slab, _iter--};
+      }
+
+      bool operator==(const self_t& rhs) const noexcept
+      {
+        return _iter == rhs._iter;
+      }
+      bool operator!=(const self_t& rhs) const noexcept
+      {
+        return _iter != rhs._iter;
+      }
+      bool operator<(const self_t& rhs) const noexcept
+      {
+        return _iter < rhs._iter;
+      }
+      bool operator>(const self_t& rhs) const noexcept
+      {
+        return _iter > rhs._iter;
+      }
+      bool operator<=(const self_t& rhs) const noexcept
+      {
+        return _iter <= rhs._iter;
+      }
+      bool operator>=(const self_t& rhs) const noexcept
+      {
+        return _iter >= rhs._iter;
+      }
+
+      self_t operator+(difference_type d) const noexcept
+      {
+        return {_slab, _iter + d};
+      }
+      self_t operator-(difference_type d) const noexcept
+      {
+        return {_slab, _iter - d};
+      }
+      difference_type operator-(const self_t& rhs) const noexcept
+      {
+        return _iter - rhs._iter;
+      }
+      self_t& operator+=(difference_type d)
+      {
+        _iter += d;
+        return *this;
+      }
+      self_t& operator-=(difference_type d)
+      {
+        _iter -= d;
+        return *this;
+      }
+      reference operator[](difference_type d) const
+      {
+        return *(*this + d);
+      }
+
+      const Iter& data() const noexcept
+      {
+        return _iter;
+      }
+
+    private:
+      slab_t* _slab = nullptr;
+      Iter _iter;
+    };
+
+    using order_t = std::vector<std::uint32_t>;
+
+  public:
+    using iterator = basic_iterator<false, typename order_t::iterator>;
+    using const_iterator = basic_iterator<true, typename order_t::const_iterator>;
+    using reverse_iterator = basic_iterator<false, typename order_t::reverse_iterator>;
+    using const_reverse_iterator = basic_iterator<true, typename order_t::const_reverse_iterator>;
+
+    slab_vec() = default;
+    slab_vec(slab_vec&&) = default;
+    slab_vec& operator=(slab_vec&&) = delete;
+    slab_vec(const slab_vec&) = delete;
+    slab_vec& operator=(const slab_vec&) = delete;
+
+    ~slab_vec() noexcept
+    {
+      clear();
+    }
+
+    value_type& push_back(const value_type& v)
+    {
+      return emplace_back(v);
+    }
+
+    value_type& push_back(value_type&& v)
+    {
+      return emplace_back(std::move(v));
+    }
+
+    template<typename... Args>
+    value_type& emplace_back(Args&&... args)
+    {
+      auto index = allocate();
+      auto& s = slot(index);
+      try {
+        new (&s.storage) T(std::forward<Args>(args)...);
+      } catch (...) {
+        _free.push_back(index);
+        throw;
+      }
+      s.alive = true;
+      _order.push_back(index);
+      return s.get();
+    }
+
+    /// Destroy an element. v has to be an element of this slab_vec.
+    /// Returns false if it was already erased
+    bool erase(const value_type& v)
+    {
+      auto& s = slot_of(v);
+      if (!s.alive) return false;
+      auto iter = std::find(_order.begin(), _order.end(), s.index);
+      assert(iter != _order.end());
+      _order.erase(iter);
+      destroy(s);
+      return true;
+    }
+
+    /// Destroy all elements matching the predicate. Returns how many were erased
+    template<typename Pred>
+    std::size_t erase_if(Pred&& pred)
+    {
+      std::vector<std::uint32_t> erased;
+      auto iter = std::stable_partition(_order.begin(), _order.end(), [&](std::uint32_t index) {
+        return !pred(std::as_const(slot(index).get()));
+      });
+      erased.assign(iter, _order.end());
+      _order.erase(iter, _order.end());
+      for (auto index : erased) destroy(slot(index));
+      return erased.size();
+    }
+
+    void clear() noexcept
+    {
+      auto order = std::move(_order);
+      _order.clear();
+      for (auto index : order) destroy(slot(index));
+    }
+
+    /// A handle to v, which has to be an element of this slab_vec
+    handle_type handle_of(const value_type& v) const noexcept
+    {
+      auto& s = slot_of(v);
+      return {s.index, s.generation};
+    }
+
+    /// The element the handle refers to, or nullptr if it has been erased
+    value_type* get(handle_type h) noexcept
+    {
+      if (h.index >= capacity()) return nullptr;
+      auto& s = slot(h.index);
+      if (!s.alive || s.generation != h.generation) return nullptr;
+      return &s.get();
+    }
+
+    const value_type* get(handle_type h) const noexcept
+    {
+      return const_cast<slab_vec*>(this)->get(h);
+    }
+
+    bool contains(handle_type h) const noexcept
+    {
+      return get(h) != nullptr;
+    }
+
+    iterator rotate_to_back(const value_type& v)
+    {
+      auto iter = std::find(_order.begin(), _order.end(), slot_of(v).index);
+      if (iter == _order.end()) return end();
+      return {this, std::rotate(iter, iter + 1, _order.end())};
+    }
+
+    iterator rotate_to_front(const value_type& v)
+    {
+      auto iter = std::find(_order.begin(), _order.end(), slot_of(v).index);
+      if (iter == _order.end()) return end();
+      std::rotate(_order.begin(), iter, iter + 1);
+      return begin();
+    }
+
+    std::size_t size() const noexcept
+    {
+      return _order.size();
+    }
+
+    bool empty() const noexcept
+    {
+      return _order.empty();
+    }
+
+    /// Number of slots, used or not
+    std::size_t capacity() const noexcept
+    {
+      return _chunks.size() * ChunkSize;
+    }
+
+    void reserve(std::size_t new_cap)
+    {
+      _order.reserve(new_cap);
+      _free.reserve(new_cap);
+      while (capacity() < new_cap) add_chunk();
+    }
+
+    value_type& operator[](std::size_t n)
+    {
+      return slot(_order[n]).get();
+    }
+
+    const value_type& operator[](std::size_t n) const
+    {
+      return slot(_order[n]).get();
+    }
+
+    value_type& at(std::size_t n)
+    {
+      return slot(_order.at(n)).get();
+    }
+
+    const value_type& at(std::size_t n) const
+    {
+      return slot(_order.at(n)).get();
+    }
+
+    iterator begin()
+    {
+      return {this, _order.begin()};
+    }
+    iterator end()
+    {
+      return {this, _order.end()};
+    }
+    const_iterator begin() const
+    {
+      return {this, _order.begin()};
+    }
+    const_iterator end() const
+    {
+      return {this, _order.end()};
+    }
+
+    reverse_iterator rbegin()
+    {
+      return {this, _order.rbegin()};
+    }
+    reverse_iterator rend()
+    {
+      return {this, _order.rend()};
+    }
+    const_reverse_iterator rbegin() const
+    {
+      return {this, _order.rbegin()};
+    }
+    const_reverse_iterator rend() const
+    {
+      return {this, _order.rend()};
+    }
+
+    value_type& front()
+    {
+      return slot(_order.front()).get();
+    }
+
+    value_type& back()
+    {
+      return slot(_order.back()).get();
+    }
+
+    const value_type& front() const
+    {
+      return slot(_order.front()).get();
+    }
+
+    const value_type& back() const
+    {
+      return slot(_order.back()).get();
+    }
+
+  private:
+    Slot& slot(std::uint32_t index) const noexcept
+    {
+      assert(index < capacity());
+      return (*_chunks[index / ChunkSize])[index % ChunkSize];
+    }
+
+    static Slot& slot_of(const value_type& v) noexcept
+    {
+      // The element is constructed at the start of the slot
+      return *reinterpret_cast<Slot*>(const_cast<std::remove_const_t<T>*>(&v));
+    }
+
+    void add_chunk()
+    {
+      auto first = static_cast<std::uint32_t>(capacity());
+      auto& chunk = *_chunks.emplace_back(std::make_unique<Chunk>());
+      // destroy() relies on pushing to the free list not allocating
+      _free.reserve(capacity());
+      for (std::uint32_t i = 0; i < ChunkSize; i++) {
+        chunk[i].index = first + i;
+      }
+      // Hand out low indices first
+      for (std::uint32_t i = ChunkSize; i > 0; i--) {
+        _free.push_back(first + i - 1);
+      }
+    }
+
+    std::uint32_t allocate()
+    {
+      if (_free.empty()) add_chunk();
+      auto index = _free.back();
+      _free.pop_back();
+      return index;
+    }
+
+    /// The slot stays off the free list until the destructor is done, so elements created while
+    /// it runs can't end up in it.
+    void destroy(Slot& s) noexcept
+    {
+      s.alive = false;
+      s.generation++;
+      s.get().~T();
+      _free.push_back(s.index);
+    }
+
+    std::vector<std::unique_ptr<Chunk>> _chunks;
+    std::vector<std::uint32_t> _free;
+    order_t _order;
+  };
+
+  template<typename T, std::size_t N, typename T2>
+  bool erase_this(slab_vec<T, N>& vec, T2* el)
+  {
+    return vec.erase(*el);
+  }
+
+  template<typename T, std::size_t N, typename T2>
+  bool erase_this(slab_vec<T, N>& vec, T2& el)
+  {
+    return vec.erase(el);
+  }
+
+} // namespace cloth::util
@@ -0,0 +1,211 @@
+#include "animation.hpp"
+
+#include <algorithm>
+
+#include "util/algorithm.hpp"
+
+#include "desktop.hpp"
+#include "output.hpp"
+#include "render.hpp"
+#include "server.hpp"
+#include "view.hpp"
+#include "workspace.hpp"
+
+#include <GLES2/gl2.h>
+
+namespace cloth {
+
+  /// Largest snapshot texture side, in pixels
+  static constexpr int max_snapshot_size = 4096;
+
+  static auto progress(chrono::time_point now, chrono::time_point start, chrono::duration duration)
+    -> float
+  {
+    return std::clamp(float((now - start).count()) / duration.count(), 0.f, 1.f);
+  }
+
+  /// Cubic ease out, fast at first and settling at the end
+  static auto ease_out(float t) -> float
+  {
+    t = 1.f - t;
+    return 1.f - t * t * t;
+  }
+
+  static auto lerp(int a, int b, float t) -> int
+  {
+    return a + int((b - a) * t);
+  }
+
+  /// Animating menus and other override redirect windows would only get in the way
+  static auto animates(View& view) -> bool
+  {
+    if (!view.workspace->is_visible()) return false;
+#ifdef WLR_HAS_XWAYLAND
+    if (auto* xwl_view = view_cast<XwaylandSurface>(&view);
+        xwl_view && xwl_view->xwayland_surface->override_redirect) {
+      return false;
+    }
+#endif
+    return true;
+  }
+
+  Animations::Animations(Desktop& desktop) noexcept : desktop(desktop) {}
+
+  auto Animations::clear() noexcept -> void
+  {
+    for (auto& snap : _snapshots) snap.fb.destroy();
+    _snapshots.clear();
+    _opening.clear();
+  }
+
+  auto Animations::open(View& view) -> void
+  {
+    if (!animates(view)) return;
+    forget(view);
+    _opening.push_back({&view, chrono::clock::now()});
+    view.damage_whole();
+  }
+
+  auto Animations::close(View& view) -> void
+  {
+    if (!animates(view)) return;
+    auto box = view.get_box();
+    wlr::box_t to = {.x = box.x + box.width / 10,
+                     .y = box.y + box.height / 10,
+                     .width = box.width * 4 / 5,
+                     .height = box.height * 4 / 5};
+    snapshot(view, to, close_duration);
+  }
+
+  auto Animations::minimize(View& view) -> void
+  {
+    if (!animates(view)) return;
+    auto box = view.get_box();
+    auto output = util::find_if(desktop.outputs, [&](Output& output) {
+      return wlr_output_layout_intersects(desktop.layout, &output.wlr_output, &box);
+    });
+    if (output == desktop.outputs.end()) return;
+
+    auto area = output->layout_box();
+    wlr::box_t to = {.x = area.x + (area.width - box.width / 4) / 2,
+                     .y = area.y + area.height - box.height / 4,
+                     .width = box.width / 4,
+                     .height = box.height / 4};
+    snapshot(view, to, minimize_duration);
+  }
+
+  auto Animations::forget(View& view) noexcept -> void
+  {
+    _opening.erase(std::remove_if(_opening.begin(), _opening.end(),
+                                  [&](Opening& o) { return o.view == &view; }),
+                   _opening.end());
+  }
+
+  auto Animations::snapshot(View& view, wlr::box_t to, chrono::duration duration) -> void
+  {
+    // Snapshots are framebuffers, which only the GLES2 backend has
+    if (desktop.config.renderer != Config::Renderer::gles2) return;
+    // Views unmapped by attaching a null buffer have nothing left to copy
+    if (view.wlr_surface == nullptr || wlr_surface_get_texture(view.wlr_surface) == nullptr) {
+      return;
+    }
+    auto from = view.get_box();
+    if (from.width <= 0 || from.height <= 0) return;
+
+    float scale = 1.f;
+    for (auto& output : desktop.outputs) {
+      if (wlr_output_layout_intersects(desktop.layout, &output.wlr_output, &from)) {
+        scale = std::max(scale, output.wlr_output.scale);
+      }
+    }
+
+    // This runs outside of output frames, where no context is current
+    auto& server = desktop.server;
+    auto* egl = wlr_backend_get_egl(server.backend);
+    if (!wlr_egl_make_current(egl, EGL_NO_SURFACE, nullptr)) return;
+
+    GLint prev_framebuffer;
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &prev_framebuffer);
+
+    Snapshot snap = {.from = from,
+                     .to = to,
+                     .alpha = view.alpha,
+                     .start = chrono::clock::now(),
+                     .duration = duration};
+    bool ok = snap.fb.resize(std::min(int(from.width * scale), max_snapshot_size),
+                             std::min(int(from.height * scale), max_snapshot_size)) &&
+              render::render_view(*server.renderer, view, snap.fb);
+    glBindFramebuffer(GL_FRAMEBUFFER, prev_framebuffer);
+
+    if (!ok) {
+      snap.fb.destroy();
+      return;
+    }
+    _snapshots.push_back(snap);
+    damage(from);
+  }
+
+  auto Animations::damage(wlr::box_t box) -> void
+  {
+    for (auto& output : desktop.outputs) output.context.damage_box(box);
+  }
+
+  auto Animations::apply(View& view, render::RenderData& data) const -> void
+  {
+    auto opening = util::find_if(_opening, [&](const Opening& o) { return o.view == &view; });
+    if (opening == _opening.end()) return;
+
+    float t = ease_out(progress(chrono::clock::now(), opening->start, open_duration));
+    double scale = 0.9 + 0.1 * t;
+    data.layout.x += data.layout.width * (1 - scale) / 2;
+    data.layout.y += data.layout.height * (1 - scale) / 2;
+    data.layout.width *= scale;
+    data.layout.height *= scale;
+    data.alpha *= t;
+  }
+
+  auto Animations::render(render::Context& context, bool draw) -> void
+  {
+    auto now = chrono::clock::now();
+
+    // Opening views are drawn with the other views, this only keeps their frames coming
+    for (auto iter = _opening.begin(); iter != _opening.end();) {
+      iter->view->damage_whole();
+      if (now - iter->start >= open_duration) {
+        iter = _opening.erase(iter);
+      } else {
+        ++iter;
+      }
+    }
+
+    for (auto iter = _snapshots.begin(); iter != _snapshots.end();) {
+      auto& snap = *iter;
+      int x1 = std::min(snap.from.x, snap.to.x);
+      int y1 = std::min(snap.from.y, snap.to.y);
+      int x2 = std::max(snap.from.x + snap.from.width, snap.to.x + snap.to.width);
+      int y2 = std::max(snap.from.y + snap.from.height, snap.to.y + snap.to.height);
+      damage({.x = x1, .y = y1, .width = x2 - x1, .height = y2 - y1});
+
+      float t = progress(now, snap.start, snap.duration);
+      if (t >= 1.f) {
+        // The context is current here, so the snapshot can be freed right away
+        snap.fb.destroy();
+        iter = _snapshots.erase(iter);
+        continue;
+      }
+
+      if (!draw) {
+        ++iter;
+        continue;
+      }
+      t = ease_out(t);
+      wlr::box_t box = {.x = lerp(snap.from.x, snap.to.x, t),
+                        .y = lerp(snap.from.y, snap.to.y, t),
+                        .width = lerp(snap.from.width, snap.to.width, t),
+                        .height = lerp(snap.from.height, snap.to.height, t)};
+      context.draw_framebuffer(snap.fb, box, snap.alpha * (1.f - t));
+      ++iter;
+    }
+  }
+
+} // namespace cloth
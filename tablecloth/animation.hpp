@@ -0,0 +1,77 @@
+#pragma once
+
+#include <vector>
+
+#include "util/chrono.hpp"
+
+#include "thumbnail.hpp"
+#include "wlroots.hpp"
+
+namespace cloth {
+
+  struct Desktop;
+  struct View;
+
+  namespace render {
+    struct Context;
+    struct RenderData;
+  } // namespace render
+
+  /// Open, close and minimize animations.
+  ///
+  /// Closing and minimizing views are drawn from a snapshot of their surfaces, taken while they
+  /// still have buffers. The animation then needs nothing from the client, and outlives the view.
+  /// Opening views are live, they are only scaled and faded through their render data.
+  struct Animations {
+    static constexpr chrono::duration open_duration = chrono::milliseconds(150);
+    static constexpr chrono::duration close_duration = chrono::milliseconds(200);
+    static constexpr chrono::duration minimize_duration = chrono::milliseconds(300);
+
+    Animations(Desktop& desktop) noexcept;
+
+    Animations(const Animations&) = delete;
+    Animations& operator=(const Animations&) = delete;
+
+    /// Grow and fade in a view that was just mapped or restored
+    auto open(View& view) -> void;
+    /// Snapshot a view that is about to be unmapped, and shrink it away
+    auto close(View& view) -> void;
+    /// Snapshot a view that is being minimized, and move it towards the bottom of its output
+    auto minimize(View& view) -> void;
+    /// Stop animating a view that is going away. Its snapshots don't refer to it, and stay.
+    auto forget(View& view) noexcept -> void;
+    /// Stop all animations and free their snapshots. Needs the renderer's context to be current
+    auto clear() noexcept -> void;
+
+    /// Scale and fade the render data of a view that is opening
+    auto apply(View& view, render::RenderData& data) const -> void;
+
+    /// Draw the snapshots above the views, and damage what the next frame has to redraw.
+    /// Without `draw`, animations only advance, and finished snapshots are freed
+    auto render(render::Context& context, bool draw = true) -> void;
+
+  private:
+    struct Opening {
+      View* view;
+      chrono::time_point start;
+    };
+
+    struct Snapshot {
+      render::Framebuffer fb;
+      /// Layout boxes at the start and the end of the animation
+      wlr::box_t from;
+      wlr::box_t to;
+      float alpha;
+      chrono::time_point start;
+      chrono::duration duration;
+    };
+
+    auto snapshot(View& view, wlr::box_t to, chrono::duration duration) -> void;
+    auto damage(wlr::box_t box) -> void;
+
+    Desktop& desktop;
+    std::vector<Opening> _opening;
+    std::vector<Snapshot> _snapshots;
+  };
+
+} // namespace cloth
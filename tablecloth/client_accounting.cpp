@@ -0,0 +1,249 @@
+#include "client_accounting.hpp"
+
+#include <fstream>
+#include <optional>
+
+#include "util/algorithm.hpp"
+#include "util/logging.hpp"
+
+#include "server.hpp"
+#include "view.hpp"
+
+namespace cloth {
+
+  using steady_clock = chrono::steady_clock;
+
+  /// A surface, counted against its client
+  struct ClientAccounting::Surface {
+    ClientStats& stats;
+    wlr::surface_t& surface;
+    /// Bytes in its current buffer
+    size_t buffer_bytes = 0;
+    steady_clock::time_point last_frame_done;
+    wl::Listener on_commit;
+    wl::Listener on_destroy;
+  };
+
+  /// The time between two events at a rate per second
+  static auto interval(int rate) -> steady_clock::duration
+  {
+    return chrono::duration_cast<steady_clock::duration>(chrono::seconds(1)) / rate;
+  }
+
+  static auto apply_policy(Config& config, ClientStats& stats) -> void
+  {
+    auto* policy = config.get_client_policy(stats.name);
+    stats.max_commit_rate = policy ? policy->max_commit_rate : 0;
+    stats.max_frame_rate = policy ? policy->max_frame_rate : 0;
+  }
+
+  auto ClientStats::roll(steady_clock::time_point now) -> void
+  {
+    auto elapsed = now - window_start;
+    if (elapsed < chrono::seconds(1)) return;
+    // If more than a second passed since, nothing happened during the last one
+    last = elapsed < chrono::seconds(2) ? current : Window{};
+    current = {};
+    window_start = now;
+  }
+
+  ClientAccounting::ClientAccounting(Server& server) noexcept : server(server)
+  {
+    _timer = wl_event_loop_add_timer(server.wl_event_loop,
+                                     [](void* data) {
+                                       ((ClientAccounting*) data)->flush_deferred();
+                                       return 0;
+                                     },
+                                     this);
+
+    on_new_surface.add_to(server.desktop.compositor->events.new_surface);
+    on_new_surface = [this](void* data) { handle_new_surface(*(wlr::surface_t*) data); };
+  }
+
+  ClientAccounting::~ClientAccounting() noexcept
+  {
+    wl_event_source_remove(_timer);
+  }
+
+  auto ClientAccounting::stats(wl::client_t* client) -> ClientStats&
+  {
+    auto [iter, added] = clients.try_emplace(client);
+    if (!added) return *iter->second;
+
+    iter->second = std::make_unique<ClientStats>();
+    auto& stats = *iter->second;
+    stats.client = client;
+    stats.window_start = steady_clock::now();
+    wl_client_get_credentials(client, &stats.pid, nullptr, nullptr);
+    std::ifstream comm(fmt::format("/proc/{}/comm", stats.pid));
+    std::getline(comm, stats.name);
+    apply_policy(server.config, stats);
+
+    // Sent before the resources of the client are destroyed
+    stats.on_destroy = [this, client] {
+      for (auto iter = _surfaces.begin(); iter != _surfaces.end();) {
+        auto& surface = *iter->second;
+        if (surface.stats.client != client) {
+          ++iter;
+          continue;
+        }
+        _deferred_frames.erase(util::remove(_deferred_frames, &surface), _deferred_frames.end());
+        iter = _surfaces.erase(iter);
+      }
+      clients.erase(client);
+    };
+    wl_client_add_destroy_listener(client, &(wl_listener&) stats.on_destroy);
+    return stats;
+  }
+
+  auto ClientAccounting::stats(wlr::surface_t& surface) -> ClientStats&
+  {
+    return stats(wl_resource_get_client(surface.resource));
+  }
+
+  auto ClientAccounting::handle_new_surface(wlr::surface_t& wlr_surface) -> void
+  {
+    auto& surface = *_surfaces.emplace(&wlr_surface, new Surface{stats(wlr_surface), wlr_surface})
+                       .first->second;
+
+    // Added before the shells add theirs, so it runs first on every commit
+    surface.on_commit.add_to(wlr_surface.events.commit);
+    surface.on_commit = [&surface] {
+      auto& stats = surface.stats;
+      auto& wlr_surface = surface.surface;
+      stats.roll(steady_clock::now());
+      stats.current.commits++;
+
+      int count;
+      auto* rects = pixman_region32_rectangles(&wlr_surface.buffer_damage, &count);
+      for (int i = 0; i < count; i++) {
+        stats.current.damage_area += uint64_t(rects[i].x2 - rects[i].x1) * (rects[i].y2 - rects[i].y1);
+      }
+
+      size_t bytes = 0;
+      if (wlr_surface_get_texture(&wlr_surface)) {
+        bytes = size_t(wlr_surface.current.buffer_width) * wlr_surface.current.buffer_height * 4;
+      }
+      stats.buffer_bytes = stats.buffer_bytes - surface.buffer_bytes + bytes;
+      surface.buffer_bytes = bytes;
+    };
+
+    surface.on_destroy.add_to(wlr_surface.events.destroy);
+    surface.on_destroy = [this, &surface] {
+      surface.stats.buffer_bytes -= surface.buffer_bytes;
+      _deferred_frames.erase(util::remove(_deferred_frames, &surface), _deferred_frames.end());
+      _surfaces.erase(&surface.surface);
+    };
+  }
+
+  auto ClientAccounting::allow_repaint(View& view) -> bool
+  {
+    if (view.wlr_surface == nullptr) return true;
+    auto& stats = this->stats(*view.wlr_surface);
+    if (stats.max_commit_rate <= 0) return true;
+
+    auto now = steady_clock::now();
+    auto next = stats.last_repaint + interval(stats.max_commit_rate);
+    if (now >= next) {
+      stats.last_repaint = now;
+      return true;
+    }
+    stats.deferred_damage = true;
+    schedule_flush(next - now);
+    return false;
+  }
+
+  auto ClientAccounting::allow_frame_done(wlr::surface_t& wlr_surface) -> bool
+  {
+    auto found = _surfaces.find(&wlr_surface);
+    if (found == _surfaces.end()) return true;
+    auto& surface = *found->second;
+    int rate = surface.stats.max_frame_rate;
+    if (rate <= 0) return true;
+
+    auto now = steady_clock::now();
+    auto next = surface.last_frame_done + interval(rate);
+    if (now >= next) {
+      surface.last_frame_done = now;
+      return true;
+    }
+    if (!util::any_of(_deferred_frames, [&](Surface* s) { return s == &surface; })) {
+      _deferred_frames.push_back(&surface);
+    }
+    schedule_flush(next - now);
+    return false;
+  }
+
+  auto ClientAccounting::apply_policies() -> void
+  {
+    for (auto& [client, stats] : clients) apply_policy(server.config, *stats);
+    // Lifted limits let held back frames and repaints through
+    if (!_deferred_frames.empty() || util::any_of(clients, [](auto& c) { return c.second->deferred_damage; })) {
+      schedule_flush(steady_clock::duration::zero());
+    }
+  }
+
+  auto ClientAccounting::time(wlr::surface_t& surface) -> Timer
+  {
+    return Timer{stats(surface), steady_clock::now()};
+  }
+
+  ClientAccounting::Timer::~Timer() noexcept
+  {
+    stats.current.handler_time += steady_clock::now() - start;
+  }
+
+  auto ClientAccounting::schedule_flush(steady_clock::duration delay) -> void
+  {
+    auto deadline = steady_clock::now() + delay;
+    if (_timer_deadline != steady_clock::time_point() && _timer_deadline <= deadline) return;
+    _timer_deadline = deadline;
+    auto ms = chrono::ceil<chrono::milliseconds>(delay).count();
+    wl_event_source_timer_update(_timer, std::max<int>(ms, 1));
+  }
+
+  auto ClientAccounting::flush_deferred() -> void
+  {
+    _timer_deadline = {};
+    auto now = steady_clock::now();
+    std::optional<steady_clock::duration> next;
+    auto retry_at = [&](steady_clock::time_point at) {
+      if (!next || at - now < *next) next = at - now;
+    };
+
+    auto when = chrono::to_timespec(chrono::clock::now());
+    for (auto iter = _deferred_frames.begin(); iter != _deferred_frames.end();) {
+      auto& surface = **iter;
+      int rate = surface.stats.max_frame_rate;
+      if (rate > 0 && now < surface.last_frame_done + interval(rate)) {
+        retry_at(surface.last_frame_done + interval(rate));
+        ++iter;
+        continue;
+      }
+      wlr_surface_send_frame_done(&surface.surface, &when);
+      surface.last_frame_done = now;
+      iter = _deferred_frames.erase(iter);
+    }
+
+    for (auto& [client, stats] : clients) {
+      if (!stats->deferred_damage) continue;
+      int rate = stats->max_commit_rate;
+      if (rate > 0 && now < stats->last_repaint + interval(rate)) {
+        retry_at(stats->last_repaint + interval(rate));
+        continue;
+      }
+      stats->deferred_damage = false;
+      stats->last_repaint = now;
+      // What the held back commits damaged isn't known anymore
+      for (auto& [index, ws] : server.desktop.workspaces) {
+        for (auto& view : ws->views()) {
+          if (!view.mapped || view.wlr_surface == nullptr) continue;
+          if (wl_resource_get_client(view.wlr_surface->resource) == client) view.damage_whole();
+        }
+      }
+    }
+
+    if (next) schedule_flush(*next);
+  }
+
+} // namespace cloth
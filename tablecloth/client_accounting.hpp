@@ -0,0 +1,105 @@
+#pragma once
+
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "util/chrono.hpp"
+
+#include "wlroots.hpp"
+
+namespace cloth {
+
+  struct Server;
+  struct View;
+
+  /// What a client costs the compositor, and the limits it is held to.
+  ///
+  /// All X11 windows belong to the Xwayland client.
+  struct ClientStats {
+    /// What happened during one second
+    struct Window {
+      uint32_t commits = 0;
+      /// Buffer pixels damaged by the commits
+      uint64_t damage_area = 0;
+      /// Spent handling the commits
+      chrono::nanoseconds handler_time = {};
+    };
+
+    wl::client_t* client;
+    pid_t pid = 0;
+    /// The process name, from /proc
+    std::string name;
+
+    /// The second being counted
+    Window current;
+    /// The last full second
+    Window last;
+    chrono::steady_clock::time_point window_start;
+
+    /// Bytes in the buffers attached to its surfaces
+    size_t buffer_bytes = 0;
+
+    /// Repaints caused by its commits per second, from the config. 0 doesn't limit them
+    int max_commit_rate = 0;
+    /// Frame callbacks per second and surface, from the config. 0 doesn't limit them
+    int max_frame_rate = 0;
+
+    chrono::steady_clock::time_point last_repaint;
+    /// Commits were held back by max_commit_rate
+    bool deferred_damage = false;
+
+    /// Start counting a new second if the current one is over
+    auto roll(chrono::steady_clock::time_point now) -> void;
+
+    wl::Listener on_destroy;
+  };
+
+  /// Keeps ClientStats for every client with surfaces, and enforces their limits
+  struct ClientAccounting {
+    ClientAccounting(Server& server) noexcept;
+    ~ClientAccounting() noexcept;
+
+    ClientAccounting(const ClientAccounting&) = delete;
+    ClientAccounting& operator=(const ClientAccounting&) = delete;
+
+    auto stats(wl::client_t* client) -> ClientStats&;
+    auto stats(wlr::surface_t& surface) -> ClientStats&;
+
+    /// Whether a commit of a view may damage outputs now. If not, the view is damaged once
+    /// the max_commit_rate of its client allows it
+    auto allow_repaint(View& view) -> bool;
+    /// Whether frame callbacks may be sent to a surface now. If not, they are sent once the
+    /// max_frame_rate of its client allows it
+    auto allow_frame_done(wlr::surface_t& surface) -> bool;
+    /// Read the limits of every client from the config again
+    auto apply_policies() -> void;
+
+    /// Counts the time until it goes out of scope against a client
+    struct Timer {
+      ~Timer() noexcept;
+      ClientStats& stats;
+      chrono::steady_clock::time_point start;
+    };
+    /// Time the handling of a commit of a surface
+    auto time(wlr::surface_t& surface) -> Timer;
+
+    std::unordered_map<wl::client_t*, std::unique_ptr<ClientStats>> clients;
+
+  private:
+    struct Surface;
+
+    auto handle_new_surface(wlr::surface_t& surface) -> void;
+    auto flush_deferred() -> void;
+    auto schedule_flush(chrono::steady_clock::duration delay) -> void;
+
+    Server& server;
+    std::unordered_map<wlr::surface_t*, std::unique_ptr<Surface>> _surfaces;
+    /// Surfaces with frame callbacks held back
+    std::vector<Surface*> _deferred_frames;
+    wl::event_source_t* _timer = nullptr;
+    chrono::steady_clock::time_point _timer_deadline;
+    wl::Listener on_new_surface;
+  };
+
+} // namespace cloth
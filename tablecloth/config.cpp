@@ -245,6 +245,7 @@ namespace cloth {
     static std::string_view device_prefix = "device:";
     static std::string_view keyboard_prefix = "keyboard:";
     static std::string_view cursor_prefix = "cursor:";
+    static std::string_view client_prefix = "client:";
 
     int config_ini_handler(Config& config,
                            std::string_view section,
@@ -263,6 +264,14 @@ namespace cloth {
           } else {
             LOGE("got unknown xwayland value: {}", value);
           }
+        } else if (name == "renderer") {
+          if (util::iequals(value, "gles2")) {
+            config.renderer = Config::Renderer::gles2;
+          } else if (util::iequals(value, "pixman")) {
+            config.renderer = Config::Renderer::pixman;
+          } else {
+            LOGE("got unknown renderer: {}", value);
+          }
         } else {
           LOGE("got unknown core config: {}", name);
         }
@@ -296,7 +305,10 @@ namespace cloth {
           found->y = std::strtol(val_str.c_str(), nullptr, 10);
         } else if (name == "scale") {
           found->scale = std::strtof(val_str.c_str(), nullptr);
-          assert(found->scale > 0);
+          if (found->scale <= 0) {
+            LOGE("got invalid output scale: {}", value);
+            return 0;
+          }
         } else if (name == "rotate") {
           if (value == "normal") {
             found->transform = WL_OUTPUT_TRANSFORM_NORMAL;
@@ -320,14 +332,23 @@ namespace cloth {
         } else if (name == "mode") {
           char* end;
           found->mode.width = std::strtol(val_str.c_str(), &end, 10);
-          assert(*end == 'x');
+          if (*end != 'x') {
+            LOGE("got invalid output mode: {}", value);
+            return 0;
+          }
           ++end;
           found->mode.height = std::strtol(end, &end, 10);
           if (*end) {
-            assert(*end == '@');
+            if (*end != '@') {
+              LOGE("got invalid output mode: {}", value);
+              return 0;
+            }
             ++end;
             found->mode.refresh_rate = std::strtof(end, &end);
-            assert("Hz" == end);
+            if (std::string_view(end) != "Hz") {
+              LOGE("got invalid output mode: {}", value);
+              return 0;
+            }
           }
           LOGD("Configured output {} with mode {}x{}@{}", found->name, found->mode.width,
                found->mode.height, found->mode.refresh_rate);
@@ -386,6 +407,26 @@ namespace cloth {
         config_handle_keyboard(config, device_name, name, value);
       } else if (section == "bindings") {
         add_binding_config(config, name, value);
+      } else if (util::starts_with(client_prefix, section)) {
+        auto client_name = section.substr(client_prefix.size());
+        auto found = util::find_if(config.client_policies, [&](auto& p) { return p.name == client_name; });
+        auto& policy = found != config.client_policies.end() ? *found : config.client_policies.emplace_back();
+        policy.name = client_name;
+        if (name == "max_commit_rate") {
+          policy.max_commit_rate = std::strtol(std::string(value).c_str(), nullptr, 10);
+        } else if (name == "max_frame_rate") {
+          policy.max_frame_rate = std::strtol(std::string(value).c_str(), nullptr, 10);
+        } else {
+          LOGE("got unknown client config: {}", name);
+        }
+      } else if (section == "idle") {
+        if (name == "dim") {
+          config.idle.dim_timeout = std::strtol(std::string(value).c_str(), nullptr, 10);
+        } else if (name == "off") {
+          config.idle.off_timeout = std::strtol(std::string(value).c_str(), nullptr, 10);
+        } else {
+          LOGE("got unknown idle config: {}", name);
+        }
       } else {
         LOGE("got unknown config section: {}", section);
       }
@@ -424,12 +465,33 @@ namespace cloth {
       }
     }
 
-    int result =
-      ini_parse(config_path.c_str(),
-                [](void* data, const char* section, const char* name, const char* value) {
-                  return config_ini_handler(*(Config*) data, section, name, value);
-                },
-                this);
+    if (!load()) exit(1);
+  }
+
+  auto Config::load() noexcept -> bool
+  {
+    xwayland = true;
+    xwayland_lazy = true;
+    renderer = Renderer::gles2;
+    outputs.clear();
+    devices.clear();
+    bindings.clear();
+    keyboards.clear();
+    cursors.clear();
+    client_policies.clear();
+    idle = {};
+
+    int result;
+    try {
+      result = ini_parse(config_path.c_str(),
+                         [](void* data, const char* section, const char* name, const char* value) {
+                           return config_ini_handler(*(Config*) data, section, name, value);
+                         },
+                         this);
+    } catch (std::exception& e) {
+      LOGE("Could not parse config file: {}", e.what());
+      return false;
+    }
 
     if (result == -1) {
       LOGD("No config file found. Using sensible defaults.");
@@ -441,11 +503,12 @@ namespace cloth {
       kc.name = "";
     } else if (result == -2) {
       LOGE("Could not allocate memory to parse config file");
-      exit(1);
+      return false;
     } else if (result != 0) {
-      LOGE("Could not parse config file");
-      exit(1);
+      LOGE("Could not parse config file, error on line {}", result);
+      return false;
     }
+    return true;
   }
 
   Config::~Config() noexcept {}
@@ -481,4 +544,14 @@ namespace cloth {
     return nullptr;
   }
 
+  Config::ClientPolicy* Config::get_client_policy(std::string_view name) noexcept
+  {
+    auto found = util::find_if(client_policies, [&](auto& el) { return el.name == name; });
+    if (found == client_policies.end()) {
+      found = util::find_if(client_policies, [&](auto& el) { return el.name == "*"; });
+    }
+    if (found != client_policies.end()) return &*found;
+    return nullptr;
+  }
+
 } // namespace cloth
@@ -64,6 +64,29 @@ namespace cloth {
       std::string default_image;
     };
 
+    /// Seconds without input before the outputs are dimmed and turned off. 0 never does
+    struct Idle {
+      int dim_timeout = 0;
+      int off_timeout = 0;
+    };
+
+    /// Limits for the clients of a program, by process name. The "*" policy applies to programs
+    /// without one
+    struct ClientPolicy {
+      std::string name;
+      /// Repaints caused by its commits per second. 0 doesn't limit them
+      int max_commit_rate = 0;
+      /// Frame callbacks per second and surface. 0 doesn't limit them
+      int max_frame_rate = 0;
+    };
+
+    /// What outputs are composited with
+    enum struct Renderer {
+      gles2,
+      /// On the CPU, for machines without a GPU
+      pixman,
+    };
+
     Config() noexcept {};
 
     /// Create a roots config from the given command line arguments. Command line
@@ -71,6 +94,10 @@ namespace cloth {
     /// specified, the default location will be used.
     Config(int argc, char* argv[]) noexcept;
 
+    /// Parse the file at config_path, replacing everything parsed before. Returns false if it
+    /// can't be parsed, leaving the config partially parsed.
+    auto load() noexcept -> bool;
+
     /// Destroy the config and free its resources.
     ~Config() noexcept;
 
@@ -90,14 +117,22 @@ namespace cloth {
     /// NULL. A NULL seat_name returns the default config for cursors.
     Config::Cursor* get_cursor(std::string_view seat_name = default_seat_name) noexcept;
 
+    /// Get the policy for the clients of a program, or the default one. If there is neither,
+    /// returns NULL.
+    Config::ClientPolicy* get_client_policy(std::string_view name) noexcept;
+
     bool xwayland = true;
     bool xwayland_lazy = false;
+    /// Only read at startup
+    Renderer renderer = Renderer::gles2;
 
     std::vector<Output> outputs;
     std::vector<Device> devices;
     std::vector<Binding> bindings;
     std::vector<Keyboard> keyboards;
     std::vector<Cursor> cursors;
+    std::vector<ClientPolicy> client_policies;
+    Idle idle;
 
     std::string config_path;
     std::string startup_cmd;
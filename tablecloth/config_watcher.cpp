@@ -0,0 +1,217 @@
+#include "config_watcher.hpp"
+
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstring>
+#include <tuple>
+
+#include "util/algorithm.hpp"
+#include "util/logging.hpp"
+
+#include "keyboard.hpp"
+#include "seat.hpp"
+#include "server.hpp"
+
+namespace cloth {
+
+  /// The directory and file name of a path. The directory is watched, since editors often
+  /// replace the file instead of writing to it
+  static auto split_path(const std::string& path) -> std::pair<std::string, std::string>
+  {
+    auto slash = path.rfind('/');
+    if (slash == std::string::npos) return {".", path};
+    return {path.substr(0, slash == 0 ? 1 : slash), path.substr(slash + 1)};
+  }
+
+  static auto same_box(const wlr::box_t& a, const wlr::box_t& b) -> bool
+  {
+    return std::tie(a.x, a.y, a.width, a.height) == std::tie(b.x, b.y, b.width, b.height);
+  }
+
+  static auto same_modes(const Config::Output& a, const Config::Output& b) -> bool
+  {
+    return std::equal(a.modes.begin(), a.modes.end(), b.modes.begin(), b.modes.end(),
+                      [](auto& x, auto& y) {
+                        return std::memcmp(&x.info, &y.info, sizeof(x.info)) == 0;
+                      });
+  }
+
+  static auto same_output(const Config::Output& a, const Config::Output& b) -> bool
+  {
+    return std::tie(a.enable, a.transform, a.x, a.y, a.scale, a.mode.width, a.mode.height,
+                    a.mode.refresh_rate) ==
+             std::tie(b.enable, b.transform, b.x, b.y, b.scale, b.mode.width, b.mode.height,
+                      b.mode.refresh_rate) &&
+           same_modes(a, b);
+  }
+
+  static auto same_device(const Config::Device& a, const Config::Device& b) -> bool
+  {
+    return std::tie(a.name, a.seat, a.mapped_output, a.tap_enabled, a.natural_scroll) ==
+             std::tie(b.name, b.seat, b.mapped_output, b.tap_enabled, b.natural_scroll) &&
+           same_box(a.mapped_box, b.mapped_box);
+  }
+
+  static auto same_cursor(const Config::Cursor& a, const Config::Cursor& b) -> bool
+  {
+    return std::tie(a.seat, a.mapped_output, a.theme, a.default_image) ==
+             std::tie(b.seat, b.mapped_output, b.theme, b.default_image) &&
+           same_box(a.mapped_box, b.mapped_box);
+  }
+
+  template<typename T, typename Eq>
+  static auto same_list(const std::vector<T>& a, const std::vector<T>& b, Eq&& eq) -> bool
+  {
+    return std::equal(a.begin(), a.end(), b.begin(), b.end(), eq);
+  }
+
+  ConfigWatcher::ConfigWatcher(Server& server) noexcept : server(server)
+  {
+    auto dir = split_path(server.config.config_path).first;
+    _inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (_inotify_fd < 0) {
+      LOGE("Cannot watch the config file: {}", strerror(errno));
+      return;
+    }
+    if (inotify_add_watch(_inotify_fd, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+      LOGE("Cannot watch {}: {}", dir, strerror(errno));
+      close(_inotify_fd);
+      _inotify_fd = -1;
+      return;
+    }
+    _inotify_source = wl_event_loop_add_fd(server.wl_event_loop, _inotify_fd, WL_EVENT_READABLE,
+                                           [](int, uint32_t, void* data) {
+                                             ((ConfigWatcher*) data)->handle_inotify();
+                                             return 0;
+                                           },
+                                           this);
+  }
+
+  ConfigWatcher::~ConfigWatcher() noexcept
+  {
+    if (_settle_timer) wl_event_source_remove(_settle_timer);
+    if (_inotify_source) wl_event_source_remove(_inotify_source);
+    if (_inotify_fd >= 0) close(_inotify_fd);
+  }
+
+  auto ConfigWatcher::handle_inotify() -> void
+  {
+    auto file = split_path(server.config.config_path).second;
+    bool changed = false;
+
+    alignas(inotify_event) char buf[4096];
+    ssize_t len;
+    while ((len = read(_inotify_fd, buf, sizeof(buf))) > 0) {
+      for (char* ptr = buf; ptr < buf + len;) {
+        auto* event = (inotify_event*) ptr;
+        if (event->len > 0 && file == event->name) changed = true;
+        ptr += sizeof(inotify_event) + event->len;
+      }
+    }
+    if (!changed) return;
+
+    if (!_settle_timer) {
+      _settle_timer = wl_event_loop_add_timer(server.wl_event_loop,
+                                              [](void* data) {
+                                                ((ConfigWatcher*) data)->reload();
+                                                return 0;
+                                              },
+                                              this);
+    }
+    wl_event_source_timer_update(_settle_timer, settle_time.count());
+  }
+
+  auto ConfigWatcher::reload() -> bool
+  {
+    auto& config = server.config;
+    auto& desktop = server.desktop;
+    auto& seats = server.input.seats;
+
+    Config next = config;
+    if (!next.load()) {
+      LOGE("Keeping the current config");
+      return false;
+    }
+    LOGI("Reloading config from {}", config.config_path);
+
+    // Work out what changed before replacing the config everything else reads from
+    struct OutputChange {
+      Output* output;
+      bool modes_changed;
+    };
+    std::vector<OutputChange> output_changes;
+    for (auto& output : desktop.outputs) {
+      auto* before = config.get_output(output.wlr_output);
+      auto* after = next.get_output(output.wlr_output);
+      // Outputs that lost their section keep what they have
+      if (after == nullptr || (before && same_output(*before, *after))) continue;
+      output_changes.push_back({&output, !before || !same_modes(*before, *after)});
+    }
+
+    std::vector<Seat*> theme_changes;
+    for (auto& seat : seats) {
+      auto* before = config.get_cursor(seat.wlr_seat->name);
+      auto* after = next.get_cursor(seat.wlr_seat->name);
+      if ((before ? before->theme : "") != (after ? after->theme : "")) {
+        theme_changes.push_back(&seat);
+      }
+    }
+
+    bool devices_changed = !same_list(config.devices, next.devices, same_device);
+    bool cursors_changed = !same_list(config.cursors, next.cursors, same_cursor);
+    bool idle_changed = std::tie(config.idle.dim_timeout, config.idle.off_timeout) !=
+                        std::tie(next.idle.dim_timeout, next.idle.off_timeout);
+    if (std::tie(config.xwayland, config.xwayland_lazy) !=
+        std::tie(next.xwayland, next.xwayland_lazy)) {
+      LOGI("Xwayland settings take effect after a restart");
+    }
+    if (config.renderer != next.renderer) {
+      LOGI("The renderer changes after a restart");
+      next.renderer = config.renderer;
+    }
+
+    // Bindings are looked up in the config on every key press
+    config = next;
+
+    for (auto& seat : seats) {
+      for (auto& keyboard : seat.keyboards) {
+        try {
+          keyboard.configure();
+        } catch (std::exception& e) {
+          LOGE("Could not configure keyboard {}: {}", keyboard.wlr_device.name, e.what());
+        }
+      }
+      if (devices_changed) {
+        for (auto& pointer : seat.pointers) server.input.configure_device(pointer.wlr_device);
+        for (auto& touch : seat.touch) server.input.configure_device(touch.wlr_device);
+        for (auto& tablet : seat.tablets) server.input.configure_device(tablet.wlr_device);
+      }
+    }
+
+    if (!output_changes.empty()) {
+      TransactionScope scope(desktop);
+      for (auto& [output, modes_changed] : output_changes) {
+        auto& oc = *config.get_output(output->wlr_output);
+        if (modes_changed) output->add_config_modes(oc);
+        output->apply_config(oc);
+      }
+      desktop.arrange_outputs();
+    }
+
+    for (auto* seat : theme_changes) {
+      if (seat->cursor.xcursor_manager) wlr_xcursor_manager_destroy(seat->cursor.xcursor_manager);
+      seat->cursor.xcursor_manager = nullptr;
+    }
+    for (auto& seat : seats) {
+      if (devices_changed || cursors_changed || !output_changes.empty()) seat.configure_cursor();
+      // Outputs with a new scale need the cursor theme loaded at that scale
+      if (cursors_changed || !output_changes.empty()) seat.configure_xcursor();
+    }
+
+    if (idle_changed) desktop.power.reset_timeouts();
+    server.client_accounting.apply_policies();
+    return true;
+  }
+
+} // namespace cloth
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "util/chrono.hpp"
+
+#include "wlroots.hpp"
+
+namespace cloth {
+
+  struct Server;
+
+  /// Reloads the config when its file changes, or when the `reload` command runs.
+  ///
+  /// The new config is compared to the live one, and only what changed is applied. Keyboards
+  /// only get a new keymap if theirs changed, and outputs are only reconfigured if their section
+  /// did. A config that fails to parse is ignored, and the live one is kept.
+  struct ConfigWatcher {
+    /// Editors write files in several steps, wait for them to be done
+    static constexpr chrono::milliseconds settle_time = chrono::milliseconds(200);
+
+    ConfigWatcher(Server& server) noexcept;
+    ~ConfigWatcher() noexcept;
+
+    ConfigWatcher(const ConfigWatcher&) = delete;
+    ConfigWatcher& operator=(const ConfigWatcher&) = delete;
+
+    /// Parse the config file again, and apply what changed. Returns false if it can't be parsed
+    auto reload() -> bool;
+
+  private:
+    auto handle_inotify() -> void;
+
+    Server& server;
+    int _inotify_fd = -1;
+    wl::event_source_t* _inotify_source = nullptr;
+    wl::event_source_t* _settle_timer = nullptr;
+  };
+
+} // namespace cloth
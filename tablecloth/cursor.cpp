@@ -3,6 +3,9 @@
 #include <math.h>
 #include <stdlib.h>
 
+#include <utility>
+
+#include "util/algorithm.hpp"
 #include "util/logging.hpp"
 
 #include "wlroots.hpp"
@@ -15,8 +18,155 @@
 
 namespace cloth {
 
+  TouchPoint::TouchPoint(int touch_id) noexcept : touch_id(touch_id) {}
+
+  auto Cursor::touch_point(int touch_id) -> TouchPoint*
+  {
+    auto iter =
+      util::find_if(_touch_points, [&](TouchPoint& tp) { return tp.touch_id == touch_id; });
+    return iter == _touch_points.end() ? nullptr : &*iter;
+  }
+
+  auto Cursor::add_touch_point(int touch_id,
+                               wlr::surface_t* surface,
+                               View* view,
+                               double lx,
+                               double ly) -> void
+  {
+    if (auto* old = touch_point(touch_id)) util::erase_this(_touch_points, old);
+    auto& tp = _touch_points.emplace_back(touch_id);
+    if (view && view->rotation != 0) {
+      tp.retarget = true;
+      return;
+    }
+    tp.surface = surface;
+    tp.lx = lx;
+    tp.ly = ly;
+    auto lost = [&tp] {
+      tp.surface = nullptr;
+      tp.view = nullptr;
+      tp.on_view_unmap.remove();
+      tp.on_surface_destroy.remove();
+    };
+    tp.on_surface_destroy.add_to(surface->events.destroy);
+    tp.on_surface_destroy = lost;
+    if (view) {
+      tp.view = view;
+      tp.view_x = view->x;
+      tp.view_y = view->y;
+      tp.on_view_unmap.add_to(view->events.unmap);
+      tp.on_view_unmap = lost;
+    }
+  }
+
+  auto Cursor::queue_touch_motion(int touch_id, double lx, double ly, uint32_t time) -> void
+  {
+    auto* tp = touch_point(touch_id);
+    if (!tp) return;
+    tp->has_motion = true;
+    tp->x = lx;
+    tp->y = ly;
+    tp->time_msec = time;
+
+    if (_touch_idle) return;
+    // All motion libinput had queued, for every finger, is dispatched before the loop goes idle
+    _touch_idle = wl_event_loop_add_idle(seat.input.server.wl_event_loop,
+                                         [](void* data) {
+                                           auto& self = *(Cursor*) data;
+                                           self._touch_idle = nullptr;
+                                           self.flush_touch_motion();
+                                         },
+                                         this);
+  }
+
+  auto Cursor::flush_touch_motion() -> void
+  {
+    if (_touch_idle) {
+      wl_event_source_remove(_touch_idle);
+      _touch_idle = nullptr;
+    }
+    for (auto& tp : _touch_points) {
+      if (tp.has_motion) send_touch_motion(tp);
+    }
+  }
+
+  auto Cursor::send_touch_motion(TouchPoint& tp) -> void
+  {
+    tp.has_motion = false;
+    auto* wlr_seat = seat.wlr_seat;
+    if (!wlr_seat_touch_get_point(wlr_seat, tp.touch_id)) return;
+
+    double sx = 0, sy = 0;
+    wlr::surface_t* surface = nullptr;
+    bool grabbed = wlr_seat->touch_state.grab != wlr_seat->touch_state.default_grab;
+    if (grabbed || tp.retarget) {
+      View* view;
+      surface = seat.input.server.desktop.surface_at(tp.x, tp.y, sx, sy, view);
+    } else if (tp.surface) {
+      surface = tp.surface;
+      // Follow the view if it was moved under the finger
+      sx = tp.x - tp.lx;
+      sy = tp.y - tp.ly;
+      if (tp.view) {
+        sx -= tp.view->x - tp.view_x;
+        sy -= tp.view->y - tp.view_y;
+      }
+    }
+
+    if (surface && seat.allow_input(*surface->resource)) {
+      wlr_seat_touch_point_focus(wlr_seat, surface, tp.time_msec, tp.touch_id, sx, sy);
+      wlr_seat_touch_notify_motion(wlr_seat, tp.time_msec, tp.touch_id, sx, sy);
+    } else {
+      wlr_seat_touch_point_clear_focus(wlr_seat, tp.time_msec, tp.touch_id);
+    }
+
+    if (tp.touch_id == seat.touch_id) {
+      seat.touch_x = tp.x;
+      seat.touch_y = tp.y;
+    }
+  }
+
+  auto Cursor::tool_surface_at(TabletTool& tool, unsigned time, double& sx, double& sy)
+    -> wlr::surface_t*
+  {
+    double lx = wlr_cursor->x, ly = wlr_cursor->y;
+    auto& hit = tool.hit;
+    // Popups are stacked over the cached surface, and may have opened since
+    if (hit.surface && time - hit.time_msec < TabletTool::hit_lifetime_msec &&
+        hit.view->x == hit.view_x && hit.view->y == hit.view_y && !hit.view->has_popups()) {
+      sx = lx - hit.lx;
+      sy = ly - hit.ly;
+      auto& state = hit.surface->current;
+      if (sx >= 0 && sy >= 0 && sx < state.width && sy < state.height &&
+          pixman_region32_contains_point(&hit.surface->input_region, floor(sx), floor(sy),
+                                         nullptr)) {
+        return hit.surface;
+      }
+    }
+    tool.invalidate_hit();
+
+    View* view = nullptr;
+    Desktop& desktop = seat.input.server.desktop;
+    wlr::surface_t* surface = desktop.surface_at(lx, ly, sx, sy, view);
+    // Only the main surface of an unrotated view is a plain box in layout coordinates, with
+    // nothing of its own stacked over it
+    if (surface && view && surface == view->wlr_surface && view->rotation == 0 &&
+        wl_list_empty(&surface->subsurfaces)) {
+      hit = {.view = view,
+             .surface = surface,
+             .lx = lx - sx,
+             .ly = ly - sy,
+             .view_x = view->x,
+             .view_y = view->y,
+             .time_msec = time};
+      tool.on_hit_view_unmap.add_to(view->events.unmap);
+      tool.on_hit_surface_destroy.add_to(surface->events.destroy);
+    }
+    return surface;
+  }
+
   auto Cursor::handle_tablet_tool_position(Tablet& tablet,
-                                           wlr::tablet_tool_t* wlr_tool,
+                                           TabletTool& tool,
                                            bool change_x,
                                            bool change_y,
                                            double x,
@@ -28,7 +178,7 @@ namespace cloth {
     if (!change_x && !change_y) {
       return;
     }
-    switch (wlr_tool->type) {
+    switch (tool.tablet_v2_tool.wlr_tool->type) {
     case WLR_TABLET_TOOL_TYPE_MOUSE:
       // They are 0 either way when they weren't modified
       wlr_cursor_move(wlr_cursor, &tablet.wlr_device, dx, dy);
@@ -38,10 +188,7 @@ namespace cloth {
                                change_y ? y : NAN);
     }
     double sx, sy;
-    View* view = nullptr;
-    Desktop& desktop = seat.input.server.desktop;
-    wlr::surface_t* surface = desktop.surface_at(wlr_cursor->x, wlr_cursor->y, sx, sy, view);
-    auto& tool = *(TabletTool*) wlr_tool->data;
+    wlr::surface_t* surface = tool_surface_at(tool, time, sx, sy);
     if (!surface) {
       wlr_send_tablet_v2_tablet_tool_proximity_out(&tool.tablet_v2_tool);
       if (!tool.in_fallback_mode) LOGD("No surface found, Using tablet tool in fallback mode");
@@ -66,12 +213,63 @@ namespace cloth {
     wlr_send_tablet_v2_tablet_tool_motion(&tool.tablet_v2_tool, sx, sy);
   }
 
+  void Cursor::send_tool_axes(TabletTool& tool)
+  {
+    auto axes = std::exchange(tool.pending, {});
+    auto* v2_tool = &tool.tablet_v2_tool;
+
+    /**
+     * We need to handle them ourselves, not pass it into the cursor
+     * without any consideration
+     */
+    handle_tablet_tool_position(*tool.current_tablet, tool, axes.updated & WLR_TABLET_TOOL_AXIS_X,
+                                axes.updated & WLR_TABLET_TOOL_AXIS_Y, axes.x, axes.y, axes.dx,
+                                axes.dy, axes.time_msec);
+    if (axes.updated & WLR_TABLET_TOOL_AXIS_PRESSURE) {
+      wlr_send_tablet_v2_tablet_tool_pressure(v2_tool, axes.pressure);
+    }
+    if (axes.updated & WLR_TABLET_TOOL_AXIS_DISTANCE) {
+      wlr_send_tablet_v2_tablet_tool_distance(v2_tool, axes.distance);
+    }
+    if (axes.updated & (WLR_TABLET_TOOL_AXIS_TILT_X | WLR_TABLET_TOOL_AXIS_TILT_Y)) {
+      wlr_send_tablet_v2_tablet_tool_tilt(v2_tool, axes.tilt_x, axes.tilt_y);
+    }
+    if (axes.updated & WLR_TABLET_TOOL_AXIS_ROTATION) {
+      wlr_send_tablet_v2_tablet_tool_rotation(v2_tool, axes.rotation);
+    }
+    if (axes.updated & WLR_TABLET_TOOL_AXIS_SLIDER) {
+      wlr_send_tablet_v2_tablet_tool_slider(v2_tool, axes.slider);
+    }
+    if (axes.updated & WLR_TABLET_TOOL_AXIS_WHEEL) {
+      wlr_send_tablet_v2_tablet_tool_wheel(v2_tool, axes.wheel_delta, 0);
+    }
+  }
 
   Cursor::Cursor(Seat& p_seat, wlr::cursor_t* p_cursor) noexcept
-    : seat(p_seat), wlr_cursor(p_cursor), default_xcursor(xcursor_default)
+    : seat(p_seat),
+      wlr_cursor(p_cursor),
+      default_xcursor(xcursor_default),
+      gestures(p_seat.input.server.desktop)
   {
     Desktop& desktop = seat.input.server.desktop;
     wlr_cursor_attach_output_layout(wlr_cursor, desktop.layout);
+    pixman_region32_init(&_confine);
+
+    on_constraint_commit = [this] {
+      // wlroots has updated the region by now, it is the input region of the surface clipped
+      // to the one the client asked for
+      if (active_constraint->type == WLR_POINTER_CONSTRAINT_V1_CONFINED) {
+        pixman_region32_copy(&_confine, &active_constraint->region);
+      }
+    };
+    on_constraint_destroy = [this] {
+      // Its resource is gone, so it isn't sent deactivated
+      warp_to_cursor_hint();
+      active_constraint = nullptr;
+      on_constraint_commit.remove();
+      on_constraint_destroy.remove();
+      pixman_region32_clear(&_confine);
+    };
 
     // add input signals
     on_motion.add_to(wlr_cursor->events.motion);
@@ -79,7 +277,15 @@ namespace cloth {
       wlr_idle_notify_activity(seat.input.server.desktop.idle, seat.wlr_seat);
       set_visible(true);
       auto* event = (wlr::event_pointer_motion_t*) data;
-      wlr_cursor_move(wlr_cursor, event->device, event->delta_x, event->delta_y);
+      wlr_relative_pointer_manager_v1_send_relative_motion(
+        seat.input.server.desktop.relative_pointer_manager, seat.wlr_seat,
+        uint64_t(event->time_msec) * 1000, event->delta_x, event->delta_y, event->unaccel_dx,
+        event->unaccel_dy);
+      // The relative motion is all a locked pointer's client needs, nothing else moves
+      if (is_locked()) return;
+      double dx = event->delta_x, dy = event->delta_y;
+      if (!confine(dx, dy)) return;
+      wlr_cursor_move(wlr_cursor, event->device, dx, dy);
       update_position(event->time_msec);
     };
 
@@ -88,6 +294,7 @@ namespace cloth {
       wlr_idle_notify_activity(seat.input.server.desktop.idle, seat.wlr_seat);
       set_visible(true);
       auto* event = (wlr::event_pointer_motion_absolute_t*) data;
+      if (is_locked()) return;
       wlr_cursor_warp_absolute(wlr_cursor, event->device, event->x, event->y);
       update_position(event->time_msec);
     };
@@ -110,11 +317,53 @@ namespace cloth {
                                    event->delta, event->delta_discrete, event->source);
     };
 
+    // Touchpad gestures are not passed on to clients. Those with too few fingers are dropped.
+    on_swipe_begin.add_to(wlr_cursor->events.swipe_begin);
+    on_swipe_begin = [this](void* data) {
+      wlr_idle_notify_activity(seat.input.server.desktop.idle, seat.wlr_seat);
+      auto* event = (wlr::event_pointer_swipe_begin_t*) data;
+      gestures.swipe_begin(event->fingers);
+    };
+
+    on_swipe_update.add_to(wlr_cursor->events.swipe_update);
+    on_swipe_update = [this](void* data) {
+      wlr_idle_notify_activity(seat.input.server.desktop.idle, seat.wlr_seat);
+      auto* event = (wlr::event_pointer_swipe_update_t*) data;
+      gestures.swipe_update(event->dx, event->dy);
+    };
+
+    on_swipe_end.add_to(wlr_cursor->events.swipe_end);
+    on_swipe_end = [this](void* data) {
+      auto* event = (wlr::event_pointer_swipe_end_t*) data;
+      gestures.swipe_end(event->cancelled);
+    };
+
+    on_pinch_begin.add_to(wlr_cursor->events.pinch_begin);
+    on_pinch_begin = [this](void* data) {
+      wlr_idle_notify_activity(seat.input.server.desktop.idle, seat.wlr_seat);
+      auto* event = (wlr::event_pointer_pinch_begin_t*) data;
+      gestures.pinch_begin(event->fingers);
+    };
+
+    on_pinch_update.add_to(wlr_cursor->events.pinch_update);
+    on_pinch_update = [this](void* data) {
+      wlr_idle_notify_activity(seat.input.server.desktop.idle, seat.wlr_seat);
+      auto* event = (wlr::event_pointer_pinch_update_t*) data;
+      gestures.pinch_update(event->scale);
+    };
+
+    on_pinch_end.add_to(wlr_cursor->events.pinch_end);
+    on_pinch_end = [this](void* data) {
+      auto* event = (wlr::event_pointer_pinch_end_t*) data;
+      gestures.pinch_end(event->cancelled);
+    };
+
     on_touch_down.add_to(wlr_cursor->events.touch_down);
     on_touch_down = [this](void* data) {
       wlr_idle_notify_activity(seat.input.server.desktop.idle, seat.wlr_seat);
       auto* event = (wlr::event_touch_down_t*) data;
       Desktop& desktop = seat.input.server.desktop;
+      flush_touch_motion();
       double lx, ly;
       wlr_cursor_absolute_to_layout_coords(wlr_cursor, event->device, event->x, event->y, &lx, &ly);
       _is_visible = true;
@@ -124,16 +373,13 @@ namespace cloth {
       View* v;
       auto* surface = desktop.surface_at(lx, ly, sx, sy, v);
 
-      if (wlr_seat_touch_num_points(this->seat.wlr_seat) == 0 && !current_gesture) {
-        auto* output = desktop.output_at(lx, ly);
-        if (output) {
-          current_gesture =
-            TouchGesture::create(event->touch_id, {lx, ly},
-                                 {output->wlr_output.lx, output->wlr_output.ly,
-                                  output->wlr_output.width, output->wlr_output.height});
-          if (current_gesture)
-            LOGD("Gesture possibly begun: {}", util::enum_cast(current_gesture.value().side));
-        }
+      if (wlr_seat_touch_num_points(this->seat.wlr_seat) == 0) {
+        gestures.touch_down(event->touch_id, {lx, ly});
+      }
+
+      // Tapping a thumbnail picks it
+      if (!gestures.is_active()) {
+        if (desktop.switcher.select_at(lx, ly) || desktop.overview.select_at(lx, ly)) return;
       }
 
       uint32_t serial = 0;
@@ -141,6 +387,7 @@ namespace cloth {
         serial = wlr_seat_touch_notify_down(this->seat.wlr_seat, surface, event->time_msec,
                                             event->touch_id, sx, sy);
       }
+      if (serial) add_touch_point(event->touch_id, surface, v, lx - sx, ly - sy);
 
       if (serial && wlr_seat_touch_num_points(this->seat.wlr_seat) == 1) {
         seat.touch_id = event->touch_id;
@@ -162,28 +409,11 @@ namespace cloth {
     on_touch_up = [this](void* data) {
       wlr_idle_notify_activity(seat.input.server.desktop.idle, seat.wlr_seat);
       auto* event = (wlr::event_touch_up_t*) data;
+      flush_touch_motion();
+      if (auto* tp = touch_point(event->touch_id)) util::erase_this(_touch_points, tp);
       wlr::touch_point_t* point = wlr_seat_touch_get_point(this->seat.wlr_seat, event->touch_id);
 
-      if (current_gesture) {
-        bool valid = current_gesture.value().on_touch_up({seat.touch_x, seat.touch_y});
-        if (valid) {
-          LOGD("SlideGesture detected: {}", util::enum_cast(current_gesture.value().side));
-          switch (current_gesture.value().side) {
-          case Side::top:
-            seat.input.server.desktop.run_command("exec killall cloth-bar || cloth-bar");
-            break;
-          case Side::bottom:
-            seat.input.server.desktop.run_command("exec killall cloth-kbd || cloth-kbd");
-            break;
-          case Side::left: seat.input.server.desktop.run_command("switch_workspace prev"); break;
-          case Side::right: seat.input.server.desktop.run_command("switch_workspace next"); break;
-          default: break;
-          }
-        } else {
-          LOGD("Gesture cancelled");
-        }
-        current_gesture = std::nullopt;
-      }
+      gestures.touch_up(event->touch_id);
 
       if (!point) {
         return;
@@ -206,32 +436,14 @@ namespace cloth {
     on_touch_motion = [this](void* data) {
       wlr_idle_notify_activity(seat.input.server.desktop.idle, seat.wlr_seat);
       auto* event = (wlr::event_touch_motion_t*) data;
-      auto& desktop = seat.input.server.desktop;
-      wlr::touch_point_t* point = wlr_seat_touch_get_point(this->seat.wlr_seat, event->touch_id);
-      if (!point) {
-        return;
-      }
 
       double lx, ly;
       wlr_cursor_absolute_to_layout_coords(wlr_cursor, event->device, event->x, event->y, &lx, &ly);
+      // Edge drags usually start outside of any surface, so they have no touch point
+      gestures.touch_motion(event->touch_id, {lx, ly});
 
-      double sx, sy;
-      View* view;
-      wlr::surface_t* surface = desktop.surface_at(lx, ly, sx, sy, view);
-
-      if (surface && seat.allow_input(*surface->resource)) {
-        wlr_seat_touch_point_focus(this->seat.wlr_seat, surface, event->time_msec, event->touch_id,
-                                   sx, sy);
-        wlr_seat_touch_notify_motion(this->seat.wlr_seat, event->time_msec, event->touch_id, sx,
-                                     sy);
-      } else {
-        wlr_seat_touch_point_clear_focus(this->seat.wlr_seat, event->time_msec, event->touch_id);
-      }
-
-      if (event->touch_id == seat.touch_id) {
-        seat.touch_x = lx;
-        seat.touch_y = ly;
-      }
+      // Motion is reported per finger, the whole frame is sent together
+      queue_touch_motion(event->touch_id, lx, ly, event->time_msec);
     };
 
     on_tool_axis.add_to(wlr_cursor->events.tablet_tool_axis);
@@ -241,33 +453,8 @@ namespace cloth {
       auto* event = (wlr::event_tablet_tool_axis_t*) data;
       assert(event->tool->data);
       auto& tool = *(TabletTool*) event->tool->data;
-      auto& tablet = *(Tablet*) event->device->data;
-
-      /**
-       * We need to handle them ourselves, not pass it into the cursor
-       * without any consideration
-       */
-      handle_tablet_tool_position(tablet, event->tool, event->updated_axes & WLR_TABLET_TOOL_AXIS_X,
-                                  event->updated_axes & WLR_TABLET_TOOL_AXIS_Y, event->x, event->y,
-                                  event->dx, event->dy, event->time_msec);
-      if (event->updated_axes & WLR_TABLET_TOOL_AXIS_PRESSURE) {
-        wlr_send_tablet_v2_tablet_tool_pressure(&tool.tablet_v2_tool, event->pressure);
-      }
-      if (event->updated_axes & WLR_TABLET_TOOL_AXIS_DISTANCE) {
-        wlr_send_tablet_v2_tablet_tool_distance(&tool.tablet_v2_tool, event->distance);
-      }
-      if (event->updated_axes & (WLR_TABLET_TOOL_AXIS_TILT_X | WLR_TABLET_TOOL_AXIS_TILT_Y)) {
-        wlr_send_tablet_v2_tablet_tool_tilt(&tool.tablet_v2_tool, event->tilt_x, event->tilt_y);
-      }
-      if (event->updated_axes & WLR_TABLET_TOOL_AXIS_ROTATION) {
-        wlr_send_tablet_v2_tablet_tool_rotation(&tool.tablet_v2_tool, event->rotation);
-      }
-      if (event->updated_axes & WLR_TABLET_TOOL_AXIS_SLIDER) {
-        wlr_send_tablet_v2_tablet_tool_slider(&tool.tablet_v2_tool, event->slider);
-      }
-      if (event->updated_axes & WLR_TABLET_TOOL_AXIS_WHEEL) {
-        wlr_send_tablet_v2_tablet_tool_wheel(&tool.tablet_v2_tool, event->wheel_delta, 0);
-      }
+      // Pens report axes at a couple hundred Hz, they are sent once per event loop iteration
+      tool.queue_axes(*(Tablet*) event->device->data, *event);
     };
 
     on_tool_tip.add_to(wlr_cursor->events.tablet_tool_tip);
@@ -276,6 +463,9 @@ namespace cloth {
       set_visible(true);
       auto* event = (wlr::event_tablet_tool_tip_t*) data;
       auto& tool = *(TabletTool*) event->tool->data;
+      tool.flush_axes();
+      // Pressing down may raise a view over the one that was hit
+      tool.invalidate_hit();
 
       auto button =
         event->tool->type == WLR_TABLET_TOOL_TYPE_ERASER ? wlr::Button::right : wlr::Button::left;
@@ -299,19 +489,20 @@ namespace cloth {
 
     on_tool_proximity.add_to(wlr_cursor->events.tablet_tool_proximity);
     on_tool_proximity = [this](void* data) {
-      Desktop& desktop = seat.input.server.desktop;
       wlr_idle_notify_activity(seat.input.server.desktop.idle, seat.wlr_seat);
       set_visible(true);
       auto* event = (wlr::event_tablet_tool_proximity_t*) data;
       wlr::tablet_tool_t* wlr_tool = event->tool;
       if (!wlr_tool->data) {
-        // This is attached to wlr_tool.data, and deleted when wlr_tool is destroyed
-        // TODO: cleaner solution? I mean, this works fine...
-        new TabletTool(seat, *wlr_tablet_tool_create(desktop.tablet_v2, seat.wlr_seat, wlr_tool));
+        // Attaches itself to wlr_tool.data, and is erased when wlr_tool is destroyed
+        seat.tablet_tools.emplace_back(seat, *wlr_tool);
       }
+      auto& tool = *(TabletTool*) wlr_tool->data;
+      tool.flush_axes();
+      tool.invalidate_hit();
       if (event->state == WLR_TABLET_TOOL_PROXIMITY_IN) {
-        handle_tablet_tool_position(*(Tablet*) event->device->data, event->tool, true, true,
-                                    event->x, event->y, 0, 0, event->time_msec);
+        handle_tablet_tool_position(*(Tablet*) event->device->data, tool, true, true, event->x,
+                                    event->y, 0, 0, event->time_msec);
       }
     };
 
@@ -322,6 +513,7 @@ namespace cloth {
       set_visible(true);
       auto* event = (wlr::event_tablet_tool_button_t*) data;
       auto& tool = *(TabletTool*) event->tool->data;
+      tool.flush_axes();
 
       wlr_send_tablet_v2_tablet_tool_button(&tool.tablet_v2_tool,
                                             (enum zwp_tablet_pad_v2_button_state) event->button,
@@ -351,7 +543,8 @@ namespace cloth {
 
   Cursor::~Cursor() noexcept
   {
-    // TODO
+    if (_touch_idle) wl_event_source_remove(_touch_idle);
+    pixman_region32_fini(&_confine);
   }
 
   auto Cursor::set_visible(bool vis) -> void
@@ -365,6 +558,103 @@ namespace cloth {
     _is_visible = vis;
   }
 
+  auto Cursor::is_locked() const noexcept -> bool
+  {
+    return active_constraint && active_constraint->type == WLR_POINTER_CONSTRAINT_V1_LOCKED &&
+           seat.wlr_seat->keyboard_state.focused_surface == active_constraint->surface;
+  }
+
+  void Cursor::handle_new_constraint(wlr::pointer_constraint_v1_t& constraint)
+  {
+    double sx, sy;
+    View* view = nullptr;
+    auto* surface =
+      seat.input.server.desktop.surface_at(wlr_cursor->x, wlr_cursor->y, sx, sy, view);
+    if (surface == constraint.surface) update_constraint(surface, view, sx, sy);
+  }
+
+  auto Cursor::update_constraint(wlr::surface_t* surface, View* view, double sx, double sy)
+    -> void
+  {
+    wlr::pointer_constraint_v1_t* constraint = nullptr;
+    if (surface && surface == seat.wlr_seat->keyboard_state.focused_surface) {
+      constraint = wlr_pointer_constraints_v1_constraint_for_surface(
+        seat.input.server.desktop.pointer_constraints, surface, seat.wlr_seat);
+    }
+    if (constraint) {
+      _constraint_lx = wlr_cursor->x - sx;
+      _constraint_ly = wlr_cursor->y - sy;
+      _can_confine = view == nullptr || view->rotation == 0;
+    }
+    constrain(constraint, sx, sy);
+  }
+
+  auto Cursor::constrain(wlr::pointer_constraint_v1_t* constraint, double sx, double sy) -> void
+  {
+    if (active_constraint == constraint) return;
+
+    on_constraint_commit.remove();
+    on_constraint_destroy.remove();
+    pixman_region32_clear(&_confine);
+    if (active_constraint) {
+      warp_to_cursor_hint();
+      wlr_pointer_constraint_v1_send_deactivated(active_constraint);
+    }
+
+    active_constraint = constraint;
+    if (constraint == nullptr) return;
+
+    LOGD("Activating pointer constraint");
+    wlr_pointer_constraint_v1_send_activated(constraint);
+    on_constraint_commit.add_to(constraint->surface->events.commit);
+    on_constraint_destroy.add_to(constraint->events.destroy);
+
+    auto* region = &constraint->region;
+    if (!pixman_region32_contains_point(region, floor(sx), floor(sy), nullptr)) {
+      // Move into the region, if there is one
+      int nboxes;
+      auto* boxes = pixman_region32_rectangles(region, &nboxes);
+      if (nboxes > 0) {
+        wlr_cursor_warp_closest(wlr_cursor, nullptr,
+                                _constraint_lx + (boxes[0].x1 + boxes[0].x2) / 2.,
+                                _constraint_ly + (boxes[0].y1 + boxes[0].y2) / 2.);
+      }
+    }
+
+    // Locked pointers keep an empty region, which allows no motion at all
+    if (constraint->type == WLR_POINTER_CONSTRAINT_V1_CONFINED) {
+      pixman_region32_copy(&_confine, region);
+    }
+  }
+
+  auto Cursor::warp_to_cursor_hint() -> void
+  {
+    auto* constraint = active_constraint;
+    if (constraint == nullptr || constraint->type != WLR_POINTER_CONSTRAINT_V1_LOCKED) return;
+    if (!(constraint->current.committed & WLR_POINTER_CONSTRAINT_V1_STATE_CURSOR_HINT)) return;
+    wlr_cursor_warp(wlr_cursor, nullptr, _constraint_lx + constraint->current.cursor_hint.x,
+                    _constraint_ly + constraint->current.cursor_hint.y);
+  }
+
+  auto Cursor::confine(double& dx, double& dy) -> bool
+  {
+    if (active_constraint == nullptr) return true;
+    // Focus moved elsewhere without the pointer moving, like switching windows with the keyboard
+    if (seat.wlr_seat->keyboard_state.focused_surface != active_constraint->surface) {
+      constrain(nullptr, 0, 0);
+      return true;
+    }
+    if (!_can_confine) return true;
+
+    double sx1 = wlr_cursor->x - _constraint_lx;
+    double sy1 = wlr_cursor->y - _constraint_ly;
+    double sx2, sy2;
+    if (!wlr_region_confine(&_confine, sx1, sy1, sx1 + dx, sy1 + dy, &sx2, &sy2)) return false;
+    dx = sx2 - sx1;
+    dy = sy2 - sy1;
+    return true;
+  }
+
   void Cursor::passthrough_cursor(uint32_t time)
   {
     double sx, sy;
@@ -378,6 +668,7 @@ namespace cloth {
     if (surface && !seat.allow_input(*surface->resource)) {
       return;
     }
+    update_constraint(surface, view, sx, sy);
 
     if (cursor_client != client) {
       if (_is_visible) wlr_xcursor_manager_set_cursor_image(xcursor_manager, default_xcursor.c_str(), wlr_cursor);
@@ -482,6 +773,10 @@ namespace cloth {
   {
     auto& desktop = seat.input.server.desktop;
 
+    if (state == WLR_BUTTON_PRESSED) {
+      if (desktop.switcher.select_at(lx, ly) || desktop.overview.select_at(lx, ly)) return;
+    }
+
     bool is_touch = device.type == WLR_INPUT_DEVICE_TOUCH;
 
     double sx, sy;
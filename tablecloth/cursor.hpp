@@ -1,5 +1,7 @@
 #pragma once
 
+#include "util/ptr_vec.hpp"
+
 #include "wlroots.hpp"
 
 #include "gesture.hpp"
@@ -9,6 +11,35 @@ namespace cloth {
   struct Seat;
   struct SeatView;
   struct Tablet;
+  struct TabletTool;
+  struct View;
+
+  /// A touch point, and the surface it went down on.
+  ///
+  /// Touch sequences stay on the surface they started on, so where that surface is in the layout
+  /// is remembered instead of hit testing every motion. Points are only hit tested again while a
+  /// grab like drag and drop is active, or when they are on a rotated view. A point whose
+  /// surface goes away loses focus until it is lifted.
+  struct TouchPoint {
+    TouchPoint(int touch_id) noexcept;
+
+    int touch_id;
+    wlr::surface_t* surface = nullptr;
+    View* view = nullptr;
+    /// Layout coordinates of the surface origin, and the view position they were computed at
+    double lx = 0, ly = 0;
+    double view_x = 0, view_y = 0;
+    /// Hit test every motion
+    bool retarget = false;
+
+    /// Latest motion that hasn't been sent, in layout coordinates
+    bool has_motion = false;
+    double x = 0, y = 0;
+    uint32_t time_msec = 0;
+
+    wl::Listener on_view_unmap;
+    wl::Listener on_surface_destroy;
+  };
 
   struct Cursor {
     enum struct Mode { Passthrough = 0, Move, Resize, Rotate };
@@ -18,6 +49,13 @@ namespace cloth {
 
     void update_position(uint32_t time);
     void set_visible(bool);
+    /// Move the cursor and send the axes a tablet tool has pending
+    void send_tool_axes(TabletTool& tool);
+
+    /// Activate a new pointer constraint right away if its surface has focus
+    void handle_new_constraint(wlr::pointer_constraint_v1_t& constraint);
+    /// A locked pointer doesn't move, its client only gets relative motion
+    auto is_locked() const noexcept -> bool;
 
     // Member data
 
@@ -40,11 +78,20 @@ namespace cloth {
 
     SeatView* pointer_view = nullptr;
 
+    wlr::pointer_constraint_v1_t* active_constraint = nullptr;
+
     wl::Listener on_motion;
     wl::Listener on_motion_absolute;
     wl::Listener on_button;
     wl::Listener on_axis;
 
+    wl::Listener on_swipe_begin;
+    wl::Listener on_swipe_update;
+    wl::Listener on_swipe_end;
+    wl::Listener on_pinch_begin;
+    wl::Listener on_pinch_update;
+    wl::Listener on_pinch_end;
+
     wl::Listener on_touch_down;
     wl::Listener on_touch_up;
     wl::Listener on_touch_motion;
@@ -56,6 +103,9 @@ namespace cloth {
 
     wl::Listener on_request_set_cursor;
 
+    wl::Listener on_constraint_commit;
+    wl::Listener on_constraint_destroy;
+
   private:
     void passthrough_cursor(uint32_t time);
     void press_button(wlr::input_device_t& device,
@@ -66,7 +116,7 @@ namespace cloth {
                       double ly);
 
     auto handle_tablet_tool_position(Tablet& tablet,
-                                     wlr::tablet_tool_t* wlr_tool,
+                                     TabletTool& tool,
                                      bool change_x,
                                      bool change_y,
                                      double x,
@@ -74,8 +124,39 @@ namespace cloth {
                                      double dx,
                                      double dy,
                                      unsigned time) -> void;
-
-    std::optional<TouchGesture> current_gesture = std::nullopt;
+    /// Pick the constraint of the surface under the cursor. Only surfaces with keyboard focus
+    /// get to constrain the pointer.
+    auto update_constraint(wlr::surface_t* surface, View* view, double sx, double sy) -> void;
+    auto constrain(wlr::pointer_constraint_v1_t* constraint, double sx, double sy) -> void;
+    /// Move the cursor to where the client of a locked pointer wants it to be left
+    auto warp_to_cursor_hint() -> void;
+    /// Limit relative motion to the region of a confined pointer
+    auto confine(double& dx, double& dy) -> bool;
+
+    auto touch_point(int touch_id) -> TouchPoint*;
+    auto add_touch_point(int touch_id, wlr::surface_t* surface, View* view, double lx, double ly)
+      -> void;
+    /// Keep the latest motion of a touch point, sent once the event loop is idle
+    auto queue_touch_motion(int touch_id, double lx, double ly, uint32_t time) -> void;
+    /// Send queued touch motion right away, before events that have to come after it
+    auto flush_touch_motion() -> void;
+    auto send_touch_motion(TouchPoint& tp) -> void;
+
+    /// Hit test for a tablet tool, reusing the last one while it is still valid
+    auto tool_surface_at(TabletTool& tool, unsigned time, double& sx, double& sy)
+      -> wlr::surface_t*;
+
+    GestureRecognizer gestures;
+
+    /// The region a confined pointer stays in, in surface coordinates. Empty when locked.
+    pixman_region32_t _confine;
+    /// Layout coordinates of the origin of the constrained surface
+    double _constraint_lx = 0, _constraint_ly = 0;
+    /// Rotated views can't be confined to
+    bool _can_confine = true;
+
+    util::ptr_vec<TouchPoint> _touch_points;
+    wl::event_source_t* _touch_idle = nullptr;
 
     bool _is_visible = true;
   };
@@ -7,8 +7,6 @@
 #include "render.hpp"
 #include "render_utils.hpp"
 
-#include <GLES2/gl2.h>
-
 namespace cloth {
 
   Decoration::Decoration(View& v) : view(v) {}
@@ -96,72 +94,6 @@ namespace cloth {
 
   namespace render {
 
-    auto shadow_shader()
-    {
-      static Shader shader = {R"END(
-uniform mat3 proj;
-uniform vec4 color;
-attribute vec2 pos;
-attribute vec2 texcoord;
-varying vec4 v_color;
-varying vec2 v_texcoord;
-
-void main() {
-	gl_Position = vec4(proj * vec3(pos, 1.0), 1.0);
-	v_color = color;
-	v_texcoord = texcoord;
-}
-)END",
-                              R"END(
-precision mediump float;
-varying vec4 v_color;
-varying vec2 v_texcoord;
-uniform float aspect;
-uniform float radius;
-
-void main()
-{
-  vec2 pos = v_texcoord;
-
-  //pos.x /= aspect;
-
-  float dx = smoothstep(0.0, radius * aspect, min(pos.x, 1.0 - pos.x));
-  float dy = smoothstep(0.0, radius, min(pos.y, 1.0 - pos.y));
-
-  float alpha = dx * dy;
-  gl_FragColor = vec4(v_color.rgb, v_color.a * alpha);
-}
-    )END"};
-      return shader;
-    } // namespace render
-
-    static void draw_quad(void)
-    {
-      GLfloat verts[] = {
-        1, 0, // top right
-        0, 0, // top left
-        1, 1, // bottom right
-        0, 1, // bottom left
-      };
-      GLfloat texcoord[] = {
-        1, 0, // top right
-        0, 0, // top left
-        1, 1, // bottom right
-        0, 1, // bottom left
-      };
-
-      glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, verts);
-      glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 0, texcoord);
-
-      glEnableVertexAttribArray(0);
-      glEnableVertexAttribArray(1);
-
-      glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
-
-      glDisableVertexAttribArray(0);
-      glDisableVertexAttribArray(1);
-    }
-
     auto Context::draw_shadow(wlr::box_t box,
                               float rotation,
                               float alpha,
@@ -173,40 +105,8 @@ void main()
       box.height += radius;
       box.width += radius;
 
-      wlr::box_t rotated;
-      wlr_box_rotated_bounds(&box, rotation, &rotated);
-
       pixman_region32_t damage;
-      pixman_region32_init(&damage);
-      pixman_region32_union_rect(&damage, &damage, rotated.x, rotated.y, rotated.width,
-                                 rotated.height);
-      pixman_region32_intersect(&damage, &damage, &pixman_damage);
-      bool damaged = pixman_region32_not_empty(&damage);
-      if (damaged) {
-        float matrix[9];
-        wlr_matrix_project_box(matrix, &box, WL_OUTPUT_TRANSFORM_NORMAL, rotation,
-                               output.wlr_output.transform_matrix);
-
-        int nrects;
-        pixman_box32_t* rects = pixman_region32_rectangles(&damage, &nrects);
-        for (int i = 0; i < nrects; ++i) {
-          scissor_output(output, &rects[i]);
-
-          float transposition[9];
-          wlr_matrix_transpose(transposition, matrix);
-
-          shadow_shader().use();
-
-          // update the uniform color
-          glUniformMatrix3fv(glGetUniformLocation(shadow_shader().ID, "proj"), 1, false,
-                             transposition);
-          shadow_shader().set("color", 0.f, 0.f, 0.f, alpha);
-          shadow_shader().set("aspect", box.height / (float) box.width);
-          shadow_shader().set("radius", radius / (float) box.height);
-          draw_quad();
-        }
-      }
-
+      if (clip(box, rotation, damage)) backend->draw_shadow(damage, box, rotation, alpha, radius);
       pixman_region32_fini(&damage);
     }
 
@@ -241,9 +141,6 @@ void main()
         return;
       }
 
-      wlr::renderer_t* renderer = wlr_backend_get_renderer(output.wlr_output.backend);
-      assert(renderer);
-
       wlr::box_t box = get_decoration_box(view, output);
       double x_scale = data.layout.width / double(view.width);
       double y_scale = data.layout.height / double(view.height);
@@ -256,34 +153,14 @@ void main()
 
       if (!view.deco.is_visible()) return;
 
-      wlr::box_t rotated;
-      wlr_box_rotated_bounds(&box, view.rotation, &rotated);
+      std::array<float, 4> color;
+      if (view.active)
+        color = {0x00 / 255.f, 0x59 / 255.f, 0x73 / 255.f, data.alpha};
+      else
+        color = {0.2, 0.2, 0.23, data.alpha};
 
       pixman_region32_t damage;
-      pixman_region32_init(&damage);
-      pixman_region32_union_rect(&damage, &damage, rotated.x, rotated.y, rotated.width,
-                                 rotated.height);
-      pixman_region32_intersect(&damage, &damage, &pixman_damage);
-      bool damaged = pixman_region32_not_empty(&damage);
-      if (damaged) {
-        float matrix[9];
-        wlr_matrix_project_box(matrix, &box, WL_OUTPUT_TRANSFORM_NORMAL, view.rotation,
-                               output.wlr_output.transform_matrix);
-        std::array<float, 4> color;
-        if (view.active)
-          color = {0x00 / 255.f, 0x59 / 255.f, 0x73 / 255.f, data.alpha};
-        else
-          color = {0.2, 0.2, 0.23, data.alpha};
-
-        int nrects;
-        pixman_box32_t* rects = pixman_region32_rectangles(&damage, &nrects);
-        for (int i = 0; i < nrects; ++i) {
-          scissor_output(output, &rects[i]);
-
-          wlr_render_quad_with_matrix(renderer, color.data(), matrix);
-        }
-      }
-
+      if (clip(box, view.rotation, damage)) backend->draw_rect(damage, box, view.rotation, color);
       pixman_region32_fini(&damage);
     }
 
@@ -10,7 +10,7 @@
 #include "util/iterators.hpp"
 #include "util/exception.hpp"
 
-#include <charconv>
+#include <algorithm>
 #include <sys/wait.h>
 #include <unistd.h>
 
@@ -23,6 +23,8 @@ namespace cloth {
     wlr::output_t* wlr_output = wlr_output_layout_output_at(layout, lx, ly);
     if (wlr_output != nullptr) {
       Output* output = output_from_wlr_output(wlr_output);
+      // Views are hidden behind the overview
+      if (output != nullptr && overview.covers(*output)) return nullptr;
       if (output != nullptr && output->workspace->fullscreen_view != nullptr) {
         if (output->workspace->fullscreen_view->at(lx, ly, surface, sx, sy)) {
           return output->workspace->fullscreen_view;
@@ -111,15 +113,21 @@ namespace cloth {
   }
 
   Desktop::Desktop(Server& p_server, Config& p_config) noexcept
-    : workspaces(util::generate_array<10>([this](int n) { return Workspace(*this, n); })),
-      server(p_server),
+    : server(p_server),
       config(p_config)
   {
     LOGD("Initializing tablecloth desktop");
 
     on_new_output = [this](void* data) {
       LOGD("New output");
-      outputs.emplace_back(*this, workspaces[0], *(wlr::output_t*) data);
+      // Show the first workspace that isn't shown on another output yet
+      int index = 0;
+      while (find_workspace(index) && find_workspace(index)->is_visible()) index++;
+      auto& output = outputs.emplace_back(*this, get_workspace(index), *(wlr::output_t*) data);
+      server.workspace_manager.send_output_state(output);
+      server.output_manager.add_output(output);
+      server.window_manager.send_output(output);
+      overview.invalidate();
 
       for (auto& seat : server.input.seats) {
         seat.configure_cursor();
@@ -133,6 +141,8 @@ namespace cloth {
 
     on_layout_change.add_to(layout->events.change);
     on_layout_change = [this](void* data) {
+      for (auto& output : outputs) output.context.invalidate_transforms();
+
       wlr::output_t* center_output = wlr_output_layout_get_center_output(this->layout);
       if (center_output == nullptr) return;
 
@@ -146,10 +156,15 @@ namespace cloth {
           if (wlr_output_layout_intersects(this->layout, nullptr, &box)) continue;
           view.move(center_x - box.width / 2, center_y - box.height / 2);
         }
+        // Maximized and tiled views follow the output
+        schedule_arrange(output);
       }
     };
 
     compositor = wlr_compositor_create(server.wl_display, server.renderer);
+    if (config.renderer == Config::Renderer::pixman) {
+      surface_images = std::make_unique<render::SurfaceImages>(*compositor);
+    }
 
     xdg_shell_v6 = wlr_xdg_shell_v6_create(server.wl_display);
     on_xdg_shell_v6_surface = [this](void* data) { handle_xdg_shell_v6_surface(data); };
@@ -226,6 +241,10 @@ namespace cloth {
       wlr_primary_selection_device_manager_create(server.wl_display);
     idle = wlr_idle_create(server.wl_display);
     idle_inhibit = wlr_idle_inhibit_v1_create(server.wl_display);
+    on_new_idle_inhibitor = [this](void* data) {
+      power.add_inhibitor(*(wlr::idle_inhibitor_v1_t*) data);
+    };
+    on_new_idle_inhibitor.add_to(idle_inhibit->events.new_inhibitor);
 
     input_inhibit = wlr_input_inhibit_manager_create(server.wl_display);
     on_input_inhibit_activate = [this](void* data) {
@@ -263,6 +282,15 @@ namespace cloth {
 
     screencopy = wlr_screencopy_manager_v1_create(server.wl_display);
 
+    relative_pointer_manager = wlr_relative_pointer_manager_v1_create(server.wl_display);
+    pointer_constraints = wlr_pointer_constraints_v1_create(server.wl_display);
+    on_new_pointer_constraint = [this](void* data) {
+      auto& constraint = *(wlr::pointer_constraint_v1_t*) data;
+      auto* seat = this->server.input.seat_from_wlr_seat(*constraint.seat);
+      if (seat) seat->cursor.handle_new_constraint(constraint);
+    };
+    on_new_pointer_constraint.add_to(pointer_constraints->events.new_constraint);
+
     xdg_decoration_manager_v1 = wlr_xdg_decoration_manager_v1_create(server.wl_display);
     on_xdg_toplevel_decoration = [this](void* data) { handle_xdg_toplevel_decoration(data); };
     on_xdg_toplevel_decoration.add_to(xdg_decoration_manager_v1->events.new_toplevel_decoration);
@@ -271,6 +299,8 @@ namespace cloth {
   Desktop::~Desktop() noexcept
   {
     // TODO
+    if (_collect_idle) wl_event_source_remove(_collect_idle);
+    if (_arrange_idle) wl_event_source_remove(_arrange_idle);
   }
 
   Output* Desktop::output_from_wlr_output(wlr::output_t* wlr_output)
@@ -281,41 +311,104 @@ namespace cloth {
     return nullptr;
   }
 
-  util::ref_vec<View> Desktop::visible_views()
+  auto Desktop::focused_output() -> Output&
   {
-    util::ref_vec<View> res;
-    for (auto& ws : workspaces) {
-      if (!ws.is_visible()) continue;
-      auto views = ws.visible_views();
-      res.reserve(res.size() + views.size());
-      util::copy(views.underlying(), std::back_inserter(res.underlying()));
+    assert(!outputs.empty());
+    if (!server.input.seats.empty()) {
+      auto& cursor = *server.input.seats.front().cursor.wlr_cursor;
+      if (auto* output = output_at(cursor.x, cursor.y); output) return *output;
     }
-    return res;
+    return outputs.front();
   }
 
   auto Desktop::current_workspace() -> Workspace&
   {
-    return *outputs.front().workspace;
+    return *focused_output().workspace;
+  }
+
+  auto Desktop::switch_to_workspace(Workspace& workspace) -> Workspace&
+  {
+    return switch_to_workspace(focused_output(), workspace);
   }
 
-  auto Desktop::switch_to_workspace(int idx) -> Workspace&
+  auto Desktop::switch_to_workspace(Output& output, Workspace& workspace) -> Workspace&
   {
-    assert(idx >= 0 && idx < workspace_count);
+    if (output.workspace == &workspace) return workspace;
+    Workspace& prev = *output.workspace;
+
+    // Outputs can't show the same workspace, take it from the other output
+    auto other = util::find_if(outputs, [&](Output& o) { return o.workspace == &workspace; });
+    if (other != outputs.end()) {
+      other->workspace = output.workspace;
+      other->context.damage_whole();
+    }
+    output.workspace = &workspace;
+    output.context.damage_whole();
+    overview.invalidate();
+
     for (auto& seat : server.input.seats) {
-      seat.set_focus(workspaces[idx].focused_view());
+      seat.set_focus(workspace.focused_view());
     }
-    // TODO: Properly support multiple outputs
-    // with separate workspaces
-    for (auto& output : outputs) {
-      output.workspace = &workspaces[idx];
-      output.context.damage_whole();
+    {
+      TransactionScope scope(*this);
+      for (auto* o : {&output, other != outputs.end() ? &*other : nullptr}) {
+        if (o == nullptr) continue;
+        for (auto& view : o->workspace->visible_views()) {
+          view.arrange();
+        }
+        o->workspace->layout_tree.arrange();
+      }
+    }
+    server.workspace_manager.send_output_state(output);
+    if (other != outputs.end()) server.workspace_manager.send_output_state(*other);
+    server.window_manager.send_focused_window_name(workspace);
+    for (auto* o : {&output, other != outputs.end() ? &*other : nullptr}) {
+      if (o == nullptr) continue;
+      server.window_manager.send_output(*o);
+      server.window_manager.send_workspace(*o->workspace);
     }
-    for (auto& view : workspaces[idx].visible_views()) {
-      view.arrange();
+    // Not shown on any output anymore
+    if (other == outputs.end()) server.window_manager.send_workspace(prev);
+    // Views enter and leave outputs with their workspace
+    for (auto* ws : {&prev, &workspace}) {
+      for (auto& view : ws->views()) server.foreign_toplevel_manager.update_view(view);
     }
-    server.workspace_manager.send_state();
-    server.window_manager.send_focused_window_name(workspaces[idx]);
-    return workspaces[idx];
+    collect_workspaces();
+    return workspace;
+  }
+
+  auto Desktop::schedule_arrange(Output& output) -> void
+  {
+    output.needs_arrange = true;
+    if (_arrange_idle) return;
+    _arrange_idle = wl_event_loop_add_idle(server.wl_event_loop,
+                                           [](void* data) {
+                                             auto& self = *(Desktop*) data;
+                                             self._arrange_idle = nullptr;
+                                             self.arrange_outputs();
+                                           },
+                                           this);
+  }
+
+  auto Desktop::arrange_outputs() -> void
+  {
+    if (_arrange_idle) {
+      wl_event_source_remove(_arrange_idle);
+      _arrange_idle = nullptr;
+    }
+    {
+      TransactionScope scope(*this);
+      for (auto& output : outputs) {
+        if (!output.needs_arrange) continue;
+        output.needs_arrange = false;
+        server.window_manager.send_output(output);
+        // Disabled outputs have no place in the layout to arrange views in
+        if (!wlr_output_layout_get(layout, &output.wlr_output)) continue;
+        arrange_layers(output);
+      }
+    }
+    overview.invalidate();
+    server.output_manager.send_state();
   }
 
   static bool outputs_enabled = true;
@@ -350,6 +443,15 @@ namespace cloth {
     }
   }
 
+  /// Parse a workspace argument: next, prev, an index or a name
+  static auto parse_workspace(Desktop& desktop, std::string_view str) -> Workspace&
+  {
+    int current = desktop.current_workspace().index;
+    if (str == "next") return desktop.get_workspace(current + 1);
+    if (str == "prev") return desktop.get_workspace(std::max(current - 1, 0));
+    return desktop.get_workspace(str);
+  }
+
   void Desktop::run_command(std::string_view command_str)
   {
     Input& input = server.input;
@@ -361,6 +463,8 @@ namespace cloth {
 
       if (command == "exit") {
         wl_display_terminate(input.server.wl_display);
+      } else if (command == "reload") {
+        server.config_watcher.reload();
       } else if (command == "close") {
         View* focus = current_workspace().focused_view();
         if (focus != nullptr) {
@@ -378,7 +482,17 @@ namespace cloth {
           focus->set_fullscreen(!is_fullscreen, nullptr);
         }
       } else if (command == "next_window") {
-        input.server.desktop.current_workspace().cycle_focus();
+        switcher.next();
+      } else if (command == "prev_window") {
+        switcher.prev();
+      } else if (command == "switcher") {
+        auto& arg = args.at(0);
+        if (arg == "commit")
+          switcher.commit();
+        else if (arg == "cancel")
+          switcher.cancel();
+        else
+          throw util::exception("Invalid argument. Expected commit or cancel. Got {}", arg);
       } else if (command == "alpha") {
         View* focus = current_workspace().focused_view();
         if (focus != nullptr) {
@@ -392,44 +506,96 @@ namespace cloth {
         if (focus != nullptr) {
           focus->maximize(!focus->maximized);
         }
+      } else if (command == "minimize") {
+        View* focus = current_workspace().focused_view();
+        if (focus != nullptr) {
+          focus->minimize(true);
+        }
+      } else if (command == "unminimize") {
+        // Restore the minimized view that was focused last
+        auto views = util::view::reverse(current_workspace().views());
+        auto view = util::find_if(views, [](View& v) { return v.minimized; });
+        if (view != views.end()) view->minimize(false);
       } else if (command == "nop") {
         LOGD("nop command");
       } else if (command == "toggle_outputs") {
         outputs_enabled = !outputs_enabled;
         for (auto& output : outputs) {
-          wlr_output_enable(&output.wlr_output, outputs_enabled);
+          output.idle_off = false;
+          output.set_power(outputs_enabled);
         }
       } else if (command == "switch_workspace") {
-        int workspace = -1;
-        auto ws_str = args.at(0);
-        if (ws_str == "next") // +10 fixes wrapping backwards
-          workspace = (input.server.desktop.current_workspace().index + 1 + 10) % 10;
-        else if (ws_str == "prev")
-          workspace = (input.server.desktop.current_workspace().index - 1 + 10) % 10;
+        switch_to_workspace(parse_workspace(*this, args.at(0)));
+      } else if (command == "overview") {
+        std::string arg = args.empty() ? "workspace" : args.at(0);
+        if (arg == "workspace")
+          overview.toggle(Overview::Mode::workspace);
+        else if (arg == "all")
+          overview.toggle(Overview::Mode::all);
+        else if (arg == "off")
+          overview.exit();
         else
-          std::from_chars(&*ws_str.begin(), &*ws_str.end(), workspace);
-        if (workspace >= 0 && workspace < 10) {
-          input.server.desktop.switch_to_workspace(workspace);
-        }
+          throw util::exception("Invalid argument. Expected workspace, all or off. Got {}", arg);
       } else if (command == "move_workspace") {
         View* focus = current_workspace().focused_view();
         if (focus != nullptr) {
-          int workspace = -1;
-          auto ws_str = args.at(0);
-          if (ws_str == "next")
-            workspace = (input.server.desktop.current_workspace().index + 1 + 10) % 10;
-          else if (ws_str == "prev")
-            workspace = (input.server.desktop.current_workspace().index - 1 + 10) % 10;
-          else
-            std::from_chars(&*ws_str.begin(), &*ws_str.end(), workspace);
-          if (workspace >= 0 && workspace < 10) {
-            input.server.desktop.workspaces.at(workspace).add_view(
-              focus->workspace->erase_view(*focus));
+          auto& workspace = parse_workspace(*this, args.at(0));
+          if (&workspace != &*focus->workspace) {
+            workspace.add_view(focus->workspace->erase_view(*focus));
           }
         }
+      } else if (command == "tiling") {
+        auto& tree = current_workspace().layout_tree;
+        std::string arg = args.empty() ? "toggle" : args.at(0);
+        if (arg == "on")
+          tree.set_enabled(true);
+        else if (arg == "off")
+          tree.set_enabled(false);
+        else if (arg == "toggle")
+          tree.set_enabled(!tree.enabled());
+        else
+          throw util::exception("Invalid argument. Expected on, off or toggle. Got {}", arg);
+      } else if (command == "layout") {
+        View* focus = current_workspace().focused_view();
+        if (focus != nullptr) {
+          current_workspace().layout_tree.set_layout(*focus, tiling::parse_layout(args.at(0)));
+        }
+      } else if (command == "split") {
+        View* focus = current_workspace().focused_view();
+        if (focus != nullptr) {
+          current_workspace().layout_tree.split(*focus, tiling::parse_layout(args.at(0)));
+        }
+      } else if (command == "focus") {
+        View* focus = current_workspace().focused_view();
+        if (focus != nullptr) {
+          auto dir = tiling::parse_direction(args.at(0));
+          current_workspace().set_focused_view(current_workspace().layout_tree.neighbour(*focus, dir));
+        }
+      } else if (command == "move") {
+        View* focus = current_workspace().focused_view();
+        if (focus != nullptr) {
+          current_workspace().layout_tree.move(*focus, tiling::parse_direction(args.at(0)));
+        }
+      } else if (command == "resize") {
+        View* focus = current_workspace().focused_view();
+        if (focus != nullptr) {
+          auto& arg = args.at(0);
+          if (arg != "grow" && arg != "shrink")
+            throw util::exception("Invalid argument. Expected grow or shrink. Got {}", arg);
+          current_workspace().layout_tree.resize(*focus, arg == "grow" ? 0.1f : -0.1f);
+        }
+      } else if (command == "toggle_floating") {
+        View* focus = current_workspace().focused_view();
+        if (focus != nullptr) {
+          focus->floating = !focus->floating;
+          if (focus->floating)
+            focus->workspace->layout_tree.remove(*focus);
+          else
+            focus->workspace->layout_tree.insert(*focus);
+        }
       } else if (command == "toggle_decoration_mode") {
         View* focus = current_workspace().focused_view();
-        if (auto xdg = dynamic_cast<XdgSurface*>(focus); xdg) {
+        if (auto xdg = view_cast<XdgSurface>(focus); xdg) {
           auto* decoration = xdg->xdg_toplevel_decoration.get();
           if (decoration) {
             auto mode = decoration->wlr_decoration.current_mode;
@@ -453,7 +619,9 @@ namespace cloth {
           if (rotation == "270") return WL_OUTPUT_TRANSFORM_270;
           throw util::exception("Invalid rotation. Expected 0,90,180 or 270. Got {}", rotation);
         }();
+        // Only the transform, so outputs that are off or idle stay that way
         wlr_output_set_transform(&output->wlr_output, transform);
+        input.server.desktop.arrange_outputs();
       } else {
         LOGE("unknown binding command: {}", command);
       }
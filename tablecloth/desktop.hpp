@@ -1,13 +1,23 @@
 #pragma once
 
 #include <chrono>
+#include <string>
+#include <unordered_map>
 
 #include "wlroots.hpp"
 
 #include "util/chrono.hpp"
 
+#include "animation.hpp"
 #include "config.hpp"
 #include "output.hpp"
+#include "overview.hpp"
+#include "power.hpp"
+#include "render_gles2.hpp"
+#include "render_pixman.hpp"
+#include "switcher.hpp"
+#include "thumbnail.hpp"
+#include "transaction.hpp"
 #include "view.hpp"
 #include "workspace.hpp"
 
@@ -25,14 +35,40 @@ namespace cloth {
     wlr::surface_t* surface_at(double lx, double ly, double& sx, double& sy, View*& view);
     Output* output_at(double x, double y);
 
-    util::ref_vec<View> visible_views();
+    /// The output commands act on, i.e. the one the cursor of the default seat is on
+    Output& focused_output();
+    /// The workspace shown on the focused output
     Workspace& current_workspace();
-    Workspace& switch_to_workspace(int idx);
+    Workspace& switch_to_workspace(Workspace& workspace);
+    /// Show a workspace on the given output. If it is shown on another output, the two outputs
+    /// swap workspaces.
+    Workspace& switch_to_workspace(Output& output, Workspace& workspace);
+
+    /// The workspace with the given index, created if it doesn't exist yet
+    Workspace& get_workspace(int index);
+    /// The workspace with the given name, created if it doesn't exist yet.
+    /// Numbers refer to the workspace with that index, other names get a fresh index.
+    Workspace& get_workspace(std::string_view name);
+    Workspace* find_workspace(int index);
+    /// Destroy workspaces which are empty and not shown, once the current event is handled
+    void collect_workspaces();
+    /// Arrange the layers and views of an output once the current event is handled, so
+    /// changing the mode, scale, transform and position of several outputs arranges each once
+    void schedule_arrange(Output& output);
+    /// Arrange the outputs waiting for it right away, in one transaction
+    void arrange_outputs();
 
     void run_command(std::string_view command);
 
+    /// Open a transaction, or join the one already open. Prefer using TransactionScope
+    Transaction& begin_transaction();
+    /// Close a transaction. Commits it once the outermost caller is done
+    void end_transaction();
+
   private:
     View* view_at(double lx, double ly, wlr::surface_t*& surface, double& sx, double& sy);
+    auto create_workspace(int index, std::string name) -> Workspace&;
+    auto destroy_unused_workspaces() -> void;
 
     // These are implemented in the src/*_shell.cpp files
     void handle_xdg_shell_v6_surface(void* data);
@@ -45,13 +81,23 @@ namespace cloth {
   public:
     // DATA //
 
-    static constexpr std::size_t workspace_count = 10;
-
-    std::array<Workspace, workspace_count> workspaces;
+    /// Workspaces only exist while they have views or are shown on an output
+    std::unordered_map<int, std::unique_ptr<Workspace>> workspaces;
 
     util::ptr_vec<Output> outputs;
     chrono::time_point last_frame;
 
+    /// Downscaled copies of views, drawn by the overview and the switcher
+    render::ThumbnailCache thumbnails = {*this};
+    /// CPU copies of client buffers, only kept for the pixman renderer
+    std::unique_ptr<render::SurfaceImages> surface_images;
+    /// Effect programs of the GLES2 renderer, linked with the first output
+    std::unique_ptr<render::Programs> programs;
+    Overview overview = {*this};
+    Switcher switcher = {*this};
+    Animations animations = {*this};
+    PowerManager power = {*this};
+
     Server& server;
     Config& config;
 
@@ -77,6 +123,19 @@ namespace cloth {
     wlr::virtual_keyboard_manager_v1_t* virtual_keyboard = nullptr;
     wlr::screencopy_manager_v1_t* screencopy = nullptr;
     wlr::tablet_manager_v2_t* tablet_v2 = nullptr;
+    wlr::relative_pointer_manager_v1_t* relative_pointer_manager = nullptr;
+    wlr::pointer_constraints_v1_t* pointer_constraints = nullptr;
+
+    /// The transaction currently collecting geometry changes
+    std::unique_ptr<Transaction> open_transaction;
+    /// The committed transaction waiting for clients to ack
+    std::unique_ptr<Transaction> pending_transaction;
+    int transaction_depth = 0;
+
+  private:
+    std::unordered_map<std::string, Workspace*> _named_workspaces;
+    wl::event_source_t* _collect_idle = nullptr;
+    wl::event_source_t* _arrange_idle = nullptr;
 
   protected:
     wl::Listener on_new_output;
@@ -90,6 +149,8 @@ namespace cloth {
     wl::Listener on_input_inhibit_activate;
     wl::Listener on_input_inhibit_deactivate;
     wl::Listener on_virtual_keyboard_new;
+    wl::Listener on_new_pointer_constraint;
+    wl::Listener on_new_idle_inhibitor;
 
     wl::listener_t test;
 
@@ -0,0 +1,277 @@
+#include "gesture.hpp"
+
+#include <algorithm>
+
+#include "util/algorithm.hpp"
+
+#include "desktop.hpp"
+#include "output.hpp"
+#include "workspace.hpp"
+
+namespace cloth {
+
+  using seconds_d = std::chrono::duration<double>;
+
+  Progress::Progress(double value) noexcept : _value(value), _target(value) {}
+
+  auto Progress::track(double value, chrono::time_point when) -> void
+  {
+    value = std::clamp(value, 0.0, 1.0);
+    if (_tracking) {
+      double dt = seconds_d(when - _when).count();
+      // Smoothed, so a single uneven event doesn't decide where it settles
+      if (dt > 0) _velocity = 0.6 * (value - _value) / dt + 0.4 * _velocity;
+    } else {
+      _velocity = 0;
+    }
+    _tracking = true;
+    _value = _target = value;
+    _when = when;
+  }
+
+  auto Progress::release(chrono::time_point when) -> double
+  {
+    double value = at(when);
+    double velocity = _velocity;
+    double target = value + velocity * seconds_d(projection).count() >= 0.5 ? 1 : 0;
+    settle_from(value, target, when);
+
+    // Keep going at the speed it was let go with. The cubic ease out starts out three times
+    // faster than its average speed.
+    double distance = std::abs(target - value);
+    if (distance > 0 && velocity * (target - value) > 0) {
+      auto time = seconds_d(3 * distance / std::abs(velocity));
+      _settle_time = std::clamp(chrono::duration_cast<chrono::duration>(time), min_settle_time,
+                                max_settle_time);
+    }
+    return target;
+  }
+
+  auto Progress::settle(double target, chrono::time_point when) -> void
+  {
+    settle_from(at(when), target, when);
+  }
+
+  auto Progress::settle_from(double value, double target, chrono::time_point when) -> void
+  {
+    _tracking = false;
+    _velocity = 0;
+    _value = value;
+    _target = target;
+    _when = when;
+    auto time = max_settle_time * std::abs(target - value);
+    _settle_time = chrono::duration_cast<chrono::duration>(time);
+  }
+
+  auto Progress::flip() -> void
+  {
+    _value = 1 - _value;
+    _target = 1 - _target;
+    _velocity = -_velocity;
+  }
+
+  auto Progress::at(chrono::time_point when) const -> double
+  {
+    if (_tracking) return _value;
+    if (_settle_time.count() <= 0) return _target;
+    double t = std::clamp(double((when - _when).count()) / _settle_time.count(), 0.0, 1.0);
+    t = 1 - t;
+    return _value + (_target - _value) * (1 - t * t * t);
+  }
+
+  auto Progress::settled(chrono::time_point when) const -> bool
+  {
+    return !_tracking && when - _when >= _settle_time;
+  }
+
+  GestureRecognizer::GestureRecognizer(Desktop& desktop) noexcept : desktop(desktop) {}
+
+  auto GestureRecognizer::begin(Output* output, Side side) -> void
+  {
+    _action = Action::undecided;
+    _output = output;
+    _side = side;
+    _delta = {0, 0};
+    _scale = 1;
+    _moved = false;
+    _pinch = false;
+  }
+
+  auto GestureRecognizer::swipe_begin(int fingers) -> bool
+  {
+    if (fingers < min_fingers || is_active() || desktop.outputs.empty()) return false;
+    begin(&desktop.focused_output(), Side::none);
+    _distance = touchpad_distance;
+    _offset = 0;
+    return true;
+  }
+
+  auto GestureRecognizer::swipe_update(double dx, double dy) -> void
+  {
+    if (!is_active() || _side != Side::none || _pinch) return;
+    _delta.x += dx;
+    _delta.y += dy;
+    update();
+  }
+
+  auto GestureRecognizer::swipe_end(bool cancelled) -> void
+  {
+    if (!is_active() || _side != Side::none || _pinch) return;
+    end(cancelled);
+  }
+
+  auto GestureRecognizer::pinch_begin(int fingers) -> bool
+  {
+    if (fingers < min_fingers || is_active() || desktop.outputs.empty()) return false;
+    begin(&desktop.focused_output(), Side::none);
+    _pinch = true;
+    _action = Action::overview;
+    _closing = desktop.overview.is_active();
+    return true;
+  }
+
+  auto GestureRecognizer::pinch_update(double scale) -> void
+  {
+    if (!is_active() || !_pinch) return;
+    _scale = scale;
+    update();
+  }
+
+  auto GestureRecognizer::pinch_end(bool cancelled) -> void
+  {
+    if (!is_active() || !_pinch) return;
+    end(cancelled);
+  }
+
+  auto GestureRecognizer::touch_down(int touch_id, Point point) -> bool
+  {
+    if (is_active()) return false;
+    auto* output = desktop.output_at(point.x, point.y);
+    if (output == nullptr) return false;
+
+    auto box = output->layout_box();
+    Side side = Side::none;
+    if (point.distx(box.x) <= edge_size) {
+      side = Side::left;
+    } else if (point.disty(box.y) <= edge_size) {
+      side = Side::top;
+    } else if (point.distx(box.x + box.width) <= edge_size) {
+      side = Side::right;
+    } else if (point.disty(box.y + box.height) <= edge_size) {
+      side = Side::bottom;
+    }
+    if (side == Side::none) return false;
+
+    begin(output, side);
+    _touch_id = touch_id;
+    _start = point;
+    // Drags from the bottom only start opening the overview a bit up, below that they are
+    // for the keyboard
+    bool vertical = side == Side::top || side == Side::bottom;
+    _distance = vertical ? box.height / 3.0 : box.width;
+    _offset = side == Side::bottom ? box.height / 6.0 : 0;
+    return true;
+  }
+
+  auto GestureRecognizer::touch_motion(int touch_id, Point point) -> void
+  {
+    if (!is_active() || touch_id != _touch_id) return;
+    _delta = {point.x - _start.x, point.y - _start.y};
+    update();
+  }
+
+  auto GestureRecognizer::touch_up(int touch_id) -> void
+  {
+    if (!is_active() || touch_id != _touch_id) return;
+    end(false);
+  }
+
+  auto GestureRecognizer::has_output() const -> bool
+  {
+    return util::any_of(desktop.outputs, [this](Output& o) { return &o == _output; });
+  }
+
+  auto GestureRecognizer::decide() -> void
+  {
+    auto start_workspace = [this](int direction) {
+      _direction = direction;
+      int index = _output->workspace->index + direction;
+      bool ok = index >= 0 && _output->begin_swipe(index);
+      _action = ok ? Action::workspace : Action::none;
+    };
+    auto start_overview = [this] {
+      _closing = desktop.overview.is_active();
+      _action = Action::overview;
+    };
+
+    switch (_side) {
+    case Side::none:
+      // Fingers moving left pull the next workspace in from the right
+      if (std::abs(_delta.x) > std::abs(_delta.y))
+        start_workspace(_delta.x < 0 ? 1 : -1);
+      else
+        start_overview();
+      break;
+    case Side::left: start_workspace(-1); break;
+    case Side::right: start_workspace(1); break;
+    case Side::bottom: start_overview(); break;
+    case Side::top: _action = Action::bar; break;
+    }
+  }
+
+  auto GestureRecognizer::update() -> void
+  {
+    // The output may have gone away mid gesture
+    if (!has_output()) {
+      end(true);
+      return;
+    }
+
+    if (_action == Action::undecided) {
+      if (_delta.dist({0, 0}) < threshold) return;
+      decide();
+    }
+
+    switch (_action) {
+    case Action::workspace: _output->update_swipe(-_direction * _delta.x / _distance); break;
+    case Action::overview: {
+      // Positive when swiping up or pinching in, towards opening
+      double amount = _pinch ? (1 - _scale) * 2 : (-_delta.y - _offset) / _distance;
+      if (!_moved) {
+        if (_closing ? amount >= 0 : amount <= 0) return;
+        desktop.overview.begin_gesture();
+        _moved = true;
+      }
+      desktop.overview.update_gesture(_closing ? 1 + amount : amount);
+      break;
+    }
+    default: break;
+    }
+  }
+
+  auto GestureRecognizer::end(bool cancelled) -> void
+  {
+    switch (_action) {
+    case Action::workspace:
+      if (has_output()) _output->end_swipe(cancelled);
+      break;
+    case Action::overview:
+      if (_moved) {
+        desktop.overview.end_gesture(cancelled);
+      } else if (_side == Side::bottom && !cancelled && -_delta.y >= min_length) {
+        desktop.run_command("exec killall cloth-kbd || cloth-kbd");
+      }
+      break;
+    case Action::bar:
+      if (!cancelled && _delta.y >= min_length) {
+        desktop.run_command("exec killall cloth-bar || cloth-bar");
+      }
+      break;
+    default: break;
+    }
+    _action = Action::none;
+    _output = nullptr;
+    _touch_id = -1;
+  }
+
+} // namespace cloth
@@ -11,6 +11,9 @@
 
 namespace cloth {
 
+  struct Desktop;
+  struct Output;
+
   enum struct Side { none = 0, top, right, bottom, left };
 
   struct Point {
@@ -33,63 +36,126 @@ namespace cloth {
     }
   };
 
-  struct TouchGesture {
-    static constexpr int radius = 10;
-    static constexpr int min_length = 100;
-    static constexpr chrono::duration max_time = chrono::seconds(1);
+  /// A value between 0 and 1 that follows a gesture, and settles on 0 or 1 once released.
+  ///
+  /// The end it settles on is picked from where it was let go and how fast it was moving, so a
+  /// short flick is enough. It then keeps moving at the speed it was released with, slowing down
+  /// as it arrives.
+  struct Progress {
+    /// How far ahead the release velocity is projected when picking the end to settle on
+    static constexpr chrono::duration projection = chrono::milliseconds(200);
+    static constexpr chrono::duration min_settle_time = chrono::milliseconds(80);
+    static constexpr chrono::duration max_settle_time = chrono::milliseconds(250);
+
+    Progress(double value = 0) noexcept;
+
+    /// Follow a gesture
+    auto track(double value, chrono::time_point when = chrono::clock::now()) -> void;
+    /// Let go, settling on 0 or 1. Returns the value it settles on
+    auto release(chrono::time_point when = chrono::clock::now()) -> double;
+    /// Move to target without a gesture
+    auto settle(double target, chrono::time_point when = chrono::clock::now()) -> void;
+    /// Swap the ends, so the value v becomes 1 - v
+    auto flip() -> void;
 
-    bool on_touch_up(Point p)
+    auto at(chrono::time_point when) const -> double;
+    /// Has it stopped moving
+    auto settled(chrono::time_point when) const -> bool;
+
+    auto is_tracking() const noexcept -> bool
     {
-      if (chrono::clock::now() > start + max_time) {
-        LOGD("Gesture cancelled: Too long");
-        return false;
-      }
-      switch (side) {
-      case Side::top:
-        if (start_point.distx(p.x) >= start_point.disty(p.y)) return false;
-        if (p.y - start_point.y >= min_length) return true;
-      case Side::left:
-        if (start_point.disty(p.y) >= start_point.distx(p.x)) return false;
-        if (p.x - start_point.x >= min_length) return true;
-      case Side::bottom:
-        if (start_point.distx(p.x) >= start_point.disty(p.y)) return false;
-        if (start_point.y - p.y >= min_length) return true;
-      case Side::right:
-        if (start_point.disty(p.y) >= start_point.distx(p.x)) return false;
-        if (start_point.x - p.y >= min_length) return true;
-      default: break;
-      }
-      return false;
+      return _tracking;
     }
 
-    static auto create(int touch_id, Point start_point, wlr::box_t output_box)
-      -> std::optional<TouchGesture>
+    auto target() const noexcept -> double
     {
-      TouchGesture res;
-      if (std::abs(start_point.distx(output_box.x)) <= radius) {
-        res.side = Side::left;
-      } else if (start_point.disty(output_box.y) <= radius) {
-        res.side = Side::top;
-      } else if (start_point.distx(output_box.x + output_box.width) <= radius) {
-        res.side = Side::right;
-      } else if (start_point.disty(output_box.y + output_box.height) <= radius) {
-        res.side = Side::bottom;
-      }
-      if (res.side == Side::none) {
-        return std::nullopt;
-      }
-      res.start_point = start_point;
-      res.touch_id = touch_id;
-      return res;
+      return _target;
     }
 
-    chrono::time_point start = chrono::clock::now();
-    Point start_point;
-    int touch_id;
-    Side side = Side::none;
+  private:
+    auto settle_from(double value, double target, chrono::time_point when) -> void;
+
+    /// The value at _when
+    double _value;
+    /// Per second, while tracking
+    double _velocity = 0;
+    chrono::time_point _when;
+    bool _tracking = false;
+    double _target;
+    chrono::duration _settle_time = {};
+  };
+
+  /// Recognizes gestures while they happen, and drives what they control directly instead of
+  /// classifying them once the fingers lift.
+  ///
+  /// Horizontal touchpad swipes and drags from the left and right edges of a touchscreen slide
+  /// between workspaces. Vertical touchpad swipes, pinches and drags up from the bottom edge
+  /// open and close the overview. Dragging down from the top edge toggles the bar.
+  struct GestureRecognizer {
+    /// Fewer fingers are left to scrolling and clients
+    static constexpr int min_fingers = 3;
+    /// Touchpad travel for a whole gesture
+    static constexpr double touchpad_distance = 300;
+    /// Travel before a gesture picks what it controls
+    static constexpr double threshold = 20;
+    /// Touchscreen drags starting this close to the edge of an output are gestures
+    static constexpr double edge_size = 10;
+    /// Shortest drag from the top or bottom edge that toggles the bar or keyboard
+    static constexpr double min_length = 100;
+
+    GestureRecognizer(Desktop& desktop) noexcept;
+
+    auto is_active() const noexcept -> bool
+    {
+      return _action != Action::none;
+    }
+
+    /// Returns false if the gesture is left alone
+    auto swipe_begin(int fingers) -> bool;
+    auto swipe_update(double dx, double dy) -> void;
+    auto swipe_end(bool cancelled) -> void;
+
+    /// Returns false if the gesture is left alone
+    auto pinch_begin(int fingers) -> bool;
+    auto pinch_update(double scale) -> void;
+    auto pinch_end(bool cancelled) -> void;
+
+    /// Start an edge drag if the point, in layout coordinates, is at the edge of an output.
+    /// Returns false if it isn't
+    auto touch_down(int touch_id, Point point) -> bool;
+    auto touch_motion(int touch_id, Point point) -> void;
+    auto touch_up(int touch_id) -> void;
 
   private:
-    TouchGesture() {}
+    enum struct Action { none, undecided, workspace, overview, bar };
+
+    auto begin(Output* output, Side side) -> void;
+    auto has_output() const -> bool;
+    auto decide() -> void;
+    auto update() -> void;
+    auto end(bool cancelled) -> void;
+
+    Desktop& desktop;
+    Action _action = Action::none;
+    Output* _output = nullptr;
+    /// The edge a touchscreen drag started from, none for touchpads
+    Side _side = Side::none;
+    int _touch_id = -1;
+    Point _start = {0, 0};
+    /// Travel since the gesture began
+    Point _delta = {0, 0};
+    /// Travel for a whole gesture
+    double _distance = touchpad_distance;
+    /// Travel that doesn't count towards the overview, for drags from the bottom edge
+    double _offset = 0;
+    /// 1 towards the next workspace, -1 towards the previous one
+    int _direction = 0;
+    /// The overview was open when the gesture began
+    bool _closing = false;
+    /// The gesture has moved the overview at all
+    bool _moved = false;
+    bool _pinch = false;
+    double _scale = 1;
   };
 
 } // namespace cloth
@@ -45,19 +45,7 @@ namespace cloth {
            device_type(device->type), seat_name);
 
       seat.add_device(*device);
-
-      if (dc && wlr_input_device_is_libinput(device)) {
-        struct libinput_device* libinput_dev = wlr_libinput_get_device_handle(device);
-
-        LOGD("input has config, tap_enabled: {}", dc->tap_enabled);
-        ;
-        if (dc->tap_enabled) {
-          libinput_device_config_tap_set_enabled(libinput_dev, LIBINPUT_CONFIG_TAP_ENABLED);
-        }
-        if (dc->natural_scroll) {
-          libinput_device_config_scroll_set_natural_scroll_enabled(libinput_dev, true);
-        }
-      }
+      configure_device(*device);
     };
     on_new_input.add_to(server.backend->events.new_input);
   }
@@ -67,6 +55,18 @@ namespace cloth {
     // TODO
   }
 
+  void Input::configure_device(wlr::input_device_t& device)
+  {
+    auto* dc = config.get_device(device);
+    if (!dc || !wlr_input_device_is_libinput(&device)) return;
+    struct libinput_device* libinput_dev = wlr_libinput_get_device_handle(&device);
+
+    LOGD("input has config, tap_enabled: {}", dc->tap_enabled);
+    libinput_device_config_tap_set_enabled(
+      libinput_dev, dc->tap_enabled ? LIBINPUT_CONFIG_TAP_ENABLED : LIBINPUT_CONFIG_TAP_DISABLED);
+    libinput_device_config_scroll_set_natural_scroll_enabled(libinput_dev, dc->natural_scroll);
+  }
+
   Seat* Input::last_active_seat()
   {
     Seat* _seat = nullptr;
@@ -1,5 +1,7 @@
 #include "keyboard.hpp"
 
+#include <tuple>
+
 #include <xkbcommon/xkbcommon.h>
 #include "util/algorithm.hpp"
 #include "util/exception.hpp"
@@ -204,6 +206,45 @@ namespace cloth {
                                             keysyms);
   }
 
+  bool Keyboard::handle_switcher_key(const xkb_keysym_t* keysyms,
+                                     size_t keysyms_len,
+                                     wlr::key_state_t state)
+  {
+    auto& switcher = seat.input.server.desktop.switcher;
+    if (!switcher.is_active()) return false;
+
+    for (size_t i = 0; i < keysyms_len; ++i) {
+      switch (keysyms[i]) {
+      case XKB_KEY_Escape:
+        if (state == WLR_KEY_PRESSED) switcher.cancel();
+        return true;
+      case XKB_KEY_Return:
+      case XKB_KEY_KP_Enter:
+        if (state == WLR_KEY_PRESSED) switcher.commit();
+        return true;
+      case XKB_KEY_Left:
+      case XKB_KEY_Up:
+        if (state == WLR_KEY_PRESSED) switcher.prev();
+        return true;
+      case XKB_KEY_Right:
+      case XKB_KEY_Down:
+        if (state == WLR_KEY_PRESSED) switcher.next();
+        return true;
+      default: break;
+      }
+    }
+    return false;
+  }
+
+  void Keyboard::commit_switcher_on_release()
+  {
+    auto& switcher = seat.input.server.desktop.switcher;
+    if (switcher.is_active() && switcher.commit_on_release &&
+        wlr_keyboard_get_modifiers(wlr_device.keyboard) == 0) {
+      switcher.commit();
+    }
+  }
+
   void Keyboard::handle_key(wlr::event_keyboard_key_t& event)
   {
     xkb_keycode_t keycode = event.keycode + 8;
@@ -211,6 +252,8 @@ namespace cloth {
     bool handled = false;
     uint32_t modifiers;
     const xkb_keysym_t* keysyms;
+    auto& switcher = seat.input.server.desktop.switcher;
+    bool switcher_was_active = switcher.is_active();
 
     // Handle translated keysyms
 
@@ -219,6 +262,9 @@ namespace cloth {
     if (event.state == WLR_KEY_RELEASED) {
       handled = execute_binding(pressed_keysyms_translated, modifiers, keysyms, keysyms_len);
     }
+    if (!handled) {
+      handled = handle_switcher_key(keysyms, keysyms_len, event.state);
+    }
 
     // Handle raw keysyms
     keysyms_len = keysyms_raw(keycode, &keysyms, &modifiers);
@@ -231,10 +277,17 @@ namespace cloth {
       wlr_seat_set_keyboard(seat.wlr_seat, &wlr_device);
       wlr_seat_keyboard_notify_key(seat.wlr_seat, event.time_msec, event.keycode, event.state);
     }
+
+    if (!switcher_was_active && switcher.is_active()) {
+      // Opened by a binding on this key
+      switcher.commit_on_release = wlr_keyboard_get_modifiers(wlr_device.keyboard) != 0;
+    }
+    commit_switcher_on_release();
   }
 
   void Keyboard::handle_modifiers()
   {
+    commit_switcher_on_release();
     wlr_seat_set_keyboard(seat.wlr_seat, &wlr_device);
     wlr_seat_keyboard_notify_modifiers(seat.wlr_seat, &wlr_device.keyboard->modifiers);
   }
@@ -271,13 +324,10 @@ namespace cloth {
     }
   }
 
-  Keyboard::Keyboard(Seat& seat, wlr::input_device_t& device) : Device(seat, device)
+  auto Keyboard::configure() -> void
   {
-    assert(device.type == WLR_INPUT_DEVICE_KEYBOARD);
-
-    device.data = this;
-
-    keyboard_config_merge(config, seat.input.config.get_keyboard(&device));
+    Config::Keyboard config;
+    keyboard_config_merge(config, seat.input.config.get_keyboard(&wlr_device));
     keyboard_config_merge(config, seat.input.config.get_keyboard(nullptr));
 
     Config::Keyboard env_config = {
@@ -289,6 +339,28 @@ namespace cloth {
     };
     keyboard_config_merge(config, &env_config);
 
+    auto same_keymap = [&](Config::Keyboard& a, Config::Keyboard& b) {
+      return std::tie(a.rules, a.model, a.layout, a.variant, a.options) ==
+             std::tie(b.rules, b.model, b.layout, b.variant, b.options);
+    };
+    bool keymap_changed = !_has_keymap || !same_keymap(config, this->config);
+    bool repeat_changed = !_has_keymap || config.repeat_rate != this->config.repeat_rate ||
+                          config.repeat_delay != this->config.repeat_delay;
+    this->config = config;
+
+    if (keymap_changed) {
+      LOGD("Setting keymap of keyboard {}", wlr_device.name);
+      set_keymap();
+    }
+    if (repeat_changed) {
+      int repeat_rate = (config.repeat_rate > 0) ? config.repeat_rate : 25;
+      int repeat_delay = (config.repeat_delay > 0) ? config.repeat_delay : 600;
+      wlr_keyboard_set_repeat_info(wlr_device.keyboard, repeat_rate, repeat_delay);
+    }
+  }
+
+  auto Keyboard::set_keymap() -> void
+  {
     struct xkb_rule_names rules = {0};
     rules.rules = config.rules.c_str();
     rules.model = config.model.c_str();
@@ -308,13 +380,19 @@ namespace cloth {
       throw util::exception("Cannot create XKB keymap");
     }
 
-    wlr_keyboard_set_keymap(device.keyboard, keymap);
+    wlr_keyboard_set_keymap(wlr_device.keyboard, keymap);
     xkb_keymap_unref(keymap);
     xkb_context_unref(context);
+    _has_keymap = true;
+  }
+
+  Keyboard::Keyboard(Seat& seat, wlr::input_device_t& device) : Device(seat, device)
+  {
+    assert(device.type == WLR_INPUT_DEVICE_KEYBOARD);
+
+    device.data = this;
 
-    int repeat_rate = (config.repeat_rate > 0) ? config.repeat_rate : 25;
-    int repeat_delay = (config.repeat_delay > 0) ? config.repeat_delay : 600;
-    wlr_keyboard_set_repeat_info(device.keyboard, repeat_rate, repeat_delay);
+    configure();
 
     on_keyboard_key.add_to(device.keyboard->events.key);
     on_keyboard_key = [this](void* data) {
@@ -37,7 +37,12 @@ namespace cloth {
 
     void execute_user_binding(std::string_view command);
 
+    /// Apply the config for this keyboard. The keymap is only rebuilt if it changed
+    auto configure() -> void;
+
   private:
+    auto set_keymap() -> void;
+
     bool execute_compositor_binding(xkb_keysym_t keysym);
 
     bool execute_binding(xkb_keysym_t* pressed_keysyms,
@@ -51,8 +56,18 @@ namespace cloth {
                             const xkb_keysym_t** keysyms,
                             uint32_t* modifiers);
 
+    /// Keys that move or close the window switcher while it is open
+    bool handle_switcher_key(const xkb_keysym_t* keysyms,
+                             size_t keysyms_len,
+                             wlr::key_state_t state);
+    /// A switcher opened with modifiers held stays open while they are, and commits once they
+    /// are released. Opened any other way, it waits for an explicit commit or cancel.
+    void commit_switcher_on_release();
+
     void handle_key(wlr::event_keyboard_key_t& event);
     void handle_modifiers();
+
+    bool _has_keymap = false;
   };
 
 } // namespace cloth
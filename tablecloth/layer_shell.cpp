@@ -192,8 +192,12 @@ namespace cloth {
                   usable_area, true);
     memcpy(&output.usable_area, &usable_area, sizeof(wlr::box_t));
 
-    for (View& view : output.workspace->visible_views()) {
-      view.arrange();
+    {
+      TransactionScope scope(output.desktop);
+      for (View& view : output.workspace->visible_views()) {
+        view.arrange();
+      }
+      output.workspace->layout_tree.arrange();
     }
 
     // Arrange non-exlusive surfaces from top->bottom
@@ -291,6 +295,7 @@ namespace cloth {
 
     on_surface_commit.add_to(layer_surface.surface->events.commit);
     on_surface_commit = [this](void* data) {
+      auto timer = output.desktop.server.client_accounting.time(*layer_surface.surface);
       wlr::box_t old_geo = geo;
       arrange_layers(output);
       if (old_geo != geo) {
@@ -15,12 +15,14 @@ namespace cloth {
 
   auto get_render_data(View& v) -> render::RenderData
   {
-    return {.layout = {.x = v.x,
-                       .y = v.y,
-                       .width = (double) v.width,
-                       .height = (double) v.height,
-                       .rotation = v.rotation},
-            .alpha = v.alpha};
+    render::RenderData data = {.layout = {.x = v.x,
+                                          .y = v.y,
+                                          .width = (double) v.width,
+                                          .height = (double) v.height,
+                                          .rotation = v.rotation},
+                               .alpha = v.alpha};
+    v.desktop.animations.apply(v, data);
+    return data;
   }
 
   auto Output::render() -> void
@@ -31,57 +33,105 @@ namespace cloth {
 
     context.reset();
 
-    if (prev_workspace != workspace && prev_workspace && ws_alpha >= 1.f) {
-      ws_alpha = 0;
+    // Switching workspaces without a gesture slides the old one out as well
+    if (prev_workspace != workspace) {
+      if (prev_workspace && !slide) {
+        slide = Slide{prev_workspace->index, Progress(1)};
+        slide->progress.settle(0);
+      }
+      prev_workspace = workspace;
     }
-    if (ws_alpha <= 1.f) ws_alpha += 0.1;
-    if (ws_alpha > 1.f) ws_alpha = 1.f;
 
-    if (prev_workspace == workspace && workspace->fullscreen_view) {
+    auto now = chrono::clock::now();
+    if (slide && slide->progress.settled(now)) slide.reset();
+
+    if (!slide && workspace->fullscreen_view) {
       context.fullscreen_view = workspace->fullscreen_view;
     } else {
-      float prev_ws_alpha = 1.f - ws_alpha;
-      if (prev_ws_alpha > 0 && prev_workspace) {
-        double dx = wlr_output.width * ws_alpha;
-        if (workspace->index < prev_workspace->index) dx = -dx;
-        for (auto& v : prev_workspace->visible_views()) {
-          auto data = get_render_data(v);
-          data.alpha *= prev_ws_alpha;
-          data.layout.x -= dx;
-          context.views.emplace_back(v, data);
+      double dx = 0;
+      if (slide) {
+        int side = slide->index > workspace->index ? 1 : -1;
+        double width = layout_box().width;
+        dx = slide->progress.at(now) * width * side;
+        // The other workspace might have no views, and not exist
+        if (auto* other = desktop.find_workspace(slide->index); other) {
+          for (auto& v : other->visible_views()) {
+            auto data = get_render_data(v);
+            data.layout.x += side * width - dx;
+            context.views.emplace_back(v, data);
+          }
         }
       }
 
-      if (ws_alpha >= 1.f) {
-        prev_workspace = workspace;
+      for (auto& v : workspace->visible_views()) {
+        auto data = get_render_data(v);
+        data.layout.x -= dx;
+        context.views.emplace_back(v, data);
       }
+    }
 
-      if (ws_alpha > 0) {
-        double dx = wlr_output.width * (1 - ws_alpha);
-        if (prev_workspace && workspace->index < prev_workspace->index) dx = -dx;
-        for (auto& v : workspace->visible_views()) {
-          auto data = get_render_data(v);
-          data.alpha *= ws_alpha;
-          data.layout.x += dx;
-          context.views.emplace_back(v, data);
-        }
-      }
+    if (desktop.pending_transaction && desktop.pending_transaction->affects(*this)) {
+      // Hold the old frame until every view in the transaction is ready
+      context.send_frame_done();
+    } else {
+      context.do_render();
     }
 
-    context.do_render();
+    if (slide) context.damage_whole();
+  }
 
-    if (ws_alpha < 1.f) context.damage_whole();
+  auto Output::set_power(bool on) -> void
+  {
+    if (disabled || wlr_output.enabled == on) return;
+    wlr_output_enable(&wlr_output, on);
+    // Nothing was drawn while it was off
+    if (on) context.damage_whole();
+    desktop.server.output_power_manager.send_mode(*this);
   }
 
-  static void set_mode(wlr::output_t& output, Config::Output& oc)
+  auto Output::set_dim(float value) -> void
   {
-    int mhz = (int) (oc.mode.refresh_rate * 1000);
+    if (dim == value) return;
+    dim = value;
+    context.damage_whole();
+  }
 
-    if (wl_list_empty(&output.modes)) {
-      // Output has no mode, try setting a custom one
-      wlr_output_set_custom_mode(&output, oc.mode.width, oc.mode.height, mhz);
-      return;
+  auto Output::begin_swipe(int index) -> bool
+  {
+    if (index == workspace->index || (slide && slide->progress.is_tracking())) return false;
+    slide = Slide{index, Progress()};
+    slide->progress.track(0);
+    return true;
+  }
+
+  auto Output::update_swipe(double progress) -> void
+  {
+    if (!slide || !slide->progress.is_tracking()) return;
+    slide->progress.track(progress);
+    context.damage_whole();
+  }
+
+  auto Output::end_swipe(bool cancelled) -> void
+  {
+    if (!slide || !slide->progress.is_tracking()) return;
+    if (cancelled) {
+      slide->progress.settle(0);
+    } else if (slide->progress.release() == 1) {
+      // Switch right away, and let the old workspace slide out from where it was let go
+      int index = workspace->index;
+      desktop.switch_to_workspace(*this, desktop.get_workspace(slide->index));
+      prev_workspace = workspace;
+      slide->index = index;
+      slide->progress.flip();
     }
+    context.damage_whole();
+  }
+
+  /// The mode of the output closest to the configured one, preferring the configured refresh
+  /// rate. Null if the output has no mode of the configured size
+  static auto find_mode(wlr::output_t& output, Config::Output& oc) -> wlr::output_mode_t*
+  {
+    int mhz = (int) (oc.mode.refresh_rate * 1000);
 
     wlr::output_mode_t *mode, *best = nullptr;
     wl_list_for_each(mode, &output.modes, link)
@@ -94,14 +144,70 @@ namespace cloth {
         best = mode;
       }
     }
-    if (!best) {
-      LOGE("Configured mode for {} not available", output.name);
-    } else {
-      LOGD("Assigning configured mode to {}", output.name);
-      wlr_output_set_mode(&output, best);
+    return best;
+  }
+
+  auto Output::add_config_modes(Config::Output& oc) -> void
+  {
+    if (wlr_output_is_drm(&wlr_output)) {
+      for (auto& mode : oc.modes) {
+        wlr_drm_connector_add_mode(&wlr_output, &mode.info);
+      }
+    } else if (!oc.modes.empty()) {
+      LOGE("Can only add modes for DRM backend");
+    }
+  }
+
+  auto Output::apply_config(Config::Output& oc) -> void
+  {
+    auto& output_manager = desktop.server.output_manager;
+    auto state = output_manager.current_state(*this);
+    state.enabled = oc.enable;
+    if (oc.enable) {
+      if (oc.mode.width) {
+        if (wl_list_empty(&wlr_output.modes)) {
+          // Output has no mode, try setting a custom one
+          state.mode = nullptr;
+          state.width = oc.mode.width;
+          state.height = oc.mode.height;
+          state.refresh = (int) (oc.mode.refresh_rate * 1000);
+        } else if (auto* mode = find_mode(wlr_output, oc); mode) {
+          LOGD("Assigning configured mode to {}", wlr_output.name);
+          state.mode = mode;
+        } else {
+          LOGE("Configured mode for {} not available", wlr_output.name);
+        }
+      }
+      state.scale = oc.scale;
+      state.transform = oc.transform;
+      state.x = oc.x;
+      state.y = oc.y;
+    }
+    if (!output_manager.apply_state(*this, state)) {
+      LOGE("Could not apply the config of output {}", wlr_output.name);
     }
   }
 
+  auto Output::layout_box() const -> wlr::box_t
+  {
+    return *wlr_output_layout_get_box(desktop.layout, &wlr_output);
+  }
+
+  auto Output::usable_layout_box() const -> wlr::box_t
+  {
+    auto box = layout_box();
+    return {.x = box.x + usable_area.x,
+            .y = box.y + usable_area.y,
+            .width = usable_area.width,
+            .height = usable_area.height};
+  }
+
+  auto Output::forget_workspace(Workspace& ws) noexcept -> void
+  {
+    assert(workspace != &ws);
+    if (prev_workspace == &ws) prev_workspace = nullptr;
+  }
+
   Output::Output(Desktop& p_desktop, Workspace& ws, wlr::output_t& wlr) noexcept
     : desktop(p_desktop), workspace(&ws), wlr_output(wlr), last_frame(chrono::clock::now())
   {
@@ -117,13 +223,35 @@ namespace cloth {
     }
 
     on_destroy.add_to(wlr_output.events.destroy);
-    on_destroy = [this] { util::erase_this(desktop.outputs, this); };
+    on_destroy = [this] {
+      auto& desktop = this->desktop;
+      if (desktop.switcher.covers(*this)) desktop.switcher.cancel();
+      desktop.server.output_power_manager.forget_output(*this);
+      desktop.server.output_manager.remove_output(*this);
+      desktop.server.window_manager.send_output_removed(*this);
+      desktop.server.foreign_toplevel_manager.remove_output(*this);
+      util::erase_this(desktop.outputs, this);
+      desktop.overview.invalidate();
+      desktop.collect_workspaces();
+    };
 
     on_mode.add_to(wlr_output.events.mode);
-    on_mode = [this] { arrange_layers(*this); };
+    on_mode = [this] {
+      context.invalidate_transforms();
+      desktop.schedule_arrange(*this);
+    };
 
     on_transform.add_to(wlr_output.events.transform);
-    on_transform = [this] { arrange_layers(*this); };
+    on_transform = [this] {
+      context.invalidate_transforms();
+      desktop.schedule_arrange(*this);
+    };
+
+    on_scale.add_to(wlr_output.events.scale);
+    on_scale = [this] {
+      context.invalidate_transforms();
+      desktop.schedule_arrange(*this);
+    };
 
     on_damage_frame.add_to(context.damage->events.frame);
     on_damage_frame = [this] { render(); };
@@ -133,25 +261,8 @@ namespace cloth {
 
     Config::Output* output_config = desktop.config.get_output(wlr_output);
     if (output_config) {
-      if (output_config->enable) {
-        if (wlr_output_is_drm(&wlr_output)) {
-          for (auto& mode : output_config->modes) {
-            wlr_drm_connector_add_mode(&wlr_output, &mode.info);
-          }
-        } else {
-          if (output_config->modes.empty()) {
-            LOGE("Can only add modes for DRM backend");
-          }
-        }
-        if (output_config->mode.width) {
-          set_mode(wlr_output, *output_config);
-        }
-        wlr_output_set_scale(&wlr_output, output_config->scale);
-        wlr_output_set_transform(&wlr_output, output_config->transform);
-        wlr_output_layout_add(desktop.layout, &wlr_output, output_config->x, output_config->y);
-      } else {
-        wlr_output_enable(&wlr_output, false);
-      }
+      add_config_modes(*output_config);
+      apply_config(*output_config);
     } else {
       wlr_output_layout_add_auto(desktop.layout, &wlr_output);
     }
@@ -1,9 +1,13 @@
 #pragma once
 
+#include <optional>
+
 #include "util/chrono.hpp"
 #include "util/macros.hpp"
 #include "util/ptr_vec.hpp"
 
+#include "config.hpp"
+#include "gesture.hpp"
 #include "layers.hpp"
 #include "render.hpp"
 #include "wlroots.hpp"
@@ -32,22 +36,65 @@ namespace cloth {
 
     wlr::box_t usable_area;
 
+    /// The output's box in layout coordinates
+    auto layout_box() const -> wlr::box_t;
+    /// usable_area, in layout coordinates
+    auto usable_layout_box() const -> wlr::box_t;
+
+    /// Start sliding the workspace with the given index in next to the current one, following a
+    /// gesture. Returns false if a gesture is already sliding this output
+    auto begin_swipe(int index) -> bool;
+    /// Show this much of the workspace being swiped to, from 0 to 1
+    auto update_swipe(double progress) -> void;
+    /// Let go, switching workspaces if the swipe went far or fast enough
+    auto end_swipe(bool cancelled) -> void;
+
+    /// Turn the output on or off, keeping its place in the layout. Outputs disabled in the
+    /// config stay off
+    auto set_power(bool on) -> void;
+    /// Darken the whole output, from 0 to 1
+    auto set_dim(float dim) -> void;
+
+    /// Add the modelines of an output config to the modes of the output
+    auto add_config_modes(Config::Output& config) -> void;
+    /// Set the output to its config
+    auto apply_config(Config::Output& config) -> void;
+
     render::Context context = {*this};
 
+    float dim = 0;
+    /// Turned off by the power manager, which turns it back on
+    bool idle_off = false;
+    /// Disabled in the config or by an output manager client
+    bool disabled = false;
+    /// Waiting for Desktop::arrange_outputs
+    bool needs_arrange = false;
+
   protected:
     wl::Listener on_destroy;
     wl::Listener on_mode;
     wl::Listener on_transform;
+    wl::Listener on_scale;
     wl::Listener on_damage_frame;
     wl::Listener on_damage_destroy;
 
+    /// Drop references to a workspace that is about to be destroyed
+    auto forget_workspace(Workspace& workspace) noexcept -> void;
+
   private:
     auto render() -> void;
 
+    /// A workspace sliding in or out next to the current one
+    struct Slide {
+      /// Index of the other workspace. It sits on the side of the current one its index is on
+      int index;
+      /// How much of the other workspace is shown
+      Progress progress;
+    };
 
+    /// The workspace shown in the last frame, to slide it out after switching
     Workspace* prev_workspace = nullptr;
-
-    float ws_alpha = 0.f;
+    std::optional<Slide> slide;
   };
 
 } // namespace cloth
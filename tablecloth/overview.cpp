@@ -0,0 +1,253 @@
+#include "overview.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#include "util/algorithm.hpp"
+
+#include "desktop.hpp"
+#include "output.hpp"
+#include "render.hpp"
+#include "render_utils.hpp"
+#include "seat.hpp"
+#include "server.hpp"
+#include "view.hpp"
+#include "workspace.hpp"
+
+namespace cloth {
+
+  /// Space between cells, in layout coordinates
+  static constexpr int gap = 20;
+
+  /// Split an area into a grid of n equally sized cells
+  static auto grid(wlr::box_t area, int n) -> std::vector<wlr::box_t>
+  {
+    std::vector<wlr::box_t> res;
+    if (n == 0) return res;
+    int cols = std::ceil(std::sqrt(n));
+    int rows = (n + cols - 1) / cols;
+    int width = (area.width - gap * (cols + 1)) / cols;
+    int height = (area.height - gap * (rows + 1)) / rows;
+    res.reserve(n);
+    for (int i = 0; i < n; i++) {
+      res.push_back({.x = area.x + gap + (i % cols) * (width + gap),
+                     .y = area.y + gap + (i / cols) * (height + gap),
+                     .width = width,
+                     .height = height});
+    }
+    return res;
+  }
+
+  static auto lerp(wlr::box_t from, wlr::box_t to, float t) -> wlr::box_t
+  {
+    return {.x = from.x + int((to.x - from.x) * t),
+            .y = from.y + int((to.y - from.y) * t),
+            .width = from.width + int((to.width - from.width) * t),
+            .height = from.height + int((to.height - from.height) * t)};
+  }
+
+  Overview::Overview(Desktop& desktop) noexcept : desktop(desktop) {}
+
+  auto Overview::enter(Mode mode) -> void
+  {
+    _mode = mode;
+    _active = true;
+    _shown.settle(1);
+    invalidate();
+    desktop.server.input.update_cursor_focus();
+  }
+
+  auto Overview::exit() -> void
+  {
+    if (!_active) return;
+    _active = false;
+    // The cells are kept until the thumbnails are back in place
+    _shown.settle(0);
+    damage_all();
+    desktop.server.input.update_cursor_focus();
+  }
+
+  auto Overview::toggle(Mode mode) -> void
+  {
+    if (_active && _mode == mode) {
+      exit();
+    } else {
+      enter(mode);
+    }
+  }
+
+  auto Overview::begin_gesture() -> void
+  {
+    _was_active = _active;
+    if (!_active) {
+      _mode = Mode::workspace;
+      _active = true;
+      invalidate();
+      desktop.server.input.update_cursor_focus();
+    }
+    _shown.track(_shown.at(chrono::clock::now()));
+  }
+
+  auto Overview::update_gesture(double shown) -> void
+  {
+    if (!_shown.is_tracking()) return;
+    _shown.track(shown);
+    damage_all();
+  }
+
+  auto Overview::end_gesture(bool cancelled) -> void
+  {
+    if (!_shown.is_tracking()) return;
+    if (cancelled) {
+      _shown.settle(_was_active ? 1 : 0);
+    } else {
+      _shown.release();
+    }
+    _active = _shown.target() == 1;
+    damage_all();
+    desktop.server.input.update_cursor_focus();
+  }
+
+  auto Overview::is_visible() const -> bool
+  {
+    return _active || !_shown.settled(chrono::clock::now());
+  }
+
+  auto Overview::invalidate() -> void
+  {
+    _cells.clear();
+    _dirty = true;
+    if (is_visible()) damage_all();
+  }
+
+  auto Overview::damage_all() -> void
+  {
+    for (auto& output : desktop.outputs) {
+      output.context.damage_whole();
+    }
+  }
+
+  auto Overview::covers(Output& output) -> bool
+  {
+    if (!is_visible()) return false;
+    if (_dirty) arrange();
+    return util::any_of(_cells, [&](const Cell& cell) { return cell.output == &output; });
+  }
+
+  auto Overview::arrange() -> void
+  {
+    _cells.clear();
+    _dirty = false;
+
+    if (_mode == Mode::workspace) {
+      for (auto& output : desktop.outputs) {
+        Workspace* ws = output.workspace;
+        auto& views = ws->visible_views();
+        auto boxes = grid(output.usable_layout_box(), views.size());
+        auto box = boxes.begin();
+        for (auto& view : views) {
+          auto cell_box = render::fit_box(*box++, view.width, view.height);
+          _cells.push_back({&output, ws, &view, cell_box});
+        }
+      }
+      return;
+    }
+
+    if (desktop.outputs.empty()) return;
+    auto& output = desktop.focused_output();
+    auto output_box = output.layout_box();
+
+    std::vector<Workspace*> workspaces;
+    workspaces.reserve(desktop.workspaces.size());
+    for (auto& [index, ws] : desktop.workspaces) workspaces.push_back(ws.get());
+    std::sort(workspaces.begin(), workspaces.end(),
+              [](Workspace* a, Workspace* b) { return a->index < b->index; });
+
+    auto boxes = grid(output.usable_layout_box(), workspaces.size());
+    auto box = boxes.begin();
+    for (auto* ws : workspaces) {
+      auto ws_box = render::fit_box(*box++, output_box.width, output_box.height);
+      _cells.push_back({&output, ws, nullptr, ws_box});
+
+      // Views keep their place relative to the output the workspace is shown on
+      auto shown_on = util::find_if(desktop.outputs, [&](Output& o) { return o.workspace == ws; });
+      auto ref = shown_on != desktop.outputs.end() ? shown_on->layout_box() : output_box;
+      double scale = ws_box.width / double(ref.width);
+      for (auto& view : ws->visible_views()) {
+        _cells.push_back({&output, ws, &view,
+                          {.x = ws_box.x + int((view.x - ref.x) * scale),
+                           .y = ws_box.y + int((view.y - ref.y) * scale),
+                           .width = int(view.width * scale),
+                           .height = int(view.height * scale)}});
+      }
+    }
+  }
+
+  auto Overview::select_at(double lx, double ly) -> bool
+  {
+    if (!_active) return false;
+    if (_dirty) arrange();
+
+    // Views are on top of their workspace
+    auto cell = std::find_if(_cells.rbegin(), _cells.rend(), [&](Cell& cell) {
+      return wlr_box_contains_point(&cell.box, lx, ly);
+    });
+    if (cell == _cells.rend()) return false;
+
+    auto& workspace = *cell->workspace;
+    auto* view = cell->view;
+    exit();
+    if (!workspace.is_visible()) desktop.switch_to_workspace(workspace);
+    if (view) workspace.set_focused_view(view);
+    return true;
+  }
+
+  auto Overview::damage_view(View& view) -> void
+  {
+    for (auto& cell : _cells) {
+      if (cell.view == &view) cell.output->context.damage_box(cell.box);
+    }
+  }
+
+  auto Overview::render(render::Context& context) -> void
+  {
+    if (_dirty) arrange();
+
+    auto now = chrono::clock::now();
+    float shown = _shown.at(now);
+    for (auto& cell : _cells) {
+      if (cell.output != &context.output) continue;
+      if (cell.view == nullptr) {
+        float alpha = cell.workspace->is_visible() ? 0.5f : 0.3f;
+        context.draw_rect(cell.box, {0.f, 0.f, 0.f, alpha * shown});
+        continue;
+      }
+      auto box = cell.box;
+      float alpha = cell.view->alpha;
+      if (shown < 1.f) {
+        // Views on the output's own workspace move from their place, others fade in
+        if (cell.workspace == cell.output->workspace) {
+          box = lerp(cell.view->get_box(), cell.box, shown);
+        } else {
+          alpha *= shown;
+        }
+      }
+      context.draw_thumbnail(*cell.view, box, alpha);
+    }
+
+    if (!_shown.settled(now)) {
+      damage_all();
+    } else if (!_active) {
+      // All the way out, the next frame draws the workspace again
+      _cells.clear();
+      _dirty = true;
+      damage_all();
+      desktop.server.input.update_cursor_focus();
+    }
+
+    // Keep frames coming until the budget has caught up with the queue. Thumbnails held back
+    // by their rate limit are brought in by the cache's timer instead
+    if (desktop.thumbnails.has_pending()) wlr_output_schedule_frame(&context.output.wlr_output);
+  }
+
+} // namespace cloth
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <vector>
+
+#include "gesture.hpp"
+#include "wlroots.hpp"
+
+namespace cloth {
+
+  struct Desktop;
+  struct Output;
+  struct View;
+  struct Workspace;
+
+  namespace render {
+    struct Context;
+  }
+
+  /// Exposé style overview, showing views side by side as thumbnails.
+  ///
+  /// Thumbnails come from Desktop::thumbnails, so views only get re-rendered when they commit.
+  /// Entering and leaving moves the thumbnails between the views' places and their cells, either
+  /// on its own or following a gesture.
+  struct Overview {
+    enum struct Mode {
+      /// The views of the workspace shown on each output
+      workspace,
+      /// All workspaces, on the focused output
+      all,
+    };
+
+    Overview(Desktop& desktop) noexcept;
+
+    auto is_active() const noexcept -> bool
+    {
+      return _active;
+    }
+
+    auto enter(Mode mode) -> void;
+    auto exit() -> void;
+    auto toggle(Mode mode) -> void;
+
+    /// Start opening or closing the overview with a gesture. Enters the workspace overview if it
+    /// isn't open
+    auto begin_gesture() -> void;
+    /// Show the overview this far, from 0 to 1
+    auto update_gesture(double shown) -> void;
+    /// Let go, opening or closing depending on how far and fast the gesture went
+    auto end_gesture(bool cancelled) -> void;
+
+    /// Is the overview drawn on this output, instead of its workspace
+    auto covers(Output& output) -> bool;
+
+    /// Lay out the cells again before they are used next. Call when views or workspaces come and go.
+    auto invalidate() -> void;
+
+    /// Focus the view or workspace at the given layout coordinates and leave the overview.
+    /// Returns false if there is nothing there
+    auto select_at(double lx, double ly) -> bool;
+
+    /// Damage the thumbnail of a view
+    auto damage_view(View& view) -> void;
+
+    /// Draw the cells on the context's output
+    auto render(render::Context& context) -> void;
+
+  private:
+    struct Cell {
+      Output* output;
+      Workspace* workspace;
+      /// nullptr for the background of a workspace
+      View* view;
+      /// In layout coordinates
+      wlr::box_t box;
+    };
+
+    auto arrange() -> void;
+    auto damage_all() -> void;
+    /// Drawn at all, either active or still moving out
+    auto is_visible() const -> bool;
+
+    Desktop& desktop;
+    Mode _mode = Mode::workspace;
+    /// Open, or being opened. Input only goes to the overview while active
+    bool _active = false;
+    /// Was the overview active before the current gesture
+    bool _was_active = false;
+    /// How far the overview is shown
+    Progress _shown;
+    bool _dirty = true;
+    std::vector<Cell> _cells;
+  };
+
+} // namespace cloth
@@ -0,0 +1,131 @@
+#include "power.hpp"
+
+#include "util/algorithm.hpp"
+#include "util/logging.hpp"
+
+#include "desktop.hpp"
+#include "output.hpp"
+#include "seat.hpp"
+#include "server.hpp"
+
+namespace cloth {
+
+  PowerManager::Timeout::Timeout(PowerManager& power, Seat& seat, State state, int seconds) noexcept
+    : power(power),
+      state(state),
+      timeout(wlr_idle_timeout_create(power.desktop.idle, seat.wlr_seat, seconds * 1000))
+  {
+    on_idle.add_to(timeout->events.idle);
+    on_idle = [this] {
+      idle = true;
+      this->power.update();
+    };
+    on_resume.add_to(timeout->events.resume);
+    on_resume = [this] {
+      idle = false;
+      this->power.update();
+    };
+    on_destroy.add_to(timeout->events.destroy);
+    on_destroy = [this] {
+      timeout = nullptr;
+      auto& power = this->power;
+      util::erase_this(power._timeouts, this);
+      power.update();
+    };
+  }
+
+  PowerManager::Timeout::~Timeout() noexcept
+  {
+    // wlr_idle_timeout_destroy emits the destroy signal, whose handler would erase this timeout
+    // from _timeouts while it is already being destroyed, i.e. by reset_timeouts()
+    on_destroy.remove();
+    if (timeout) wlr_idle_timeout_destroy(timeout);
+  }
+
+  PowerManager::Inhibitor::Inhibitor(PowerManager& power,
+                                     wlr::idle_inhibitor_v1_t& inhibitor) noexcept
+  {
+    on_destroy.add_to(inhibitor.events.destroy);
+    on_destroy = [this, &power] {
+      util::erase_this(power._inhibitors, this);
+      power.update_inhibitors();
+    };
+  }
+
+  PowerManager::PowerManager(Desktop& desktop) noexcept : desktop(desktop) {}
+
+  auto PowerManager::add_seat(Seat& seat) -> void
+  {
+    auto& config = desktop.config.idle;
+    if (config.dim_timeout > 0) {
+      _timeouts.emplace_back(*this, seat, State::dimmed, config.dim_timeout);
+    }
+    if (config.off_timeout > 0) {
+      _timeouts.emplace_back(*this, seat, State::off, config.off_timeout);
+    }
+  }
+
+  auto PowerManager::reset_timeouts() -> void
+  {
+    _timeouts.clear();
+    for (auto& seat : desktop.server.input.seats) {
+      add_seat(seat);
+    }
+    update();
+  }
+
+  auto PowerManager::add_inhibitor(wlr::idle_inhibitor_v1_t& inhibitor) -> void
+  {
+    _inhibitors.emplace_back(*this, inhibitor);
+    update_inhibitors();
+  }
+
+  auto PowerManager::update_inhibitors() -> void
+  {
+    LOGD("Idle {}", is_inhibited() ? "inhibited" : "uninhibited");
+    wlr_idle_set_enabled(desktop.idle, nullptr, !is_inhibited());
+  }
+
+  auto PowerManager::update() -> void
+  {
+    auto all_idle = [this](State state) {
+      bool any = false;
+      for (auto& t : _timeouts) {
+        if (t.state != state) continue;
+        if (!t.idle) return false;
+        any = true;
+      }
+      return any;
+    };
+    State state = State::active;
+    if (all_idle(State::off)) {
+      state = State::off;
+    } else if (all_idle(State::dimmed)) {
+      state = State::dimmed;
+    }
+    if (state == _state) return;
+    _state = state;
+
+    for (auto& output : desktop.outputs) {
+      switch (state) {
+      case State::off:
+        output.set_dim(0);
+        if (output.wlr_output.enabled) {
+          LOGD("Idle, turning off output '{}'", output.wlr_output.name);
+          output.set_power(false);
+          output.idle_off = true;
+        }
+        break;
+      case State::dimmed:
+      case State::active:
+        if (output.idle_off) {
+          output.idle_off = false;
+          output.set_power(true);
+        }
+        output.set_dim(state == State::dimmed ? dim_alpha : 0);
+        break;
+      }
+    }
+  }
+
+} // namespace cloth
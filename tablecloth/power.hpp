@@ -0,0 +1,72 @@
+#pragma once
+
+#include "util/ptr_vec.hpp"
+
+#include "wlroots.hpp"
+
+namespace cloth {
+
+  struct Desktop;
+  struct Seat;
+
+  /// Dims the outputs, and later turns them off, once every seat has been idle for the
+  /// configured time. Idle inhibitors hold the timeouts off while they exist.
+  ///
+  /// Outputs that are off are not rendered, so their clients get no frame events until they come
+  /// back on with the next input.
+  struct PowerManager {
+    /// How dark dimmed outputs get
+    static constexpr float dim_alpha = 0.6f;
+
+    PowerManager(Desktop& desktop) noexcept;
+
+    PowerManager(const PowerManager&) = delete;
+    PowerManager& operator=(const PowerManager&) = delete;
+
+    /// Start the configured idle timeouts for a seat
+    auto add_seat(Seat& seat) -> void;
+    auto add_inhibitor(wlr::idle_inhibitor_v1_t& inhibitor) -> void;
+    /// Restart the timeouts of every seat, i.e. after the config changed
+    auto reset_timeouts() -> void;
+
+    auto is_inhibited() const noexcept -> bool
+    {
+      return !_inhibitors.empty();
+    }
+
+  private:
+    enum struct State { active, dimmed, off };
+
+    /// An idle timeout of one seat. wlroots destroys it with the seat.
+    struct Timeout {
+      Timeout(PowerManager& power, Seat& seat, State state, int seconds) noexcept;
+      ~Timeout() noexcept;
+
+      PowerManager& power;
+      /// The state the outputs go to once every seat has idled past it
+      State state;
+      wlr::idle_timeout_t* timeout;
+      bool idle = false;
+
+      wl::Listener on_idle;
+      wl::Listener on_resume;
+      wl::Listener on_destroy;
+    };
+
+    struct Inhibitor {
+      Inhibitor(PowerManager& power, wlr::idle_inhibitor_v1_t& inhibitor) noexcept;
+
+      wl::Listener on_destroy;
+    };
+
+    /// Apply the deepest state every seat has idled into
+    auto update() -> void;
+    auto update_inhibitors() -> void;
+
+    Desktop& desktop;
+    State _state = State::active;
+    util::ptr_vec<Timeout> _timeouts;
+    util::ptr_vec<Inhibitor> _inhibitors;
+  };
+
+} // namespace cloth
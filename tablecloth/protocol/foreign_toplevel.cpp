@@ -0,0 +1,233 @@
+#include "foreign_toplevel.hpp"
+
+#include "util/algorithm.hpp"
+#include "util/logging.hpp"
+
+#include "output.hpp"
+#include "server.hpp"
+#include "view.hpp"
+
+#include <wlr-foreign-toplevel-management-unstable-v1-server-protocol.h>
+
+namespace cloth {
+
+  /// The view of a handle, or null if it is unmapped
+  static auto handle_view(wl::resource_t* resource) -> View*
+  {
+    return static_cast<ForeignToplevelManager::Handle*>(wl_resource_get_user_data(resource))->view;
+  }
+
+  /// Send output_enter or output_leave for every wl_output the client of a handle bound
+  static auto send_output_event(wl::resource_t* handle, Output& output, bool enter) -> void
+  {
+    auto* client = wl_resource_get_client(handle);
+    wl::resource_t* output_resource;
+    wl_resource_for_each(output_resource, &output.wlr_output.resources) {
+      if (wl_resource_get_client(output_resource) != client) continue;
+      if (enter) {
+        zwlr_foreign_toplevel_handle_v1_send_output_enter(handle, output_resource);
+      } else {
+        zwlr_foreign_toplevel_handle_v1_send_output_leave(handle, output_resource);
+      }
+    }
+  }
+
+  static const struct zwlr_foreign_toplevel_handle_v1_interface handle_impl = {
+    .set_maximized = [] (wl::client_t*, wl::resource_t* resource) {
+      if (auto* view = handle_view(resource); view) view->maximize(true);
+    },
+    .unset_maximized = [] (wl::client_t*, wl::resource_t* resource) {
+      if (auto* view = handle_view(resource); view) view->maximize(false);
+    },
+    .set_minimized = [] (wl::client_t*, wl::resource_t* resource) {
+      if (auto* view = handle_view(resource); view) view->minimize(true);
+    },
+    .unset_minimized = [] (wl::client_t*, wl::resource_t* resource) {
+      if (auto* view = handle_view(resource); view) view->minimize(false);
+    },
+    .activate = [] (wl::client_t*, wl::resource_t* resource, wl::resource_t* seat) {
+      auto* view = handle_view(resource);
+      if (view == nullptr) return;
+      auto& desktop = view->desktop;
+      if (view->minimized) view->minimize(false);
+      // Bring its workspace up, unless some output already shows it
+      if (!util::any_of(desktop.outputs, [&] (Output& o) { return o.workspace == view->workspace; })) {
+        desktop.switch_to_workspace(*view->workspace);
+      }
+      view->workspace->set_focused_view(view);
+    },
+    .close = [] (wl::client_t*, wl::resource_t* resource) {
+      if (auto* view = handle_view(resource); view) view->close();
+    },
+    .set_rectangle = [] (wl::client_t*, wl::resource_t* resource, wl::resource_t* surface,
+                         int32_t x, int32_t y, int32_t width, int32_t height) {
+      // Only a hint for minimize animations, which don't use one yet
+      if (width < 0 || height < 0) {
+        wl_resource_post_error(resource, ZWLR_FOREIGN_TOPLEVEL_HANDLE_V1_ERROR_INVALID_RECTANGLE,
+                               "Invalid rectangle %dx%d", width, height);
+      }
+    },
+    .destroy = [] (wl::client_t*, wl::resource_t* resource) {
+      wl_resource_destroy(resource);
+    },
+    .set_fullscreen = [] (wl::client_t*, wl::resource_t* resource, wl::resource_t* output) {
+      auto* view = handle_view(resource);
+      if (view) view->set_fullscreen(true, output ? wlr_output_from_resource(output) : nullptr);
+    },
+    .unset_fullscreen = [] (wl::client_t*, wl::resource_t* resource) {
+      if (auto* view = handle_view(resource); view) view->set_fullscreen(false, nullptr);
+    },
+  };
+
+  static const struct zwlr_foreign_toplevel_manager_v1_interface manager_impl = {
+    .stop = [] (wl::client_t*, wl::resource_t* resource) {
+      zwlr_foreign_toplevel_manager_v1_send_finished(resource);
+      wl_resource_destroy(resource);
+    },
+  };
+
+  static void bind_foreign_toplevel_manager(wl::client_t* client, void* data, uint32_t version, uint32_t id)
+  {
+    if (version > 2) version = 2;
+
+    wl::resource_t* resource = wl_resource_create(client, &zwlr_foreign_toplevel_manager_v1_interface, version, id);
+    if (resource == nullptr) {
+      wl_client_post_no_memory(client);
+      return;
+    }
+    wl_resource_set_implementation(resource, &manager_impl, data, [] (wl::resource_t* res) {
+      auto& bound_clients = static_cast<ForeignToplevelManager*>(wl_resource_get_user_data(res))->bound_clients;
+      bound_clients.erase(util::remove(bound_clients, res), bound_clients.end());
+    });
+    static_cast<ForeignToplevelManager*>(data)->bind(resource);
+  }
+
+  ForeignToplevelManager::ForeignToplevelManager(Server& server)
+    : server(server),
+      global (wl_global_create(server.wl_display, &zwlr_foreign_toplevel_manager_v1_interface, 2, this, &bind_foreign_toplevel_manager))
+  {}
+
+  ForeignToplevelManager::~ForeignToplevelManager() noexcept {
+    wl_global_destroy(global);
+  }
+
+  // Implementations //
+
+  auto ForeignToplevelManager::bind(wl::resource_t* resource) -> void {
+    bound_clients.push_back(resource);
+    for (auto& [index, ws] : server.desktop.workspaces) {
+      for (auto& view : ws->views()) {
+        if (view.mapped) send_handle(resource, view);
+      }
+    }
+  }
+
+  auto ForeignToplevelManager::add_view(View& view) -> void {
+    for (auto* resource : bound_clients) {
+      send_handle(resource, view);
+    }
+  }
+
+  auto ForeignToplevelManager::update_view(View& view) -> void {
+    for (auto& handle : handles) {
+      if (handle.view == &view) send_changes(handle, false);
+    }
+  }
+
+  auto ForeignToplevelManager::remove_view(View& view) -> void {
+    for (auto& handle : handles) {
+      if (handle.view != &view) continue;
+      zwlr_foreign_toplevel_handle_v1_send_closed(handle.resource);
+      handle.view = nullptr;
+      handle.outputs.clear();
+    }
+  }
+
+  auto ForeignToplevelManager::remove_output(Output& output) -> void {
+    for (auto& handle : handles) {
+      if (!util::any_of(handle.outputs, [&] (Output* o) { return o == &output; })) continue;
+      handle.outputs.erase(util::remove(handle.outputs, &output), handle.outputs.end());
+      send_output_event(handle.resource, output, false);
+      zwlr_foreign_toplevel_handle_v1_send_done(handle.resource);
+    }
+  }
+
+  auto ForeignToplevelManager::send_handle(wl::resource_t* manager, View& view) -> void {
+    auto* client = wl_resource_get_client(manager);
+    int version = wl_resource_get_version(manager);
+
+    wl::resource_t* resource = wl_resource_create(client, &zwlr_foreign_toplevel_handle_v1_interface, version, 0);
+    if (resource == nullptr) {
+      wl_client_post_no_memory(client);
+      return;
+    }
+    auto& handle = handles.push_back(Handle{*this, resource, &view});
+    wl_resource_set_implementation(resource, &handle_impl, &handle, [] (wl::resource_t* res) {
+      auto* handle = static_cast<Handle*>(wl_resource_get_user_data(res));
+      util::erase_this(handle->manager.handles, handle);
+    });
+    zwlr_foreign_toplevel_manager_v1_send_toplevel(manager, resource);
+    send_changes(handle, true);
+  }
+
+  auto ForeignToplevelManager::send_changes(Handle& handle, bool initial) -> void {
+    auto& view = *handle.view;
+    bool changed = initial;
+
+    auto title = view.get_name();
+    if (initial || title != handle.title) {
+      zwlr_foreign_toplevel_handle_v1_send_title(handle.resource, title.c_str());
+      handle.title = std::move(title);
+      changed = true;
+    }
+    auto app_id = view.get_app_id();
+    if (initial || app_id != handle.app_id) {
+      zwlr_foreign_toplevel_handle_v1_send_app_id(handle.resource, app_id.c_str());
+      handle.app_id = std::move(app_id);
+      changed = true;
+    }
+
+    std::vector<uint32_t> state;
+    if (view.maximized) state.push_back(ZWLR_FOREIGN_TOPLEVEL_HANDLE_V1_STATE_MAXIMIZED);
+    if (view.minimized) state.push_back(ZWLR_FOREIGN_TOPLEVEL_HANDLE_V1_STATE_MINIMIZED);
+    if (view.active) state.push_back(ZWLR_FOREIGN_TOPLEVEL_HANDLE_V1_STATE_ACTIVATED);
+    if (view.fullscreen_output &&
+        wl_resource_get_version(handle.resource) >= ZWLR_FOREIGN_TOPLEVEL_HANDLE_V1_STATE_FULLSCREEN_SINCE_VERSION) {
+      state.push_back(ZWLR_FOREIGN_TOPLEVEL_HANDLE_V1_STATE_FULLSCREEN);
+    }
+    if (initial || state != handle.state) {
+      wl_array array;
+      wl_array_init(&array);
+      for (auto s : state) {
+        *static_cast<uint32_t*>(wl_array_add(&array, sizeof(uint32_t))) = s;
+      }
+      zwlr_foreign_toplevel_handle_v1_send_state(handle.resource, &array);
+      wl_array_release(&array);
+      handle.state = std::move(state);
+      changed = true;
+    }
+
+    // Views are only visible on outputs that show their workspace
+    auto box = view.get_box();
+    std::vector<Output*> outputs;
+    for (auto& output : view.desktop.outputs) {
+      if (output.workspace != view.workspace) continue;
+      if (!wlr_output_layout_intersects(view.desktop.layout, &output.wlr_output, &box)) continue;
+      outputs.push_back(&output);
+    }
+    for (auto* output : handle.outputs) {
+      if (util::any_of(outputs, [&] (Output* o) { return o == output; })) continue;
+      send_output_event(handle.resource, *output, false);
+      changed = true;
+    }
+    for (auto* output : outputs) {
+      if (util::any_of(handle.outputs, [&] (Output* o) { return o == output; })) continue;
+      send_output_event(handle.resource, *output, true);
+      changed = true;
+    }
+    handle.outputs = std::move(outputs);
+
+    if (changed) zwlr_foreign_toplevel_handle_v1_send_done(handle.resource);
+  }
+
+} // namespace cloth
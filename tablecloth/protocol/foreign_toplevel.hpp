@@ -0,0 +1,59 @@
+#pragma once
+
+#include <wayland-server.h>
+
+#include "util/ptr_vec.hpp"
+
+#include "wlroots.hpp"
+
+namespace cloth {
+
+  struct Output;
+  struct Server;
+  struct View;
+
+  /// wlr-foreign-toplevel-management, for taskbars and switchers.
+  ///
+  /// Every client gets a handle for each mapped view. Handles remember what was last sent on them,
+  /// and a change to a view only sends the events that differ, followed by done.
+  struct ForeignToplevelManager {
+    /// A view was mapped
+    auto add_view(View& view) -> void;
+    /// The title, app id, state or outputs of a view may have changed
+    auto update_view(View& view) -> void;
+    /// A view was unmapped
+    auto remove_view(View& view) -> void;
+    /// Leave an output that is about to be destroyed
+    auto remove_output(Output& output) -> void;
+
+    auto bind(wl::resource_t* resource) -> void;
+
+    ForeignToplevelManager(Server&);
+    ~ForeignToplevelManager() noexcept;
+
+    /// A zwlr_foreign_toplevel_handle_v1, the user data of its resource
+    struct Handle {
+      ForeignToplevelManager& manager;
+      wl::resource_t* resource;
+      /// Null once the view is unmapped
+      View* view;
+
+      /// What was last sent on the handle
+      std::string title;
+      std::string app_id;
+      std::vector<uint32_t> state;
+      std::vector<Output*> outputs;
+    };
+
+    Server& server;
+    wl::global_t* global;
+    std::vector<wl::resource_t*> bound_clients;
+    util::ptr_vec<Handle> handles;
+
+  private:
+    auto send_handle(wl::resource_t* manager, View& view) -> void;
+    /// Send what changed since the last done. Sends everything if `initial`
+    auto send_changes(Handle& handle, bool initial) -> void;
+  };
+
+} // namespace cloth
@@ -0,0 +1,444 @@
+#include "output_manager.hpp"
+
+#include "util/algorithm.hpp"
+#include "util/logging.hpp"
+
+#include "output.hpp"
+#include "server.hpp"
+
+#include <wlr-output-management-unstable-v1-server-protocol.h>
+
+namespace cloth {
+
+  /// A zwlr_output_configuration_head_v1, the user data of its resource
+  struct ConfigurationHead {
+    OutputManager::Head& head;
+    OutputManager::State state;
+    /// Properties can only be set once
+    bool has_mode = false;
+    bool has_position = false;
+    bool has_transform = false;
+    bool has_scale = false;
+    /// Null for disabled heads, and once the client destroys it
+    wl::resource_t* resource = nullptr;
+  };
+
+  /// A zwlr_output_configuration_v1, the user data of its resource
+  struct Configuration {
+    OutputManager& manager;
+    uint32_t serial;
+    /// Applied or tested already
+    bool used = false;
+    std::vector<std::unique_ptr<ConfigurationHead>> heads;
+  };
+
+  static auto configuration_head(wl::resource_t* resource) -> ConfigurationHead*
+  {
+    return static_cast<ConfigurationHead*>(wl_resource_get_user_data(resource));
+  }
+
+  static auto check_unset(wl::resource_t* resource, bool& is_set) -> bool
+  {
+    if (is_set) {
+      wl_resource_post_error(resource, ZWLR_OUTPUT_CONFIGURATION_HEAD_V1_ERROR_ALREADY_SET,
+                             "Property has already been set");
+      return false;
+    }
+    is_set = true;
+    return true;
+  }
+
+  static const struct zwlr_output_configuration_head_v1_interface configuration_head_impl = {
+    .set_mode = [] (wl::client_t*, wl::resource_t* resource, wl::resource_t* mode_resource) {
+      auto* config = configuration_head(resource);
+      if (config == nullptr || !check_unset(resource, config->has_mode)) return;
+      if (config->head.output == nullptr) return;
+      auto& modes = config->head.modes;
+      auto found = util::find_if(modes, [&] (auto& pair) { return pair.second == mode_resource; });
+      if (found == modes.end()) {
+        wl_resource_post_error(resource, ZWLR_OUTPUT_CONFIGURATION_HEAD_V1_ERROR_INVALID_MODE,
+                               "Mode doesn't belong to head");
+        return;
+      }
+      auto* mode = found->first;
+      config->state.mode = mode;
+      config->state.width = mode->width;
+      config->state.height = mode->height;
+      config->state.refresh = mode->refresh;
+    },
+    .set_custom_mode = [] (wl::client_t*, wl::resource_t* resource, int32_t width, int32_t height, int32_t refresh) {
+      auto* config = configuration_head(resource);
+      if (config == nullptr || !check_unset(resource, config->has_mode)) return;
+      if (width <= 0 || height <= 0 || refresh < 0) {
+        wl_resource_post_error(resource, ZWLR_OUTPUT_CONFIGURATION_HEAD_V1_ERROR_INVALID_CUSTOM_MODE,
+                               "Invalid custom mode %dx%d@%d", width, height, refresh);
+        return;
+      }
+      config->state.mode = nullptr;
+      config->state.width = width;
+      config->state.height = height;
+      config->state.refresh = refresh;
+    },
+    .set_position = [] (wl::client_t*, wl::resource_t* resource, int32_t x, int32_t y) {
+      auto* config = configuration_head(resource);
+      if (config == nullptr || !check_unset(resource, config->has_position)) return;
+      config->state.x = x;
+      config->state.y = y;
+    },
+    .set_transform = [] (wl::client_t*, wl::resource_t* resource, int32_t transform) {
+      auto* config = configuration_head(resource);
+      if (config == nullptr || !check_unset(resource, config->has_transform)) return;
+      if (transform < WL_OUTPUT_TRANSFORM_NORMAL || transform > WL_OUTPUT_TRANSFORM_FLIPPED_270) {
+        wl_resource_post_error(resource, ZWLR_OUTPUT_CONFIGURATION_HEAD_V1_ERROR_INVALID_TRANSFORM,
+                               "Invalid transform %d", transform);
+        return;
+      }
+      config->state.transform = (wl::output_transform_t) transform;
+    },
+    .set_scale = [] (wl::client_t*, wl::resource_t* resource, wl_fixed_t scale_fixed) {
+      auto* config = configuration_head(resource);
+      if (config == nullptr || !check_unset(resource, config->has_scale)) return;
+      double scale = wl_fixed_to_double(scale_fixed);
+      if (scale <= 0) {
+        wl_resource_post_error(resource, ZWLR_OUTPUT_CONFIGURATION_HEAD_V1_ERROR_INVALID_SCALE,
+                               "Invalid scale %f", scale);
+        return;
+      }
+      config->state.scale = scale;
+    },
+  };
+
+  /// Add a head to a configuration, or post an error and return null
+  static auto configure_head(wl::resource_t* resource, wl::resource_t* head_resource) -> ConfigurationHead*
+  {
+    auto& config = *static_cast<Configuration*>(wl_resource_get_user_data(resource));
+    if (config.used) {
+      wl_resource_post_error(resource, ZWLR_OUTPUT_CONFIGURATION_V1_ERROR_ALREADY_USED,
+                             "Configuration has already been used");
+      return nullptr;
+    }
+    auto& head = *static_cast<OutputManager::Head*>(wl_resource_get_user_data(head_resource));
+    if (util::any_of(config.heads, [&] (auto& ch) { return &ch->head == &head; })) {
+      wl_resource_post_error(resource, ZWLR_OUTPUT_CONFIGURATION_V1_ERROR_ALREADY_CONFIGURED_HEAD,
+                             "Head has already been configured");
+      return nullptr;
+    }
+    auto& ch = *config.heads.emplace_back(new ConfigurationHead{head});
+    if (head.output) ch.state = config.manager.current_state(*head.output);
+    return &ch;
+  }
+
+  /// Test or apply a configuration, and tell the client how it went
+  static auto finish_configuration(wl::resource_t* resource, bool apply) -> void
+  {
+    auto& config = *static_cast<Configuration*>(wl_resource_get_user_data(resource));
+    if (config.used) {
+      wl_resource_post_error(resource, ZWLR_OUTPUT_CONFIGURATION_V1_ERROR_ALREADY_USED,
+                             "Configuration has already been used");
+      return;
+    }
+    config.used = true;
+    auto& manager = config.manager;
+    auto& desktop = manager.server.desktop;
+
+    // Outputs changed since the client made it, or it configures a head whose output is gone
+    if (config.serial != manager.serial ||
+        util::any_of(config.heads, [] (auto& ch) { return ch->head.output == nullptr; })) {
+      zwlr_output_configuration_v1_send_cancelled(resource);
+      return;
+    }
+
+    bool any_enabled = false;
+    for (auto& output : desktop.outputs) {
+      auto ch = util::find_if(config.heads, [&] (auto& ch) { return ch->head.output == &output; });
+      if (ch == config.heads.end()) {
+        any_enabled |= manager.current_state(output).enabled;
+        continue;
+      }
+      if (!manager.test_state(output, (*ch)->state)) {
+        zwlr_output_configuration_v1_send_failed(resource);
+        return;
+      }
+      any_enabled |= (*ch)->state.enabled;
+    }
+    if (!any_enabled) {
+      LOGE("Output configuration would disable every output");
+      zwlr_output_configuration_v1_send_failed(resource);
+      return;
+    }
+    if (!apply) {
+      zwlr_output_configuration_v1_send_succeeded(resource);
+      return;
+    }
+
+    std::vector<std::pair<Output*, OutputManager::State>> old_states;
+    for (auto& ch : config.heads) {
+      old_states.emplace_back(ch->head.output, manager.current_state(*ch->head.output));
+    }
+
+    TransactionScope scope(desktop);
+    bool ok = util::all_of(config.heads, [&] (auto& ch) {
+      return manager.apply_state(*ch->head.output, ch->state);
+    });
+    if (ok) {
+      zwlr_output_configuration_v1_send_succeeded(resource);
+    } else {
+      LOGE("Applying output configuration failed, rolling back");
+      for (auto& [output, state] : old_states) manager.apply_state(*output, state);
+      zwlr_output_configuration_v1_send_failed(resource);
+    }
+    // The mode, scale, transform and layout handlers only scheduled this
+    desktop.arrange_outputs();
+  }
+
+  static const struct zwlr_output_configuration_v1_interface configuration_impl = {
+    .enable_head = [] (wl::client_t* client, wl::resource_t* resource, uint32_t id, wl::resource_t* head_resource) {
+      auto* ch = configure_head(resource, head_resource);
+      if (ch == nullptr) return;
+      ch->state.enabled = true;
+      ch->resource = wl_resource_create(client, &zwlr_output_configuration_head_v1_interface, wl_resource_get_version(resource), id);
+      if (ch->resource == nullptr) {
+        wl_client_post_no_memory(client);
+        return;
+      }
+      wl_resource_set_implementation(ch->resource, &configuration_head_impl, ch, [] (wl::resource_t* res) {
+        if (auto* ch = configuration_head(res); ch) ch->resource = nullptr;
+      });
+    },
+    .disable_head = [] (wl::client_t*, wl::resource_t* resource, wl::resource_t* head_resource) {
+      auto* ch = configure_head(resource, head_resource);
+      if (ch) ch->state.enabled = false;
+    },
+    .apply = [] (wl::client_t*, wl::resource_t* resource) {
+      finish_configuration(resource, true);
+    },
+    .test = [] (wl::client_t*, wl::resource_t* resource) {
+      finish_configuration(resource, false);
+    },
+    .destroy = [] (wl::client_t*, wl::resource_t* resource) {
+      wl_resource_destroy(resource);
+    },
+  };
+
+  static const struct zwlr_output_manager_v1_interface output_manager_impl = {
+    .create_configuration = [] (wl::client_t* client, wl::resource_t* resource, uint32_t id, uint32_t serial) {
+      auto& manager = *static_cast<OutputManager*>(wl_resource_get_user_data(resource));
+      wl::resource_t* config_resource = wl_resource_create(client, &zwlr_output_configuration_v1_interface, wl_resource_get_version(resource), id);
+      if (config_resource == nullptr) {
+        wl_client_post_no_memory(client);
+        return;
+      }
+      auto* config = new Configuration{manager, serial};
+      wl_resource_set_implementation(config_resource, &configuration_impl, config, [] (wl::resource_t* res) {
+        auto* config = static_cast<Configuration*>(wl_resource_get_user_data(res));
+        // Head configurations the client still has become inert
+        for (auto& ch : config->heads) {
+          if (ch->resource) wl_resource_set_user_data(ch->resource, nullptr);
+        }
+        delete config;
+      });
+    },
+    .stop = [] (wl::client_t*, wl::resource_t* resource) {
+      zwlr_output_manager_v1_send_finished(resource);
+      wl_resource_destroy(resource);
+    },
+  };
+
+  static void bind_output_manager(wl::client_t* client, void* data, uint32_t version, uint32_t id)
+  {
+    if (version > 1) version = 1;
+
+    wl::resource_t* resource = wl_resource_create(client, &zwlr_output_manager_v1_interface, version, id);
+    if (resource == nullptr) {
+      wl_client_post_no_memory(client);
+      return;
+    }
+    wl_resource_set_implementation(resource, &output_manager_impl, data, [] (wl::resource_t* res) {
+      auto& bound_clients = static_cast<OutputManager*>(wl_resource_get_user_data(res))->bound_clients;
+      bound_clients.erase(util::remove(bound_clients, res), bound_clients.end());
+    });
+    static_cast<OutputManager*>(data)->bind(resource);
+  }
+
+  OutputManager::OutputManager(Server& server)
+    : server(server),
+      global (wl_global_create(server.wl_display, &zwlr_output_manager_v1_interface, 1, this, &bind_output_manager))
+  {}
+
+  OutputManager::~OutputManager() noexcept {
+    wl_global_destroy(global);
+  }
+
+  // Implementations //
+
+  auto OutputManager::bind(wl::resource_t* resource) -> void {
+    bound_clients.push_back(resource);
+    for (auto& output : server.desktop.outputs) {
+      send_head(resource, output);
+    }
+    zwlr_output_manager_v1_send_done(resource, serial);
+  }
+
+  auto OutputManager::current_state(Output& output) -> State {
+    auto& wlr_output = output.wlr_output;
+    State state;
+    // Outputs turned off while idle still have their place in the layout
+    auto* l_output = wlr_output_layout_get(output.desktop.layout, &wlr_output);
+    state.enabled = l_output != nullptr;
+    if (l_output) {
+      state.x = l_output->x;
+      state.y = l_output->y;
+    }
+    state.mode = wlr_output.current_mode;
+    state.width = wlr_output.width;
+    state.height = wlr_output.height;
+    state.refresh = wlr_output.refresh;
+    state.scale = wlr_output.scale;
+    state.transform = wlr_output.transform;
+    return state;
+  }
+
+  auto OutputManager::test_state(Output& output, const State& state) -> bool {
+    auto& wlr_output = output.wlr_output;
+    if (!state.enabled) return true;
+    if (state.mode) {
+      wlr::output_mode_t* mode;
+      wl_list_for_each(mode, &wlr_output.modes, link) {
+        if (mode == state.mode) return true;
+      }
+      return false;
+    }
+    if (state.width == wlr_output.width && state.height == wlr_output.height &&
+        state.refresh == wlr_output.refresh) {
+      return true;
+    }
+    // Like in the config, only outputs without modes take custom ones
+    return wl_list_empty(&wlr_output.modes);
+  }
+
+  auto OutputManager::apply_state(Output& output, const State& state) -> bool {
+    auto& wlr_output = output.wlr_output;
+    auto* layout = output.desktop.layout;
+    bool was_enabled = wlr_output.enabled;
+
+    if (!state.enabled) {
+      LOGD("Disabling output '{}'", wlr_output.name);
+      if (wlr_output_layout_get(layout, &wlr_output)) wlr_output_layout_remove(layout, &wlr_output);
+      output.disabled = true;
+      output.idle_off = false;
+      wlr_output_enable(&wlr_output, false);
+    } else {
+      LOGD("Configuring output '{}'", wlr_output.name);
+      output.disabled = false;
+      output.idle_off = false;
+      if (!wlr_output.enabled) wlr_output_enable(&wlr_output, true);
+      if (state.mode) {
+        if (state.mode != wlr_output.current_mode && !wlr_output_set_mode(&wlr_output, state.mode)) {
+          return false;
+        }
+      } else if (state.width != wlr_output.width || state.height != wlr_output.height ||
+                 state.refresh != wlr_output.refresh) {
+        if (!wlr_output_set_custom_mode(&wlr_output, state.width, state.height, state.refresh)) {
+          return false;
+        }
+      }
+      if (state.scale != wlr_output.scale) wlr_output_set_scale(&wlr_output, state.scale);
+      if (state.transform != wlr_output.transform) {
+        wlr_output_set_transform(&wlr_output, state.transform);
+      }
+      if (wlr_output_layout_get(layout, &wlr_output)) {
+        wlr_output_layout_move(layout, &wlr_output, state.x, state.y);
+      } else {
+        wlr_output_layout_add(layout, &wlr_output, state.x, state.y);
+      }
+      output.context.damage_whole();
+    }
+    if (was_enabled != wlr_output.enabled) server.output_power_manager.send_mode(output);
+    return true;
+  }
+
+  auto OutputManager::add_output(Output& output) -> void {
+    for (auto* resource : bound_clients) {
+      send_head(resource, output);
+    }
+    send_state();
+  }
+
+  auto OutputManager::remove_output(Output& output) -> void {
+    for (auto& head : heads) {
+      if (head.output != &output) continue;
+      for (auto& [mode, mode_resource] : head.modes) {
+        zwlr_output_mode_v1_send_finished(mode_resource);
+        wl_resource_set_user_data(mode_resource, nullptr);
+      }
+      head.modes.clear();
+      zwlr_output_head_v1_send_finished(head.resource);
+      head.output = nullptr;
+    }
+    send_state();
+  }
+
+  auto OutputManager::send_state() -> void {
+    serial = wl_display_next_serial(server.wl_display);
+    for (auto& head : heads) {
+      if (head.output) send_head_state(head);
+    }
+    for (auto* resource : bound_clients) {
+      zwlr_output_manager_v1_send_done(resource, serial);
+    }
+  }
+
+  auto OutputManager::send_head(wl::resource_t* manager, Output& output) -> void {
+    auto& wlr_output = output.wlr_output;
+    auto* client = wl_resource_get_client(manager);
+    int version = wl_resource_get_version(manager);
+
+    wl::resource_t* resource = wl_resource_create(client, &zwlr_output_head_v1_interface, version, 0);
+    if (resource == nullptr) {
+      wl_client_post_no_memory(client);
+      return;
+    }
+    auto& head = heads.push_back(Head{*this, resource, &output, {}});
+    wl_resource_set_implementation(resource, nullptr, &head, [] (wl::resource_t* res) {
+      auto* head = static_cast<Head*>(wl_resource_get_user_data(res));
+      util::erase_this(head->manager.heads, head);
+    });
+    zwlr_output_manager_v1_send_head(manager, resource);
+
+    zwlr_output_head_v1_send_name(resource, wlr_output.name);
+    auto description = fmt::format("{} {} {}", wlr_output.make, wlr_output.model, wlr_output.serial);
+    zwlr_output_head_v1_send_description(resource, description.c_str());
+    if (wlr_output.phys_width > 0 && wlr_output.phys_height > 0) {
+      zwlr_output_head_v1_send_physical_size(resource, wlr_output.phys_width, wlr_output.phys_height);
+    }
+
+    wlr::output_mode_t* mode;
+    wl_list_for_each(mode, &wlr_output.modes, link) {
+      wl::resource_t* mode_resource = wl_resource_create(client, &zwlr_output_mode_v1_interface, version, 0);
+      if (mode_resource == nullptr) {
+        wl_client_post_no_memory(client);
+        return;
+      }
+      wl_resource_set_implementation(mode_resource, nullptr, mode, nullptr);
+      head.modes.emplace_back(mode, mode_resource);
+      zwlr_output_head_v1_send_mode(resource, mode_resource);
+      zwlr_output_mode_v1_send_size(mode_resource, mode->width, mode->height);
+      if (mode->refresh > 0) zwlr_output_mode_v1_send_refresh(mode_resource, mode->refresh);
+      if (mode->preferred) zwlr_output_mode_v1_send_preferred(mode_resource);
+    }
+
+    send_head_state(head);
+  }
+
+  auto OutputManager::send_head_state(Head& head) -> void {
+    auto state = current_state(*head.output);
+    zwlr_output_head_v1_send_enabled(head.resource, state.enabled);
+    if (!state.enabled) return;
+    auto mode = util::find_if(head.modes, [&] (auto& pair) { return pair.first == state.mode; });
+    if (mode != head.modes.end()) zwlr_output_head_v1_send_current_mode(head.resource, mode->second);
+    zwlr_output_head_v1_send_position(head.resource, state.x, state.y);
+    zwlr_output_head_v1_send_transform(head.resource, state.transform);
+    zwlr_output_head_v1_send_scale(head.resource, wl_fixed_from_double(state.scale));
+  }
+
+} // namespace cloth
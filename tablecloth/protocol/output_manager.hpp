@@ -0,0 +1,73 @@
+#pragma once
+
+#include <wayland-server.h>
+
+#include "util/ptr_vec.hpp"
+
+#include "wlroots.hpp"
+
+namespace cloth {
+
+  struct Output;
+  struct Server;
+
+  /// wlr-output-management, for arranging outputs from clients like kanshi or wdisplays.
+  ///
+  /// A configuration changes all its outputs at once: if one of them fails, the others are
+  /// rolled back. Layers and views are only arranged once all of them are set.
+  struct OutputManager {
+    /// What a configuration sets an output to
+    struct State {
+      bool enabled = false;
+      /// Null for custom modes
+      wlr::output_mode_t* mode = nullptr;
+      int width = 0;
+      int height = 0;
+      int refresh = 0;
+      int x = 0;
+      int y = 0;
+      float scale = 1;
+      wl::output_transform_t transform = WL_OUTPUT_TRANSFORM_NORMAL;
+    };
+
+    /// The current state of an output
+    auto current_state(Output& output) -> State;
+    /// Whether an output could be set to a state
+    auto test_state(Output& output, const State& state) -> bool;
+    /// Set an output to a state. Returns false if the backend refused
+    auto apply_state(Output& output, const State& state) -> bool;
+
+    auto add_output(Output& output) -> void;
+    /// Tell clients about an output that is about to be destroyed
+    auto remove_output(Output& output) -> void;
+    /// Send the current state of every output to every client, and start a new serial
+    auto send_state() -> void;
+
+    auto bind(wl::resource_t* resource) -> void;
+
+    OutputManager(Server&);
+    ~OutputManager() noexcept;
+
+    /// A zwlr_output_head_v1, the user data of its resource
+    struct Head {
+      OutputManager& manager;
+      wl::resource_t* resource;
+      /// Null once the output is gone
+      Output* output;
+      /// zwlr_output_mode_v1 resources, by the mode they advertise
+      std::vector<std::pair<wlr::output_mode_t*, wl::resource_t*>> modes;
+    };
+
+    Server& server;
+    wl::global_t* global;
+    /// Configurations made with an older serial are cancelled
+    uint32_t serial = 0;
+    std::vector<wl::resource_t*> bound_clients;
+    util::ptr_vec<Head> heads;
+
+  private:
+    auto send_head(wl::resource_t* manager, Output& output) -> void;
+    auto send_head_state(Head& head) -> void;
+  };
+
+} // namespace cloth
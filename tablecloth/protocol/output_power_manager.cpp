@@ -0,0 +1,107 @@
+#include "output_power_manager.hpp"
+
+#include "util/algorithm.hpp"
+#include "util/logging.hpp"
+
+#include "output.hpp"
+#include "server.hpp"
+
+#include <wlr-output-power-management-unstable-v1-server-protocol.h>
+
+namespace cloth {
+
+  static const struct zwlr_output_power_v1_interface output_power_impl = {
+    .set_mode = [] (wl::client_t*, wl::resource_t* resource, uint32_t mode) {
+      auto* output = static_cast<Output*>(wl_resource_get_user_data(resource));
+      if (output == nullptr) return;
+      output->desktop.server.output_power_manager.set_mode(resource, mode);
+    },
+    .destroy = [] (wl::client_t*, wl::resource_t* resource) {
+      wl_resource_destroy(resource);
+    },
+  };
+
+  static const struct zwlr_output_power_manager_v1_interface output_power_manager_impl = {
+    .get_output_power = [] (wl::client_t* client, wl::resource_t* resource, uint32_t id, wl::resource_t* output_resource) {
+      auto& manager = *static_cast<OutputPowerManager*>(wl_resource_get_user_data(resource));
+      wl::resource_t* power = wl_resource_create(client, &zwlr_output_power_v1_interface, wl_resource_get_version(resource), id);
+      if (power == nullptr) {
+        wl_client_post_no_memory(client);
+        return;
+      }
+      auto* wlr_output = wlr_output_from_resource(output_resource);
+      auto* output = wlr_output ? static_cast<Output*>(wlr_output->data) : nullptr;
+      wl_resource_set_implementation(power, &output_power_impl, output, [] (wl::resource_t* res) {
+        auto* output = static_cast<Output*>(wl_resource_get_user_data(res));
+        if (output == nullptr) return;
+        auto& powers = output->desktop.server.output_power_manager.output_powers;
+        powers.erase(util::remove(powers, res), powers.end());
+      });
+      if (output == nullptr) {
+        zwlr_output_power_v1_send_failed(power);
+        return;
+      }
+      manager.output_powers.push_back(power);
+      zwlr_output_power_v1_send_mode(power, output->wlr_output.enabled ? ZWLR_OUTPUT_POWER_V1_MODE_ON : ZWLR_OUTPUT_POWER_V1_MODE_OFF);
+    },
+    .destroy = [] (wl::client_t*, wl::resource_t* resource) {
+      wl_resource_destroy(resource);
+    },
+  };
+
+  static void bind_output_power_manager(wl::client_t* client, void* data, uint32_t version, uint32_t id)
+  {
+    if (version > 1) version = 1;
+
+    wl::resource_t* resource = wl_resource_create(client, &zwlr_output_power_manager_v1_interface, version, id);
+    if (resource == nullptr) {
+      wl_client_post_no_memory(client);
+      return;
+    }
+    wl_resource_set_implementation(resource, &output_power_manager_impl, data, nullptr);
+  }
+
+  OutputPowerManager::OutputPowerManager(Server& server)
+    : server(server),
+      global (wl_global_create(server.wl_display, &zwlr_output_power_manager_v1_interface, 1, this, &bind_output_power_manager))
+  {}
+
+  OutputPowerManager::~OutputPowerManager() noexcept {
+    wl_global_destroy(global);
+  }
+
+  // Implementations //
+
+  auto OutputPowerManager::set_mode(wl::resource_t* resource, uint32_t mode) -> void {
+    auto& output = *static_cast<Output*>(wl_resource_get_user_data(resource));
+    if (mode != ZWLR_OUTPUT_POWER_V1_MODE_ON && mode != ZWLR_OUTPUT_POWER_V1_MODE_OFF) {
+      wl_resource_post_error(resource, ZWLR_OUTPUT_POWER_V1_ERROR_INVALID_MODE, "Invalid power mode %u", mode);
+      return;
+    }
+    if (output.disabled) {
+      zwlr_output_power_v1_send_failed(resource);
+      return;
+    }
+    // A client taking over, input shouldn't turn the output back on
+    output.idle_off = false;
+    output.set_power(mode == ZWLR_OUTPUT_POWER_V1_MODE_ON);
+  }
+
+  auto OutputPowerManager::send_mode(Output& output) -> void {
+    uint32_t mode = output.wlr_output.enabled ? ZWLR_OUTPUT_POWER_V1_MODE_ON : ZWLR_OUTPUT_POWER_V1_MODE_OFF;
+    for (auto* resource : output_powers) {
+      if (wl_resource_get_user_data(resource) == &output) zwlr_output_power_v1_send_mode(resource, mode);
+    }
+  }
+
+  auto OutputPowerManager::forget_output(Output& output) -> void {
+    auto iter = std::remove_if(output_powers.begin(), output_powers.end(), [&] (wl::resource_t* resource) {
+      if (wl_resource_get_user_data(resource) != &output) return false;
+      zwlr_output_power_v1_send_failed(resource);
+      wl_resource_set_user_data(resource, nullptr);
+      return true;
+    });
+    output_powers.erase(iter, output_powers.end());
+  }
+
+};
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <wayland-server.h>
+
+#include "wlroots.hpp"
+
+namespace cloth {
+
+  struct Output;
+  struct Server;
+
+  /// wlr-output-power-management, for turning outputs off from clients like idle daemons
+  struct OutputPowerManager {
+    auto set_mode(wl::resource_t* resource, uint32_t mode) -> void;
+
+    /// Send the power mode of an output to every client controlling it
+    auto send_mode(Output& output) -> void;
+    /// Make the controls of an output that is about to be destroyed inert
+    auto forget_output(Output& output) -> void;
+
+    OutputPowerManager(Server&);
+    ~OutputPowerManager() noexcept;
+
+    Server& server;
+    wl::global_t* global;
+    /// zwlr_output_power_v1 resources. Their user data is the Output, or null once it is gone
+    std::vector<wl::resource_t*> output_powers;
+  };
+
+}
@@ -1,15 +1,93 @@
 #include "window_manager.hpp"
 
+#include "util/algorithm.hpp"
 #include "util/logging.hpp"
 
-#include "server.hpp"
-#include "seat.hpp"
 #include "layers.hpp"
+#include "output.hpp"
+#include "seat.hpp"
+#include "server.hpp"
 
 #include <tablecloth-shell-server-protocol.h>
 
 namespace cloth {
 
+  using Client = WindowManager::Client;
+
+  static auto focus_state(Workspace& ws) -> WindowManager::FocusState {
+    auto* view = ws.focused_view();
+    return {view == nullptr ? "" : view->get_name(), ws.index};
+  }
+
+  static auto view_state(View& view) -> WindowManager::ViewState {
+    uint32_t state = 0;
+    if (view.maximized) state |= CLOTH_WINDOW_MANAGER_VIEW_STATE_MAXIMIZED;
+    if (view.fullscreen_output) state |= CLOTH_WINDOW_MANAGER_VIEW_STATE_FULLSCREEN;
+    if (view.minimized) state |= CLOTH_WINDOW_MANAGER_VIEW_STATE_MINIMIZED;
+    if (view.floating) state |= CLOTH_WINDOW_MANAGER_VIEW_STATE_FLOATING;
+    if (view.is_focused()) state |= CLOTH_WINDOW_MANAGER_VIEW_STATE_FOCUSED;
+    auto box = view.get_box();
+    return {view.workspace->index, box.x, box.y, box.width, box.height, view.get_app_id(),
+            view.get_name(), state};
+  }
+
+  static auto workspace_state(Workspace& ws) -> WindowManager::WorkspaceState {
+    auto& outputs = ws.desktop.outputs;
+    auto output = util::find_if(outputs, [&] (Output& o) { return o.workspace == &ws; });
+    auto* focus = ws.focused_view();
+    return {ws.name, output == outputs.end() ? "" : output->wlr_output.name,
+            focus ? focus->id : 0};
+  }
+
+  static auto output_state(Output& output) -> WindowManager::OutputState {
+    wlr::box_t box = {};
+    // Disabled outputs aren't in the layout
+    if (auto* layout_box = wlr_output_layout_get_box(output.desktop.layout, &output.wlr_output); layout_box) {
+      box = *layout_box;
+    }
+    return {box.x, box.y, box.width, box.height, output.workspace->index};
+  }
+
+  /// Remember a state as sent to a client. Returns false if the client already has it
+  template<typename Map, typename Key, typename State>
+  static auto update_sent(Map& sent, const Key& key, const State& state) -> bool {
+    auto [iter, added] = sent.try_emplace(key, state);
+    if (added) return true;
+    if (iter->second == state) return false;
+    iter->second = state;
+    return true;
+  }
+
+  static auto send_focus_to(Client& client, const WindowManager::FocusState& state) -> void {
+    if (client.focus == state) return;
+    client.focus = state;
+    cloth_window_manager_send_focused_window_name(client.resource, state.first.c_str(),
+                                                  state.second);
+  }
+
+  static auto send_view_to(Client& client, uint32_t id, const WindowManager::ViewState& state)
+    -> void {
+    if (!update_sent(client.views, id, state)) return;
+    auto& [ws, x, y, width, height, app_id, title, flags] = state;
+    cloth_window_manager_send_view(client.resource, id, ws, x, y, width, height, app_id.c_str(),
+                                   title.c_str(), flags);
+  }
+
+  static auto send_workspace_to(Client& client, int index,
+                                const WindowManager::WorkspaceState& state) -> void {
+    if (!update_sent(client.workspaces, index, state)) return;
+    auto& [name, output, focused_view] = state;
+    cloth_window_manager_send_workspace(client.resource, index, name.c_str(), output.c_str(),
+                                        focused_view);
+  }
+
+  static auto send_output_to(Client& client, const std::string& name,
+                             const WindowManager::OutputState& state) -> void {
+    if (!update_sent(client.outputs, name, state)) return;
+    auto& [x, y, width, height, ws] = state;
+    cloth_window_manager_send_output(client.resource, name.c_str(), x, y, width, height, ws);
+  }
+
   static const struct cloth_window_manager_interface cloth_window_manager_impl = {
     .cycle_focus = [] (wl::client_t*, wl::resource_t* resource) {
       static_cast<WindowManager*>(resource->data)->cycle_focus();
@@ -17,36 +95,58 @@ namespace cloth {
     .run_command = [] (wl::client_t*, wl::resource_t* resource, const char* commands) {
       static_cast<WindowManager*>(resource->data)->run_command(commands);
     },
+    .subscribe = [] (wl::client_t*, wl::resource_t* resource, uint32_t events) {
+      static_cast<WindowManager*>(resource->data)->subscribe(resource, events);
+    },
+    .get_tree = [] (wl::client_t*, wl::resource_t* resource) {
+      static_cast<WindowManager*>(resource->data)->send_tree(resource);
+    },
+    .get_client_stats = [] (wl::client_t*, wl::resource_t* resource) {
+      static_cast<WindowManager*>(resource->data)->send_client_stats(resource);
+    },
   };
 
   static void bind_cloth_window_manager(wl::client_t* client, void* data, uint32_t version, uint32_t id)
   {
-    if (version > 1) version = 1;
+    if (version > 3) version = 3;
 
     wl::resource_t* resource = wl_resource_create(client, &cloth_window_manager_interface, version, id);
     wl_resource_set_implementation(resource, &cloth_window_manager_impl, data, nullptr);
     resource->destroy = [] (wl::resource_t* res) {
       auto& bound_clients = static_cast<WindowManager*>(res->data)->bound_clients;
-      bound_clients.erase(util::remove(bound_clients, res), bound_clients.end());
+      bound_clients.erase(util::find_if(bound_clients, [&] (auto& c) { return c.resource == res; }));
     };
     auto& wm = *static_cast<WindowManager*>(data);
-    wm.bound_clients.push_back(resource);
-    wm.send_focused_window_name(wm.server.desktop.current_workspace());
+    // Version 1 clients only know about the focused window name
+    uint32_t events = version < 2 ? CLOTH_WINDOW_MANAGER_EVENT_CLASS_FOCUS : 0;
+    auto& bound = wm.bound_clients.emplace_back();
+    bound.resource = resource;
+    bound.events = events;
+    if (events) send_focus_to(bound, focus_state(wm.server.desktop.current_workspace()));
   }
 
-  WindowManager::WindowManager(Server& server) 
+  WindowManager::WindowManager(Server& server)
     : server(server),
-      global (wl_global_create(server.wl_display, &cloth_window_manager_interface, 1, this, &bind_cloth_window_manager))
-  {}
+      global (wl_global_create(server.wl_display, &cloth_window_manager_interface, 3, this, &bind_cloth_window_manager))
+  {
+    _flush_timer = wl_event_loop_add_timer(server.wl_event_loop,
+                                           [](void* data) {
+                                             static_cast<WindowManager*>(data)->flush();
+                                             return 0;
+                                           },
+                                           this);
+  }
 
   WindowManager::~WindowManager() noexcept {
+    if (_flush_idle) wl_event_source_remove(_flush_idle);
+    wl_event_source_remove(_flush_timer);
     wl_global_destroy(global);
-    for (auto* res : bound_clients) {
-      wl_resource_destroy(res);
+    while (!bound_clients.empty()) {
+      wl_resource_destroy(bound_clients.back().resource);
     }
   }
 
-  // Implementations // 
+  // Implementations //
 
   auto WindowManager::cycle_focus() -> void {
     server.desktop.current_workspace().cycle_focus();
@@ -58,12 +158,181 @@ namespace cloth {
     LOGE("No keyboard found");
   }
 
+  auto WindowManager::subscribe(wl::resource_t* resource, uint32_t events) -> void {
+    auto client = util::find_if(bound_clients, [&] (auto& c) { return c.resource == resource; });
+    if (client != bound_clients.end()) client->events = events;
+  }
+
+  auto WindowManager::send_tree(wl::resource_t* resource) -> void {
+    auto client = util::find_if(bound_clients, [&] (auto& c) { return c.resource == resource; });
+    if (client == bound_clients.end()) return;
+    // The client starts over from the snapshot
+    client->outputs.clear();
+    client->workspaces.clear();
+    client->views.clear();
+
+    auto& desktop = server.desktop;
+    for (auto& output : desktop.outputs) {
+      send_output_to(*client, output.wlr_output.name, output_state(output));
+    }
+    for (auto& [index, ws] : desktop.workspaces) {
+      send_workspace_to(*client, index, workspace_state(*ws));
+    }
+    for (auto& [index, ws] : desktop.workspaces) {
+      for (auto& view : ws->views()) {
+        if (view.mapped) send_view_to(*client, view.id, view_state(view));
+      }
+    }
+    cloth_window_manager_send_tree_done(resource);
+  }
+
+  auto WindowManager::send_client_stats(wl::resource_t* resource) -> void {
+    auto now = chrono::steady_clock::now();
+    for (auto& [client, stats] : server.client_accounting.clients) {
+      stats->roll(now);
+      auto& last = stats->last;
+      auto handler_time = chrono::duration_cast<chrono::microseconds>(last.handler_time);
+      cloth_window_manager_send_client_stats(resource, stats->pid, stats->name.c_str(), last.commits,
+                                             last.damage_area / 1000, handler_time.count(),
+                                             stats->buffer_bytes / 1024, stats->max_commit_rate,
+                                             stats->max_frame_rate);
+    }
+    cloth_window_manager_send_client_stats_done(resource);
+  }
+
   auto WindowManager::send_focused_window_name(Workspace& ws) -> void {
-    auto* view = ws.focused_view();
-    auto name = view == nullptr ? "" : view->get_name();
-    for (auto* resource : bound_clients) {
-      cloth_window_manager_send_focused_window_name(resource, name.c_str(), ws.index);
+    // Moved to the back, so the last focus change is also sent last
+    _dirty_focus.erase(util::remove(_dirty_focus, ws.index), _dirty_focus.end());
+    _dirty_focus.push_back(ws.index);
+    schedule_flush();
+  }
+
+  auto WindowManager::send_view(View& view) -> void {
+    if (!view.mapped) return;
+    if (!util::any_of(_dirty_views, [&] (View* v) { return v == &view; })) {
+      _dirty_views.push_back(&view);
+    }
+    schedule_flush();
+  }
+
+  auto WindowManager::send_view_removed(View& view) -> void {
+    _dirty_views.erase(util::remove(_dirty_views, &view), _dirty_views.end());
+    _removed_views.push_back(view.id);
+    schedule_flush();
+  }
+
+  auto WindowManager::send_workspace(Workspace& ws) -> void {
+    _dirty_workspaces.insert(ws.index);
+    schedule_flush();
+  }
+
+  auto WindowManager::send_workspace_removed(int index) -> void {
+    _dirty_workspaces.erase(index);
+    _removed_workspaces.insert(index);
+    schedule_flush();
+  }
+
+  auto WindowManager::send_output(Output& output) -> void {
+    if (!util::any_of(_dirty_outputs, [&] (Output* o) { return o == &output; })) {
+      _dirty_outputs.push_back(&output);
     }
+    schedule_flush();
+  }
+
+  auto WindowManager::send_output_removed(Output& output) -> void {
+    _dirty_outputs.erase(util::remove(_dirty_outputs, &output), _dirty_outputs.end());
+    _removed_outputs.push_back(output.wlr_output.name);
+    schedule_flush();
+  }
+
+  auto WindowManager::schedule_flush() -> void {
+    if (_flush_scheduled) return;
+    _flush_scheduled = true;
+    auto now = chrono::steady_clock::now();
+    auto next = _last_flush + flush_interval;
+    if (now < next) {
+      auto wait = chrono::ceil<chrono::milliseconds>(next - now);
+      wl_event_source_timer_update(_flush_timer, std::max<int>(wait.count(), 1));
+      return;
+    }
+    // Idle sources run after the other events of this iteration, right before the display
+    // flushes its clients
+    _flush_idle = wl_event_loop_add_idle(server.wl_event_loop,
+                                         [](void* data) {
+                                           auto& self = *static_cast<WindowManager*>(data);
+                                           self._flush_idle = nullptr;
+                                           self.flush();
+                                         },
+                                         this);
+  }
+
+  auto WindowManager::flush() -> void {
+    if (_flush_idle) {
+      wl_event_source_remove(_flush_idle);
+      _flush_idle = nullptr;
+    }
+    wl_event_source_timer_update(_flush_timer, 0);
+    _flush_scheduled = false;
+    _last_flush = chrono::steady_clock::now();
+
+    auto& desktop = server.desktop;
+
+    // Each state is built once, and compared to what every client has
+    std::vector<std::pair<std::string, OutputState>> outputs;
+    for (auto* output : _dirty_outputs) {
+      outputs.emplace_back(output->wlr_output.name, output_state(*output));
+    }
+    std::vector<std::pair<int, WorkspaceState>> workspaces;
+    for (int index : _dirty_workspaces) {
+      auto ws = desktop.workspaces.find(index);
+      if (ws != desktop.workspaces.end()) workspaces.emplace_back(index, workspace_state(*ws->second));
+    }
+    std::vector<std::pair<uint32_t, ViewState>> views;
+    for (auto* view : _dirty_views) {
+      views.emplace_back(view->id, view_state(*view));
+    }
+    std::vector<FocusState> focus;
+    for (int index : _dirty_focus) {
+      auto ws = desktop.workspaces.find(index);
+      if (ws != desktop.workspaces.end()) focus.push_back(focus_state(*ws->second));
+    }
+
+    for (auto& client : bound_clients) {
+      // Removals go first, an index or name may have been reused since
+      if (client.events & CLOTH_WINDOW_MANAGER_EVENT_CLASS_OUTPUT) {
+        for (auto& name : _removed_outputs) {
+          if (client.outputs.erase(name)) {
+            cloth_window_manager_send_output_removed(client.resource, name.c_str());
+          }
+        }
+        for (auto& [name, state] : outputs) send_output_to(client, name, state);
+      }
+      if (client.events & CLOTH_WINDOW_MANAGER_EVENT_CLASS_WORKSPACE) {
+        for (int index : _removed_workspaces) {
+          if (client.workspaces.erase(index)) {
+            cloth_window_manager_send_workspace_removed(client.resource, index);
+          }
+        }
+        for (auto& [index, state] : workspaces) send_workspace_to(client, index, state);
+      }
+      if (client.events & CLOTH_WINDOW_MANAGER_EVENT_CLASS_VIEW) {
+        for (uint32_t id : _removed_views) {
+          if (client.views.erase(id)) cloth_window_manager_send_view_removed(client.resource, id);
+        }
+        for (auto& [id, state] : views) send_view_to(client, id, state);
+      }
+      if (client.events & CLOTH_WINDOW_MANAGER_EVENT_CLASS_FOCUS) {
+        for (auto& state : focus) send_focus_to(client, state);
+      }
+    }
+
+    _dirty_focus.clear();
+    _dirty_workspaces.clear();
+    _removed_workspaces.clear();
+    _dirty_views.clear();
+    _removed_views.clear();
+    _dirty_outputs.clear();
+    _removed_outputs.clear();
   }
 
 };
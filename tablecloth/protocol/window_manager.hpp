@@ -1,26 +1,103 @@
 #pragma once
 
+#include <optional>
+#include <set>
+#include <string>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
 #include <wayland-server.h>
 
+#include "util/chrono.hpp"
+
 #include "wlroots.hpp"
 
 namespace cloth {
 
+  struct Output;
   struct Server;
+  struct View;
   struct Workspace;
 
+  /// cloth_window_manager, for bars and cloth-msg.
+  ///
+  /// Changes are queued and delivered at most once per frame, right before the display flushes
+  /// its clients. Each client only gets the events that change what was last sent to it, so a
+  /// focus change that keeps the same title doesn't wake up every bar.
   struct WindowManager {
+    /// Shortest time between two deliveries, one frame at 60Hz
+    static constexpr chrono::milliseconds flush_interval = chrono::milliseconds(16);
+
     auto cycle_focus() -> void;
     auto run_command(const char*) -> void;
+    auto subscribe(wl::resource_t* resource, uint32_t events) -> void;
 
+    /// The focused view of a workspace, or its title, changed
     auto send_focused_window_name(Workspace& ws) -> void;
+    /// Send every output, workspace and view, followed by tree_done. Sent right away
+    auto send_tree(wl::resource_t* resource) -> void;
+    /// Send what each client costs, followed by client_stats_done. Sent right away
+    auto send_client_stats(wl::resource_t* resource) -> void;
+
+    /// A view was mapped, or its geometry, title, state or workspace changed
+    auto send_view(View& view) -> void;
+    auto send_view_removed(View& view) -> void;
+    /// A workspace was added, or its output or focused view changed
+    auto send_workspace(Workspace& ws) -> void;
+    auto send_workspace_removed(int index) -> void;
+    /// An output was added, or its box or workspace changed
+    auto send_output(Output& output) -> void;
+    auto send_output_removed(Output& output) -> void;
+
+    /// Deliver the queued changes now
+    auto flush() -> void;
 
     WindowManager(Server&);
     ~WindowManager() noexcept;
 
+    /// The arguments of the last events sent to a client
+    using FocusState = std::pair<std::string, int>;
+    using ViewState = std::tuple<int, int, int, int, int, std::string, std::string, uint32_t>;
+    using WorkspaceState = std::tuple<std::string, std::string, uint32_t>;
+    using OutputState = std::tuple<int, int, int, int, int>;
+
+    /// A bound cloth_window_manager
+    struct Client {
+      wl::resource_t* resource;
+      /// The event classes the client subscribed to
+      uint32_t events;
+
+      std::optional<FocusState> focus;
+      /// By view id
+      std::unordered_map<uint32_t, ViewState> views;
+      /// By workspace index
+      std::unordered_map<int, WorkspaceState> workspaces;
+      /// By output name
+      std::unordered_map<std::string, OutputState> outputs;
+    };
+
     Server& server;
     wl::global_t* global;
-    std::vector<wl::resource_t*> bound_clients;
+    std::vector<Client> bound_clients;
+
+  private:
+    auto schedule_flush() -> void;
+
+    /// Workspaces whose focus changed, the latest change last. They are looked up by index
+    /// when flushing, they may be gone by then
+    std::vector<int> _dirty_focus;
+    std::set<int> _dirty_workspaces;
+    std::set<int> _removed_workspaces;
+    std::vector<View*> _dirty_views;
+    std::vector<uint32_t> _removed_views;
+    std::vector<Output*> _dirty_outputs;
+    std::vector<std::string> _removed_outputs;
+
+    bool _flush_scheduled = false;
+    chrono::steady_clock::time_point _last_flush;
+    wl::event_source_t* _flush_idle = nullptr;
+    wl::event_source_t* _flush_timer = nullptr;
   };
 
 }
@@ -1,25 +1,39 @@
 #include "workspace_manager.hpp"
 
+#include <limits>
+
 #include "util/logging.hpp"
 
+#include "output.hpp"
 #include "server.hpp"
 
 #include <tablecloth-shell-server-protocol.h>
 
 namespace cloth {
 
+  /// Workspace indices are ints. Larger ones would turn negative, which get_workspace throws
+  /// for, and exceptions must not unwind through libwayland
+  static auto valid_index(uint32_t ws) -> bool
+  {
+    if (ws <= uint32_t(std::numeric_limits<int>::max())) return true;
+    LOGE("Invalid workspace index {}", ws);
+    return false;
+  }
+
   static const struct workspace_manager_interface workspace_manager_impl = {
     .switch_to = [] (wl::client_t*, wl::resource_t* resource, uint32_t ws) {
+      if (!valid_index(ws)) return;
       static_cast<WorkspaceManager*>(resource->data)->switch_to(ws);
     },
     .move_surface = [] (wl::client_t*, wl::resource_t* resource, wl::resource_t* surface, uint32_t ws) {
+      if (!valid_index(ws)) return;
       static_cast<WorkspaceManager*>(resource->data)->move_surface(surface, ws);
     }
   };
 
   static void bind_workspace_manager(wl::client_t* client, void* data, uint32_t version, uint32_t id)
   {
-    if (version > 1) version = 1;
+    if (version > 3) version = 3;
 
     wl::resource_t* resource = wl_resource_create(client, &workspace_manager_interface, version, id);
     wl_resource_set_implementation(resource, &workspace_manager_impl, data, nullptr);
@@ -29,12 +43,12 @@ namespace cloth {
     };
     auto& wm = *static_cast<WorkspaceManager*>(data);
     wm.bound_clients.push_back(resource);
-    wm.send_state();
+    wm.send_state(resource);
   }
 
   WorkspaceManager::WorkspaceManager(Server& server) 
     : server(server),
-      global (wl_global_create(server.wl_display, &workspace_manager_interface, 1, this, &bind_workspace_manager))
+      global (wl_global_create(server.wl_display, &workspace_manager_interface, 3, this, &bind_workspace_manager))
   {}
 
   WorkspaceManager::~WorkspaceManager() noexcept {
@@ -47,25 +61,80 @@ namespace cloth {
   // Implementations // 
 
   auto WorkspaceManager::switch_to(int idx) -> void {
-    server.desktop.switch_to_workspace(idx);
+    server.desktop.switch_to_workspace(server.desktop.get_workspace(idx));
   }
 
   auto WorkspaceManager::move_surface(wl::resource_t* surface_resource, int ws_idx) -> void {
     auto surface = (wlr::surface_t*) wl_resource_get_user_data(surface_resource);
-    auto& dst_ws = server.desktop.workspaces.at(ws_idx);
-    for (auto& ws : server.desktop.workspaces) {
-      auto found = util::find_if(ws.views(), [&] (View& v) { return v.wlr_surface == surface; });
-      if (found != ws.views().end()) {
-        dst_ws.add_view(ws.erase_view(*found));
-        return;
-      }
+    // Mapped views set themselves as the data of their surface
+    auto* view = surface ? (View*) surface->data : nullptr;
+    if (view == nullptr) {
+      LOGE("Surface not found");
+      return;
+    }
+    auto& ws = *view->workspace;
+    if (ws.index != ws_idx) server.desktop.get_workspace(ws_idx).add_view(ws.erase_view(*view));
+  }
+
+  /// Send an event to every resource the client of `resource` has for the output
+  template<typename Func>
+  static auto for_each_output_resource(wl::resource_t* resource, Output& output, Func&& func) {
+    auto* client = wl_resource_get_client(resource);
+    // The client may have bound the output more than once
+    wl::resource_t* output_resource;
+    wl_resource_for_each(output_resource, &output.wlr_output.resources) {
+      if (wl_resource_get_client(output_resource) == client) func(output_resource);
     }
-    LOGE("Surface not found");
   }
 
   auto WorkspaceManager::send_state() -> void {
     for (auto* resource : bound_clients) {
-      workspace_manager_send_state(resource, server.desktop.current_workspace().index, Desktop::workspace_count);
+      send_state(resource);
+    }
+  }
+
+  auto WorkspaceManager::send_state(wl::resource_t* resource) -> void {
+    auto& desktop = server.desktop;
+    if (desktop.outputs.empty()) return;
+    bool incremental = wl_resource_get_version(resource) >= WORKSPACE_MANAGER_WORKSPACE_ADDED_SINCE_VERSION;
+    if (incremental) {
+      for (auto& [index, ws] : desktop.workspaces) {
+        workspace_manager_send_workspace_added(resource, index, ws->name.c_str());
+      }
+    }
+    workspace_manager_send_state(resource, desktop.current_workspace().index, desktop.workspaces.size());
+    if (wl_resource_get_version(resource) < WORKSPACE_MANAGER_OUTPUT_STATE_SINCE_VERSION) return;
+    for (auto& output : desktop.outputs) {
+      for_each_output_resource(resource, output, [&] (wl::resource_t* output_resource) {
+        workspace_manager_send_output_state(resource, output_resource, output.workspace->index);
+      });
+    }
+  }
+
+  auto WorkspaceManager::send_output_state(Output& output) -> void {
+    auto& desktop = server.desktop;
+    for (auto* resource : bound_clients) {
+      if (&output == &desktop.focused_output()) {
+        workspace_manager_send_state(resource, output.workspace->index, desktop.workspaces.size());
+      }
+      if (wl_resource_get_version(resource) < WORKSPACE_MANAGER_OUTPUT_STATE_SINCE_VERSION) continue;
+      for_each_output_resource(resource, output, [&] (wl::resource_t* output_resource) {
+        workspace_manager_send_output_state(resource, output_resource, output.workspace->index);
+      });
+    }
+  }
+
+  auto WorkspaceManager::send_workspace_added(Workspace& ws) -> void {
+    for (auto* resource : bound_clients) {
+      if (wl_resource_get_version(resource) < WORKSPACE_MANAGER_WORKSPACE_ADDED_SINCE_VERSION) continue;
+      workspace_manager_send_workspace_added(resource, ws.index, ws.name.c_str());
+    }
+  }
+
+  auto WorkspaceManager::send_workspace_removed(int index) -> void {
+    for (auto* resource : bound_clients) {
+      if (wl_resource_get_version(resource) < WORKSPACE_MANAGER_WORKSPACE_REMOVED_SINCE_VERSION) continue;
+      workspace_manager_send_workspace_removed(resource, index);
     }
   }
 
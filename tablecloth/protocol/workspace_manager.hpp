@@ -6,13 +6,20 @@
 
 namespace cloth {
 
+  struct Output;
   struct Server;
+  struct Workspace;
 
   struct WorkspaceManager {
     auto switch_to(int idx) -> void;
     auto move_surface(wl::resource_t*, int ws_idx) -> void;
 
+    /// Send the full state to all clients
     auto send_state() -> void;
+    auto send_state(wl::resource_t* resource) -> void;
+    auto send_output_state(Output& output) -> void;
+    auto send_workspace_added(Workspace& workspace) -> void;
+    auto send_workspace_removed(int index) -> void;
 
     WorkspaceManager(Server&);
     ~WorkspaceManager() noexcept;
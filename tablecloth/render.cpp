@@ -1,5 +1,7 @@
 #include "render.hpp"
 
+#include <algorithm>
+
 #include "util/logging.hpp"
 
 #include "output.hpp"
@@ -7,6 +9,8 @@
 #include "server.hpp"
 #include "view.hpp"
 
+#include "render_gles2.hpp"
+#include "render_pixman.hpp"
 #include "render_utils.hpp"
 
 namespace cloth::render {
@@ -16,8 +20,24 @@ namespace cloth::render {
     const RenderData& data;
   };
 
+  auto make_backend(Output& output) -> std::unique_ptr<Backend>
+  {
+    auto& desktop = output.desktop;
+    if (auto* surfaces = desktop.surface_images.get(); surfaces) {
+      return std::make_unique<PixmanBackend>(output, *surfaces);
+    }
+    if (!desktop.programs) {
+      // Outputs are created outside of frames, where no context is current
+      wlr_egl_make_current(wlr_backend_get_egl(desktop.server.backend), EGL_NO_SURFACE, nullptr);
+      desktop.programs = std::make_unique<Programs>();
+    }
+    return std::make_unique<GLES2Backend>(output, *desktop.programs);
+  }
+
   Context::Context(Output& output)
-    : output(output), damage(wlr_output_damage_create(&output.wlr_output))
+    : output(output),
+      backend(make_backend(output)),
+      damage(wlr_output_damage_create(&output.wlr_output))
   {}
 
   //////////////////////////////////////////
@@ -67,19 +87,7 @@ namespace cloth::render {
       return false;
     }
 
-    if (auto* xdg_surface_v6 = dynamic_cast<XdgSurfaceV6*>(&view); xdg_surface_v6) {
-      return wl_list_empty(&xdg_surface_v6->xdg_surface->popups);
-    } else if (auto* xdg_surface = dynamic_cast<XdgSurface*>(&view); xdg_surface) {
-      return wl_list_empty(&xdg_surface->xdg_surface->popups);
-    } else if (auto* wl_shell_surface = dynamic_cast<WlShellSurface*>(&view); wl_shell_surface) {
-      return wl_list_empty(&wl_shell_surface->wl_shell_surface->popups);
-    } else
-#ifdef WLR_HAS_XWAYLAND
-      if (auto* wlr_surface = dynamic_cast<XwaylandSurface*>(&view); wlr_surface) {
-      return wl_list_empty(&wlr_surface->xwayland_surface->children);
-    }
-#endif
-    return true;
+    return !view.has_popups();
   }
 
   /**
@@ -161,6 +169,29 @@ namespace cloth::render {
     wlr_renderer_scissor(renderer, &box);
   }
 
+  auto output_box_from_layout(Output& output, wlr::box_t box) -> wlr::box_t
+  {
+    double x = box.x, y = box.y;
+    wlr_output_layout_output_coords(output.desktop.layout, &output.wlr_output, &x, &y);
+    float scale = output.wlr_output.scale;
+    return {.x = int(x * scale),
+            .y = int(y * scale),
+            .width = int(box.width * scale),
+            .height = int(box.height * scale)};
+  }
+
+  auto fit_box(wlr::box_t area, int width, int height) -> wlr::box_t
+  {
+    if (width <= 0 || height <= 0) return {.x = area.x, .y = area.y, .width = 0, .height = 0};
+    double scale = std::min({area.width / double(width), area.height / double(height), 1.0});
+    int w = width * scale;
+    int h = height * scale;
+    return {.x = area.x + (area.width - w) / 2,
+            .y = area.y + (area.height - h) / 2,
+            .width = w,
+            .height = h};
+  }
+
   struct SurfaceRenderData {
     Context& context;
     // The data for the toplevel view this surface is linked to.
@@ -179,64 +210,33 @@ namespace cloth::render {
 
     auto& data = *(SurfaceRenderData*) _data;
 
-    Output& output = data.context.output;
-    float rotation = data.parent_data.layout.rotation;
-
-    wlr::texture_t* texture = wlr_surface_get_texture(surface);
-    if (texture == nullptr) {
+    if (!wlr_surface_has_buffer(surface)) {
       return;
     }
 
-    wlr::renderer_t* renderer = wlr_backend_get_renderer(output.wlr_output.backend);
-    assert(renderer);
-
-    double lx, ly;
-    get_layout_position(data.parent_data.layout, lx, ly, *surface, sx * data.x_scale,
-                        sy * data.x_scale);
-
-    wlr::box_t box = {.x = (int) lx,
-                      .y = (int) ly,
-                      .width = int(surface->current.width * data.x_scale),
-                      .height = int(surface->current.height * data.x_scale)};
-
-    wlr::box_t rotated;
-    wlr_box_rotated_bounds(&box, rotation, &rotated);
+    auto& cached =
+      data.context.surface_transform(*surface, TransformUse::render, data.parent_data.layout,
+                                     sx * data.x_scale, sy * data.x_scale, data.x_scale);
 
-    pixman_region32_t damage;
-    pixman_region32_init(&damage);
-    pixman_region32_union_rect(&damage, &damage, rotated.x, rotated.y, rotated.width,
-                               rotated.height);
-    pixman_region32_intersect(&damage, &damage, &data.context.pixman_damage);
-    bool damaged = pixman_region32_not_empty(&damage);
-    if (damaged) {
-      float matrix[9];
-      auto transform = wlr_output_transform_invert(surface->current.transform);
-      wlr_matrix_project_box(matrix, &box, transform, rotation, output.wlr_output.transform_matrix);
-
-      int nrects;
-      pixman_box32_t* rects = pixman_region32_rectangles(&damage, &nrects);
-      for (int i = 0; i < nrects; ++i) {
-        scissor_output(output, &rects[i]);
-        wlr_render_texture_with_matrix(renderer, texture, matrix, data.parent_data.alpha);
-      }
+    pixman_region32_t clip;
+    if (data.context.clip(cached.transform.bounds, clip)) {
+      data.context.backend->draw_surface(clip, *surface, cached.transform, data.parent_data.alpha);
     }
-
-    pixman_region32_fini(&damage);
+    pixman_region32_fini(&clip);
   };
 
   static void surface_send_frame_done(wlr::surface_t* surface, int sx, int sy, void* _data)
   {
     auto& cvd = *(SurfaceRenderData*) _data;
     auto when = chrono::to_timespec(cvd.context.when);
-    float rotation = cvd.parent_data.layout.rotation;
-
-    double lx, ly;
-    get_layout_position(cvd.parent_data.layout, lx, ly, *surface, sx, sy);
 
-    if (!surface_intersect_output(*surface, *cvd.context.output.desktop.layout,
-                                  cvd.context.output.wlr_output, lx, ly, rotation, nullptr)) {
+    auto& cached = cvd.context.surface_transform(*surface, Context::TransformUse::frame_done,
+                                                 cvd.parent_data.layout, sx, sy, 1);
+    if (!cached.on_output) {
       return;
     }
+    // Clients over their frame rate get the callbacks later
+    if (!cvd.context.output.desktop.server.client_accounting.allow_frame_done(*surface)) return;
 
     wlr_surface_send_frame_done(surface, &when);
   }
@@ -273,6 +273,39 @@ namespace cloth::render {
     }
   } // namespace cloth
 
+  auto Context::clip(wlr::box_t box, float rotation, pixman_region32_t& clip) -> bool
+  {
+    wlr::box_t rotated;
+    wlr_box_rotated_bounds(&box, rotation, &rotated);
+    return this->clip(rotated, clip);
+  }
+
+  auto Context::clip(wlr::box_t bounds, pixman_region32_t& clip) -> bool
+  {
+    pixman_region32_init(&clip);
+    pixman_region32_union_rect(&clip, &clip, bounds.x, bounds.y, bounds.width, bounds.height);
+    pixman_region32_intersect(&clip, &clip, &pixman_damage);
+    return pixman_region32_not_empty(&clip);
+  }
+
+  auto Context::draw_rect(wlr::box_t box, std::array<float, 4> color) -> void
+  {
+    box = output_box_from_layout(output, box);
+
+    pixman_region32_t damage;
+    if (clip(box, 0, damage)) backend->draw_rect(damage, box, 0, color);
+    pixman_region32_fini(&damage);
+  }
+
+  auto Context::draw_texture(const Texture& texture, wlr::box_t box, float alpha) -> void
+  {
+    box = output_box_from_layout(output, box);
+
+    pixman_region32_t damage;
+    if (clip(box, 0, damage)) backend->draw_texture(damage, texture, box, alpha);
+    pixman_region32_fini(&damage);
+  }
+
   auto Context::reset() -> void
   {
     views.clear();
@@ -280,6 +313,78 @@ namespace cloth::render {
     clear_color = {0.25f, 0.25f, 0.25f, 1.0f};
   }
 
+  auto Context::invalidate_transforms() -> void
+  {
+    _transforms_generation++;
+  }
+
+  auto Context::surface_transform(wlr::surface_t& surface,
+                                  TransformUse use,
+                                  const LayoutData& layout,
+                                  int sx,
+                                  int sy,
+                                  double scale) -> const CachedTransform&
+  {
+    auto& transforms = _surface_transforms[&surface];
+    transforms.last_used = _frames;
+
+    auto& cached = transforms.uses[int(use)];
+    CachedTransform::Key key = {.layout = layout,
+                                .sx = sx,
+                                .sy = sy,
+                                .scale = scale,
+                                .width = surface.current.width,
+                                .height = surface.current.height,
+                                .buffer_transform = surface.current.transform,
+                                .buffer_x = surface.sx,
+                                .buffer_y = surface.sy,
+                                .generation = _transforms_generation};
+    if (cached.valid && cached.key == key) return cached;
+    cached.key = key;
+    cached.valid = true;
+
+    auto& transform = cached.transform;
+    transform.rotation = layout.rotation;
+
+    double lx, ly;
+    get_layout_position(layout, lx, ly, surface, sx, sy);
+
+    switch (use) {
+    case TransformUse::render: {
+      transform.box = {.x = (int) lx,
+                       .y = (int) ly,
+                       .width = int(surface.current.width * scale),
+                       .height = int(surface.current.height * scale)};
+      auto buffer_transform = wlr_output_transform_invert(surface.current.transform);
+      wlr_matrix_project_box(transform.matrix.data(), &transform.box, buffer_transform,
+                             transform.rotation, output.wlr_output.transform_matrix);
+      cached.on_output = true;
+      break;
+    }
+    case TransformUse::frame_done:
+    case TransformUse::damage:
+      cached.on_output = surface_intersect_output(surface, *output.desktop.layout,
+                                                  output.wlr_output, lx, ly, transform.rotation,
+                                                  &transform.box);
+      break;
+    }
+    wlr_box_rotated_bounds(&transform.box, transform.rotation, &transform.bounds);
+    return cached;
+  }
+
+  auto Context::prune_transforms() -> void
+  {
+    constexpr unsigned max_unused_frames = 64;
+    if (++_frames % max_unused_frames != 0) return;
+    for (auto it = _surface_transforms.begin(); it != _surface_transforms.end();) {
+      if (_frames - it->second.last_used > max_unused_frames) {
+        it = _surface_transforms.erase(it);
+      } else {
+        ++it;
+      }
+    }
+  }
+
   auto Context::do_render() -> void
   {
     renderer = wlr_backend_get_renderer(output.wlr_output.backend);
@@ -317,28 +422,42 @@ namespace cloth::render {
       return;
     }
 
+    // Thumbnails have their own framebuffers, so they are drawn before the output's frame begins
+    if (backend->has_framebuffers()) {
+      for (auto* view : output.desktop.thumbnails.update(*renderer)) {
+        output.desktop.overview.damage_view(*view);
+        output.desktop.switcher.damage_view(*view);
+      }
+    }
+
+    int width, height;
+    wlr_output_transformed_resolution(&output.wlr_output, &width, &height);
+
     // otherwise Output doesn't need swap and isn't damaged, skip rendering completely
     if (needs_swap) {
-      wlr_renderer_begin(renderer, output.wlr_output.width, output.wlr_output.height);
+      backend->begin();
 
       // otherwise Output isn't damaged but needs buffer swap
       if (pixman_region32_not_empty(&pixman_damage)) {
         if (output.desktop.server.config.debug_damage_tracking) {
-          wlr_renderer_clear(renderer, (float[]){1, 1, 0, 1});
+          pixman_region32_t whole;
+          pixman_region32_init_rect(&whole, 0, 0, width, height);
+          backend->clear(whole, {1, 1, 0, 1});
+          pixman_region32_fini(&whole);
         }
 
-        int nrects;
-        pixman_box32_t* rects = pixman_region32_rectangles(&pixman_damage, &nrects);
-        for (int i = 0; i < nrects; ++i) {
-          scissor_output(output, &rects[i]);
-          wlr_renderer_clear(renderer, clear_color.data());
-        }
+        backend->clear(pixman_damage, clear_color);
 
         render(output.layers[ZWLR_LAYER_SHELL_V1_LAYER_BACKGROUND]);
         render(output.layers[ZWLR_LAYER_SHELL_V1_LAYER_BOTTOM]);
 
-        // If a view is fullscreen on this output, render it
-        if (fullscreen_view) {
+        bool views_hidden = true;
+        if (output.desktop.overview.covers(output)) {
+          // The overview replaces the views, but clients still get frame events so the
+          // thumbnails stay live
+          output.desktop.overview.render(*this);
+        } else if (fullscreen_view) {
+          // If a view is fullscreen on this output, render it
           auto& view = *fullscreen_view;
           RenderData data = {.layout =
                                {
@@ -360,7 +479,7 @@ namespace cloth::render {
             // because all windows are rendered. Here we only want to render
             // the fullscreen window's children so we have to traverse the tree.
 #ifdef WLR_HAS_XWAYLAND
-            if (auto* xwayland_surface = dynamic_cast<XwaylandSurface*>(&view); xwayland_surface) {
+            if (auto* xwayland_surface = view_cast<XwaylandSurface>(&view); xwayland_surface) {
               for_each_surface(*xwayland_surface->xwayland_surface, render_surface, data);
             }
 #endif
@@ -370,7 +489,10 @@ namespace cloth::render {
           for (auto& vd : views) {
             render(vd.view, vd.data);
           }
+          views_hidden = false;
         }
+        // Snapshots finish and are freed even while the views are hidden
+        output.desktop.animations.render(*this, !views_hidden);
 
         // Render top layer above shell views
         render(output.layers[ZWLR_LAYER_SHELL_V1_LAYER_TOP]);
@@ -380,17 +502,18 @@ namespace cloth::render {
         for_each_drag_icon(output.desktop.server.input, render_surface, data);
 
         render(output.layers[ZWLR_LAYER_SHELL_V1_LAYER_OVERLAY]);
-      }
 
-      wlr_renderer_scissor(renderer, nullptr);
-      wlr_renderer_end(renderer);
+        if (output.desktop.switcher.covers(output)) output.desktop.switcher.render(*this);
+
+        if (output.dim > 0) draw_rect(output.layout_box(), {0.f, 0.f, 0.f, output.dim});
+      }
 
       if (output.desktop.server.config.debug_damage_tracking) {
-        int width, height;
-        wlr_output_transformed_resolution(&output.wlr_output, &width, &height);
         pixman_region32_union_rect(&pixman_damage, &pixman_damage, 0, 0, width, height);
       }
 
+      backend->end(pixman_damage);
+
       // PREV: update now?
       struct timespec now_ts = chrono::to_timespec(when);
       if (wlr_output_damage_swap_buffers(this->damage, &now_ts, &pixman_damage)) {
@@ -402,6 +525,13 @@ namespace cloth::render {
     damage_done();
   }
 
+  auto Context::send_frame_done() -> void
+  {
+    when = chrono::clock::now();
+    pixman_region32_init(&pixman_damage);
+    damage_done();
+  }
+
   auto Context::damage_done() -> void
   {
     // Damage finish
@@ -428,7 +558,7 @@ namespace cloth::render {
       for_each_surface(view, surface_send_frame_done, data);
 
 #ifdef WLR_HAS_XWAYLAND
-      if (auto* xwayland_surface = dynamic_cast<XwaylandSurface*>(&view); xwayland_surface) {
+      if (auto* xwayland_surface = view_cast<XwaylandSurface>(&view); xwayland_surface) {
         for_each_surface(*xwayland_surface->xwayland_surface, surface_send_frame_done, data);
       }
 #endif
@@ -441,6 +571,7 @@ namespace cloth::render {
       for_each_drag_icon(output.desktop.server.input, surface_send_frame_done, data);
     }
     layers_send_done();
+    prune_transforms();
   }
 
 
@@ -462,8 +593,8 @@ namespace cloth::render {
     }
 #ifdef WLR_HAS_XWAYLAND
     {
-      auto* xfv = dynamic_cast<XwaylandSurface*>(output.workspace->fullscreen_view);
-      auto* xv = dynamic_cast<XwaylandSurface*>(&view);
+      auto* xfv = view_cast<XwaylandSurface>(output.workspace->fullscreen_view);
+      auto* xv = view_cast<XwaylandSurface>(&view);
       if (xfv && xv) {
         // Special case: accept damage from children
         auto* xsurface = xv->xwayland_surface;
@@ -484,30 +615,27 @@ namespace cloth::render {
     wlr_output_damage_add_whole(damage);
   }
 
+  auto Context::damage_box(wlr::box_t box) -> void
+  {
+    box = output_box_from_layout(output, box);
+    wlr_output_damage_add_box(damage, &box);
+  }
+
   static void damage_whole_surface(wlr::surface_t* surface, int sx, int sy, void* _data)
   {
     auto& [context, data, x_scale, y_scale] = *(SurfaceRenderData*) _data;
-    float rotation = data.layout.rotation;
-
-    double lx, ly;
-    get_layout_position(data.layout, lx, ly, *surface, sx * x_scale, sy * y_scale);
 
     if (!wlr_surface_has_buffer(surface)) {
       return;
     }
 
-    int ow, oh;
-    wlr_output_transformed_resolution(&context.output.wlr_output, &ow, &oh);
-
-    wlr::box_t box;
-    bool intersects = surface_intersect_output(*surface, *context.output.desktop.layout,
-                                               context.output.wlr_output, lx, ly, rotation, &box);
-    if (!intersects) {
+    auto& cached = context.surface_transform(*surface, Context::TransformUse::damage, data.layout,
+                                             sx * x_scale, sy * y_scale, x_scale);
+    if (!cached.on_output) {
       return;
     }
 
-    wlr_box_rotated_bounds(&box, rotation, &box);
-
+    wlr::box_t box = cached.transform.bounds;
     wlr_output_damage_add_box(context.damage, &box);
   }
 
@@ -570,19 +698,13 @@ namespace cloth::render {
     wlr::output_t& wlr_output = context.output.wlr_output;
     float rotation = data.layout.rotation;
 
-    double lx, ly;
-    get_layout_position(data.layout, lx, ly, *surface, sx * x_scale, sy * y_scale);
-
     if (!wlr_surface_has_buffer(surface)) {
       return;
     }
 
-    int ow, oh;
-    wlr_output_transformed_resolution(&wlr_output, &ow, &oh);
-
-    wlr::box_t box;
-    surface_intersect_output(*surface, *context.output.desktop.layout, wlr_output, lx, ly, rotation,
-                             &box);
+    auto& cached = context.surface_transform(*surface, Context::TransformUse::damage, data.layout,
+                                             sx * x_scale, sy * y_scale, x_scale);
+    wlr::box_t box = cached.transform.box;
 
     int center_x = box.x + box.width / 2;
     int center_y = box.y + box.height / 2;
@@ -654,17 +776,7 @@ namespace cloth::render {
     }
     SurfaceRenderData cd = {*this, data, .x_scale = data.layout.width / double(view.width),
                             .y_scale = data.layout.height / double(view.height)};
-    if (auto* xdg_surface_v6 = dynamic_cast<XdgSurfaceV6*>(&view); xdg_surface_v6) {
-      wlr_xdg_surface_v6_for_each_surface(xdg_surface_v6->xdg_surface, iterator, &cd);
-    } else if (auto* xdg_surface = dynamic_cast<XdgSurface*>(&view); xdg_surface) {
-      wlr_xdg_surface_for_each_surface(xdg_surface->xdg_surface, iterator, &cd);
-    } else if (auto* wl_shell_surface = dynamic_cast<WlShellSurface*>(&view); wl_shell_surface) {
-      wlr_wl_shell_surface_for_each_surface(wl_shell_surface->wl_shell_surface, iterator, &cd);
-#ifdef WLR_HAS_XWAYLAND
-    } else if (auto* wlr_surface = dynamic_cast<XwaylandSurface*>(&view); wlr_surface) {
-      wlr_surface_for_each_surface(wlr_surface->xwayland_surface->surface, iterator, &cd);
-#endif
-    }
+    view.for_each_surface(iterator, &cd);
   }
 
 #ifdef WLR_HAS_XWAYLAND
@@ -1,5 +1,9 @@
 #pragma once
 
+#include <array>
+#include <memory>
+#include <unordered_map>
+
 #include <pixman.h>
 
 #include "util/chrono.hpp"
@@ -7,6 +11,7 @@
 #include "util/ptr_vec.hpp"
 
 #include "layers.hpp"
+#include "render_backend.hpp"
 #include "wlroots.hpp"
 
 namespace cloth {
@@ -22,7 +27,6 @@ namespace cloth {
 
   namespace render {
 
-
     struct LayoutData {
       double x = 0;
       double y = 0;
@@ -56,6 +60,8 @@ namespace cloth {
       Context(Output& output);
 
       auto do_render() -> void;
+      /// Skip rendering this frame, but let clients know they can draw the next one
+      auto send_frame_done() -> void;
 
       auto damage_whole() -> void;
       auto damage_whole_layer(LayerSurface& layer)
@@ -75,14 +81,82 @@ namespace cloth {
                                       double ox,
                                       double oy,
                                       float rotation = 0) -> void;
+      /// Damage a box given in layout coordinates
+      auto damage_box(wlr::box_t box) -> void;
+
+      /// Draw a solid rectangle, in layout coordinates. Only valid during do_render
+      auto draw_rect(wlr::box_t box, std::array<float, 4> color) -> void;
+      /// Draw a texture stretched over a box in layout coordinates. Only valid during do_render
+      auto draw_texture(const Texture& texture, wlr::box_t box, float alpha) -> void;
+      /// Draw the cached thumbnail of a view into a box in layout coordinates.
+      /// Only valid during do_render
+      auto draw_thumbnail(View& view, wlr::box_t box, float alpha) -> void;
+      /// Draw the contents of a framebuffer stretched over a box in layout coordinates.
+      /// Only valid during do_render
+      auto draw_framebuffer(const Framebuffer& fb, wlr::box_t box, float alpha) -> void;
 
       auto reset() -> void;
 
+      /// Drop all cached surface transforms. For when the output's mode, transform, scale or
+      /// place in the layout changed
+      auto invalidate_transforms() -> void;
+
+      /// What a surface transform is looked up for. Each use is cached on its own, since
+      /// drawing, frame callbacks and damage are computed from different layout data
+      enum struct TransformUse { render, frame_done, damage };
+
+      struct CachedTransform {
+        /// What the transform was computed from
+        struct Key {
+          LayoutData layout;
+          /// Offset of the surface in its parent, already scaled
+          int sx = 0;
+          int sy = 0;
+          double scale = 1;
+          int width = 0;
+          int height = 0;
+          int buffer_transform = 0;
+          int buffer_x = 0;
+          int buffer_y = 0;
+          unsigned generation = 0;
+
+          DEFAULT_EQUALITY(Key,
+                           layout,
+                           sx,
+                           sy,
+                           scale,
+                           width,
+                           height,
+                           buffer_transform,
+                           buffer_x,
+                           buffer_y,
+                           generation);
+        };
+
+        Key key;
+        bool valid = false;
+        SurfaceTransform transform;
+        /// Whether the surface is on this output at all
+        bool on_output = true;
+      };
+
+      /// The transform of a surface at (sx, sy) in a parent laid out by `layout`, scaled by
+      /// `scale`. Computed again only if one of those, the surface's size or buffer, or the
+      /// output changed since it was last looked up for `use`
+      auto surface_transform(wlr::surface_t& surface,
+                             TransformUse use,
+                             const LayoutData& layout,
+                             int sx,
+                             int sy,
+                             double scale) -> const CachedTransform&;
+
       // DATA //
 
       Output& output;
 
       wlr::renderer_t* renderer = nullptr;
+      /// What frames are drawn with
+      std::unique_ptr<Backend> backend;
       chrono::time_point when = chrono::clock::now();
       std::vector<ViewAndData> views;
       std::array<float, 4> clear_color = {0.25f, 0.25f, 0.25f, 1.0f};
@@ -91,6 +165,13 @@ namespace cloth {
       wlr::box_t* output_box;
 
     private:
+      /// Initialize `clip` to the part of the frame's damage covered by a box in output
+      /// coordinates, once rotated. Returns false if there is none. Finishing `clip` is up to
+      /// the caller either way
+      auto clip(wlr::box_t box, float rotation, pixman_region32_t& clip) -> bool;
+      /// Like clip, with the rotated bounds already known
+      auto clip(wlr::box_t bounds, pixman_region32_t& clip) -> bool;
+
       auto draw_shadow(wlr::box_t box, float rotation, float alpha, float radius, float offset)
         -> void;
 
@@ -121,6 +202,21 @@ namespace cloth {
       static auto render_surface(wlr::surface_t* surface, int sx, int sy, void* data) -> void;
 
       pixman_region32 pixman_damage;
+
+      /// Entries are pruned once they go unused for a while, instead of on surface destroy.
+      /// A new surface at the address of a destroyed one can't get a wrong transform, since
+      /// everything a transform depends on is in its key
+      struct SurfaceTransforms {
+        std::array<CachedTransform, 3> uses;
+        unsigned last_used = 0;
+      };
+      auto prune_transforms() -> void;
+
+      std::unordered_map<wlr::surface_t*, SurfaceTransforms> _surface_transforms;
+      /// Bumped to invalidate all cached transforms at once
+      unsigned _transforms_generation = 0;
+      /// Frames done, to tell which transforms went unused
+      unsigned _frames = 0;
     };
 
   } // namespace render
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <array>
+#include <memory>
+
+#include <pixman.h>
+
+#include "wlroots.hpp"
+
+namespace cloth {
+
+  struct Output;
+
+  namespace render {
+
+    struct Framebuffer;
+
+    /// Pixels drawn by the compositor itself, like the titles in the switcher.
+    /// Created by the backend that draws it
+    struct Texture {
+      virtual ~Texture() noexcept = default;
+
+      int width = 0;
+      int height = 0;
+    };
+
+    /// Where a client surface is drawn on an output
+    struct SurfaceTransform {
+      /// Output-local, scaled, before rotation
+      wlr::box_t box = {};
+      float rotation = 0;
+      /// box, once rotated
+      wlr::box_t bounds = {};
+      /// Projects the unit square onto box, with the buffer and output transforms applied
+      std::array<float, 9> matrix = {};
+    };
+
+    /// Draws the frames of an output for a render::Context.
+    ///
+    /// Boxes are in output-local, scaled coordinates, and rotate around their center. Every draw
+    /// is clipped to `clip`, the part of the frame's damage it covers, which is never empty.
+    struct Backend {
+      virtual ~Backend() noexcept = default;
+
+      /// Start a frame. The output is current
+      virtual auto begin() -> void = 0;
+      /// Finish a frame, of which `damage` was drawn
+      virtual auto end(pixman_region32_t& damage) -> void = 0;
+
+      virtual auto clear(pixman_region32_t& clip, std::array<float, 4> color) -> void = 0;
+      virtual auto draw_rect(pixman_region32_t& clip,
+                             wlr::box_t box,
+                             float rotation,
+                             std::array<float, 4> color) -> void = 0;
+      /// Draw the current buffer of a client surface stretched over transform.box
+      virtual auto draw_surface(pixman_region32_t& clip,
+                                wlr::surface_t& surface,
+                                const SurfaceTransform& transform,
+                                float alpha) -> void = 0;
+      virtual auto draw_texture(pixman_region32_t& clip,
+                                const Texture& texture,
+                                wlr::box_t box,
+                                float alpha) -> void = 0;
+      /// A shadow filling box, fading out over `radius` pixels from its edges
+      virtual auto draw_shadow(pixman_region32_t& clip,
+                               wlr::box_t box,
+                               float rotation,
+                               float alpha,
+                               float radius) -> void = 0;
+      /// Only drawn by backends with framebuffers
+      virtual auto draw_framebuffer(pixman_region32_t& clip,
+                                    const Framebuffer& fb,
+                                    wlr::box_t box,
+                                    float alpha) -> void
+      {}
+
+      /// Copy pixels in a wl_shm format into a texture. Returns nullptr on failure
+      virtual auto create_texture(wl::shm_format_t format,
+                                  int stride,
+                                  int width,
+                                  int height,
+                                  const void* data) -> std::unique_ptr<Texture> = 0;
+
+      /// Whether views can be rendered into Framebuffers. Without them, thumbnails are drawn
+      /// from the surfaces of their views, and closing views aren't animated
+      virtual auto has_framebuffers() const noexcept -> bool
+      {
+        return false;
+      }
+    };
+
+    /// The backend for the output, as chosen in the config
+    auto make_backend(Output& output) -> std::unique_ptr<Backend>;
+
+  } // namespace render
+} // namespace cloth
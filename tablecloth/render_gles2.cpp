@@ -0,0 +1,250 @@
+#include "render_gles2.hpp"
+
+#include "output.hpp"
+
+#include "render_utils.hpp"
+#include "thumbnail.hpp"
+
+#include <GLES2/gl2.h>
+
+namespace cloth::render {
+
+  /// Owns a texture of the wlroots renderer
+  struct GLES2Texture final : Texture {
+    GLES2Texture(wlr::texture_t& texture) noexcept : texture(texture) {}
+    ~GLES2Texture() noexcept
+    {
+      wlr_texture_destroy(&texture);
+    }
+
+    wlr::texture_t& texture;
+  };
+
+  static const std::string shadow_vertex = R"END(
+uniform mat3 proj;
+uniform vec4 color;
+attribute vec2 pos;
+attribute vec2 texcoord;
+varying vec4 v_color;
+varying vec2 v_texcoord;
+
+void main() {
+	gl_Position = vec4(proj * vec3(pos, 1.0), 1.0);
+	v_color = color;
+	v_texcoord = texcoord;
+}
+)END";
+
+  static const std::string shadow_fragment = R"END(
+precision mediump float;
+varying vec4 v_color;
+varying vec2 v_texcoord;
+uniform float aspect;
+uniform float radius;
+
+void main()
+{
+  vec2 pos = v_texcoord;
+
+  //pos.x /= aspect;
+
+  float dx = smoothstep(0.0, radius * aspect, min(pos.x, 1.0 - pos.x));
+  float dy = smoothstep(0.0, radius, min(pos.y, 1.0 - pos.y));
+
+  float alpha = dx * dy;
+  gl_FragColor = vec4(v_color.rgb, v_color.a * alpha);
+}
+    )END";
+
+  static const std::string textured_vertex = R"END(
+uniform mat3 proj;
+attribute vec2 pos;
+attribute vec2 texcoord;
+varying vec2 v_texcoord;
+
+void main() {
+	gl_Position = vec4(proj * vec3(pos, 1.0), 1.0);
+	// Framebuffers are rendered with the output projection, which is upside down
+	v_texcoord = vec2(texcoord.x, 1.0 - texcoord.y);
+}
+)END";
+
+  static const std::string textured_fragment = R"END(
+precision mediump float;
+varying vec2 v_texcoord;
+uniform sampler2D tex;
+uniform float alpha;
+
+void main()
+{
+  gl_FragColor = texture2D(tex, v_texcoord) * alpha;
+}
+    )END";
+
+  Programs::Programs() : shadow(cache), textured(cache) {}
+
+  Programs::Shadow::Shadow(ProgramCache& cache)
+    : shader(cache, shadow_vertex, shadow_fragment),
+      proj(shader.uniform<mat3>("proj")),
+      color(shader.uniform<vec4>("color")),
+      aspect(shader.uniform<float>("aspect")),
+      radius(shader.uniform<float>("radius"))
+  {}
+
+  Programs::Textured::Textured(ProgramCache& cache)
+    : shader(cache, textured_vertex, textured_fragment),
+      proj(shader.uniform<mat3>("proj")),
+      tex(shader.uniform<int>("tex")),
+      alpha(shader.uniform<float>("alpha"))
+  {}
+
+  GLES2Backend::GLES2Backend(Output& output, Programs& programs) noexcept
+    : output(output),
+      renderer(*wlr_backend_get_renderer(output.wlr_output.backend)),
+      programs(programs)
+  {}
+
+  auto GLES2Backend::begin() -> void
+  {
+    wlr_renderer_begin(&renderer, output.wlr_output.width, output.wlr_output.height);
+  }
+
+  auto GLES2Backend::end(pixman_region32_t& damage) -> void
+  {
+    wlr_renderer_scissor(&renderer, nullptr);
+    wlr_renderer_end(&renderer);
+  }
+
+  auto GLES2Backend::clear(pixman_region32_t& clip, std::array<float, 4> color) -> void
+  {
+    int nrects;
+    pixman_box32_t* rects = pixman_region32_rectangles(&clip, &nrects);
+    for (int i = 0; i < nrects; ++i) {
+      scissor_output(output, &rects[i]);
+      wlr_renderer_clear(&renderer, color.data());
+    }
+  }
+
+  auto GLES2Backend::draw_rect(pixman_region32_t& clip,
+                               wlr::box_t box,
+                               float rotation,
+                               std::array<float, 4> color) -> void
+  {
+    float matrix[9];
+    wlr_matrix_project_box(matrix, &box, WL_OUTPUT_TRANSFORM_NORMAL, rotation,
+                           output.wlr_output.transform_matrix);
+
+    int nrects;
+    pixman_box32_t* rects = pixman_region32_rectangles(&clip, &nrects);
+    for (int i = 0; i < nrects; ++i) {
+      scissor_output(output, &rects[i]);
+      wlr_render_quad_with_matrix(&renderer, color.data(), matrix);
+    }
+  }
+
+  auto GLES2Backend::draw_surface(pixman_region32_t& clip,
+                                  wlr::surface_t& surface,
+                                  const SurfaceTransform& transform,
+                                  float alpha) -> void
+  {
+    wlr::texture_t* texture = wlr_surface_get_texture(&surface);
+    if (texture == nullptr) return;
+
+    int nrects;
+    pixman_box32_t* rects = pixman_region32_rectangles(&clip, &nrects);
+    for (int i = 0; i < nrects; ++i) {
+      scissor_output(output, &rects[i]);
+      wlr_render_texture_with_matrix(&renderer, texture, transform.matrix.data(), alpha);
+    }
+  }
+
+  auto GLES2Backend::draw_texture(pixman_region32_t& clip,
+                                  const Texture& texture,
+                                  wlr::box_t box,
+                                  float alpha) -> void
+  {
+    float matrix[9];
+    wlr_matrix_project_box(matrix, &box, WL_OUTPUT_TRANSFORM_NORMAL, 0,
+                           output.wlr_output.transform_matrix);
+
+    auto& wlr_texture = static_cast<const GLES2Texture&>(texture).texture;
+    int nrects;
+    pixman_box32_t* rects = pixman_region32_rectangles(&clip, &nrects);
+    for (int i = 0; i < nrects; ++i) {
+      scissor_output(output, &rects[i]);
+      wlr_render_texture_with_matrix(&renderer, &wlr_texture, matrix, alpha);
+    }
+  }
+
+  auto GLES2Backend::draw_shadow(pixman_region32_t& clip,
+                                 wlr::box_t box,
+                                 float rotation,
+                                 float alpha,
+                                 float radius) -> void
+  {
+    float matrix[9];
+    wlr_matrix_project_box(matrix, &box, WL_OUTPUT_TRANSFORM_NORMAL, rotation,
+                           output.wlr_output.transform_matrix);
+    mat3 transposition;
+    wlr_matrix_transpose(transposition.data(), matrix);
+
+    auto& program = programs.shadow;
+    program.shader.use();
+    program.shader.set(program.proj, transposition);
+    program.shader.set(program.color, {0.f, 0.f, 0.f, alpha});
+    program.shader.set(program.aspect, box.height / (float) box.width);
+    program.shader.set(program.radius, radius / (float) box.height);
+
+    int nrects;
+    pixman_box32_t* rects = pixman_region32_rectangles(&clip, &nrects);
+    for (int i = 0; i < nrects; ++i) {
+      scissor_output(output, &rects[i]);
+      draw_quad();
+    }
+  }
+
+  auto GLES2Backend::draw_framebuffer(pixman_region32_t& clip,
+                                      const Framebuffer& fb,
+                                      wlr::box_t box,
+                                      float alpha) -> void
+  {
+    float matrix[9];
+    wlr_matrix_project_box(matrix, &box, WL_OUTPUT_TRANSFORM_NORMAL, 0,
+                           output.wlr_output.transform_matrix);
+    mat3 transposition;
+    wlr_matrix_transpose(transposition.data(), matrix);
+
+    auto& program = programs.textured;
+    program.shader.use();
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, fb.texture);
+    program.shader.set(program.proj, transposition);
+    program.shader.set(program.tex, 0);
+    program.shader.set(program.alpha, alpha);
+
+    int nrects;
+    pixman_box32_t* rects = pixman_region32_rectangles(&clip, &nrects);
+    for (int i = 0; i < nrects; ++i) {
+      scissor_output(output, &rects[i]);
+      draw_quad();
+    }
+
+    glBindTexture(GL_TEXTURE_2D, 0);
+  }
+
+  auto GLES2Backend::create_texture(wl::shm_format_t format,
+                                    int stride,
+                                    int width,
+                                    int height,
+                                    const void* data) -> std::unique_ptr<Texture>
+  {
+    wlr::texture_t* texture =
+      wlr_texture_from_pixels(&renderer, format, stride, width, height, data);
+    if (texture == nullptr) return nullptr;
+    auto res = std::make_unique<GLES2Texture>(*texture);
+    res->width = width;
+    res->height = height;
+    return res;
+  }
+
+} // namespace cloth::render
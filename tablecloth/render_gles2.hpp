@@ -0,0 +1,81 @@
+#pragma once
+
+#include "render_backend.hpp"
+#include "render_utils.hpp"
+
+namespace cloth::render {
+
+  /// The programs the GLES2 backend draws effects with, with their uniforms.
+  ///
+  /// Linked once, when the first output is created, instead of in the middle of a frame.
+  struct Programs {
+    /// Needs a current context
+    Programs();
+
+    ProgramCache cache;
+
+    struct Shadow {
+      Shadow(ProgramCache& cache);
+      Shader shader;
+      Uniform<mat3> proj;
+      Uniform<vec4> color;
+      Uniform<float> aspect;
+      Uniform<float> radius;
+    } shadow;
+
+    /// Draws Framebuffers
+    struct Textured {
+      Textured(ProgramCache& cache);
+      Shader shader;
+      Uniform<mat3> proj;
+      Uniform<int> tex;
+      Uniform<float> alpha;
+    } textured;
+  };
+
+  /// Draws with the wlroots GLES2 renderer, scissoring every draw to the damage
+  struct GLES2Backend final : Backend {
+    GLES2Backend(Output& output, Programs& programs) noexcept;
+
+    auto begin() -> void override;
+    auto end(pixman_region32_t& damage) -> void override;
+
+    auto clear(pixman_region32_t& clip, std::array<float, 4> color) -> void override;
+    auto draw_rect(pixman_region32_t& clip,
+                   wlr::box_t box,
+                   float rotation,
+                   std::array<float, 4> color) -> void override;
+    auto draw_surface(pixman_region32_t& clip,
+                      wlr::surface_t& surface,
+                      const SurfaceTransform& transform,
+                      float alpha) -> void override;
+    auto draw_texture(pixman_region32_t& clip, const Texture& texture, wlr::box_t box, float alpha)
+      -> void override;
+    auto draw_shadow(pixman_region32_t& clip,
+                     wlr::box_t box,
+                     float rotation,
+                     float alpha,
+                     float radius) -> void override;
+    auto draw_framebuffer(pixman_region32_t& clip,
+                          const Framebuffer& fb,
+                          wlr::box_t box,
+                          float alpha) -> void override;
+
+    auto create_texture(wl::shm_format_t format,
+                        int stride,
+                        int width,
+                        int height,
+                        const void* data) -> std::unique_ptr<Texture> override;
+
+    auto has_framebuffers() const noexcept -> bool override
+    {
+      return true;
+    }
+
+  private:
+    Output& output;
+    wlr::renderer_t& renderer;
+    Programs& programs;
+  };
+
+} // namespace cloth::render
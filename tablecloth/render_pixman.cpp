@@ -0,0 +1,432 @@
+#include "render_pixman.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "util/algorithm.hpp"
+#include "util/logging.hpp"
+
+#include "output.hpp"
+
+#include "render_utils.hpp"
+
+namespace cloth::render {
+
+  /// Owns a copy of the pixels it was created from
+  struct PixmanTexture final : Texture {
+    PixmanTexture(pixman_image_t& image) noexcept : image(image) {}
+    ~PixmanTexture() noexcept
+    {
+      pixman_image_unref(&image);
+    }
+
+    pixman_image_t& image;
+  };
+
+  /// The pixman format of a wl_shm format, or 0 if there is none
+  static auto pixman_format(uint32_t format) -> pixman_format_code_t
+  {
+    switch (format) {
+    case WL_SHM_FORMAT_ARGB8888: return PIXMAN_a8r8g8b8;
+    case WL_SHM_FORMAT_XRGB8888: return PIXMAN_x8r8g8b8;
+    case WL_SHM_FORMAT_ABGR8888: return PIXMAN_a8b8g8r8;
+    case WL_SHM_FORMAT_XBGR8888: return PIXMAN_x8b8g8r8;
+    case WL_SHM_FORMAT_RGB565: return PIXMAN_r5g6b5;
+    default: return pixman_format_code_t(0);
+    }
+  }
+
+  /// Colors are taken as they are, like the GLES2 renderer does, which blends them as if they
+  /// were premultiplied
+  static auto to_pixman_color(std::array<float, 4> color) -> pixman_color_t
+  {
+    return {uint16_t(color[0] * 0xffff), uint16_t(color[1] * 0xffff),
+            uint16_t(color[2] * 0xffff), uint16_t(color[3] * 0xffff)};
+  }
+
+  /// Maps output pixels to the pixels of a width x height image stretched over box, which is
+  /// rotated around its center
+  static auto box_transform(wlr::box_t box, float rotation, int width, int height)
+    -> pixman_transform_t
+  {
+    pixman_f_transform ftransform;
+    pixman_f_transform_init_identity(&ftransform);
+    pixman_f_transform_translate(&ftransform, nullptr, -(box.x + box.width / 2.0),
+                                 -(box.y + box.height / 2.0));
+    if (rotation != 0) {
+      pixman_f_transform_rotate(&ftransform, nullptr, std::cos(rotation), -std::sin(rotation));
+    }
+    pixman_f_transform_scale(&ftransform, nullptr, width / double(box.width),
+                             height / double(box.height));
+    pixman_f_transform_translate(&ftransform, nullptr, width / 2.0, height / 2.0);
+
+    pixman_transform_t transform;
+    pixman_transform_from_pixman_f_transform(&transform, &ftransform);
+    return transform;
+  }
+
+  /// smoothstep(0, radius, d) as an alpha, where d is the distance from the nearest end of a
+  /// line of size pixels. The same as the GLES2 shadow shader
+  static auto shadow_ramp(int size, float radius) -> std::vector<uint8_t>
+  {
+    std::vector<uint8_t> ramp(size);
+    for (int i = 0; i < size; i++) {
+      float d = std::min(i + 0.5f, size - i - 0.5f);
+      float t = radius > 0 ? std::clamp(d / radius, 0.f, 1.f) : 1.f;
+      ramp[i] = uint8_t(t * t * (3 - 2 * t) * 255 + 0.5f);
+    }
+    return ramp;
+  }
+
+  //////////////////////////////////////////
+  // SurfaceImages
+  //////////////////////////////////////////
+
+  SurfaceImages::Image::~Image() noexcept
+  {
+    if (image) pixman_image_unref(image);
+  }
+
+  SurfaceImages::SurfaceImages(wlr::compositor_t& compositor) noexcept
+  {
+    on_new_surface.add_to(compositor.events.new_surface);
+    on_new_surface = [this](void* data) { handle_new_surface(*(wlr::surface_t*) data); };
+  }
+
+  auto SurfaceImages::get(wlr::surface_t& surface) -> pixman_image_t*
+  {
+    auto found = _images.find(&surface);
+    if (found == _images.end()) return nullptr;
+    return found->second->image;
+  }
+
+  auto SurfaceImages::handle_new_surface(wlr::surface_t& surface) -> void
+  {
+    auto& image = *_images.emplace(&surface, std::make_unique<Image>()).first->second;
+
+    image.on_commit.add_to(surface.events.commit);
+    image.on_commit = [this, &surface, &image] { update(surface, image); };
+
+    image.on_destroy.add_to(surface.events.destroy);
+    image.on_destroy = [this, &surface] { _images.erase(&surface); };
+  }
+
+  auto SurfaceImages::update(wlr::surface_t& surface, Image& image) -> void
+  {
+    auto drop = [&] {
+      if (image.image) pixman_image_unref(image.image);
+      image.image = nullptr;
+    };
+
+    if (!wlr_surface_has_buffer(&surface)) return drop();
+    if (!pixman_region32_not_empty(&surface.buffer_damage)) return;
+
+    // wlroots releases shm buffers as soon as it has uploaded them, but the client only hears
+    // of it after this dispatch, so the buffer still holds what was committed
+    wl::shm_buffer_t* shm = nullptr;
+    if (surface.buffer->resource) shm = wl_shm_buffer_get(surface.buffer->resource);
+    if (shm == nullptr) return drop();
+    auto format = pixman_format(wl_shm_buffer_get_format(shm));
+    if (format == 0) return drop();
+
+    int width = wl_shm_buffer_get_width(shm);
+    int height = wl_shm_buffer_get_height(shm);
+
+    pixman_region32_t damage;
+    pixman_region32_init(&damage);
+    pixman_region32_copy(&damage, &surface.buffer_damage);
+    if (image.image == nullptr || pixman_image_get_width(image.image) != width ||
+        pixman_image_get_height(image.image) != height ||
+        pixman_image_get_format(image.image) != format) {
+      drop();
+      image.image = pixman_image_create_bits_no_clear(format, width, height, nullptr, 0);
+      pixman_region32_union_rect(&damage, &damage, 0, 0, width, height);
+    }
+
+    wl_shm_buffer_begin_access(shm);
+    pixman_image_t* buffer =
+      pixman_image_create_bits_no_clear(format, width, height,
+                                        static_cast<uint32_t*>(wl_shm_buffer_get_data(shm)),
+                                        wl_shm_buffer_get_stride(shm));
+    pixman_image_set_clip_region32(image.image, &damage);
+    pixman_image_composite32(PIXMAN_OP_SRC, buffer, nullptr, image.image, 0, 0, 0, 0, 0, 0, width,
+                             height);
+    pixman_image_set_clip_region32(image.image, nullptr);
+    pixman_image_unref(buffer);
+    wl_shm_buffer_end_access(shm);
+
+    pixman_region32_fini(&damage);
+  }
+
+  //////////////////////////////////////////
+  // PixmanBackend
+  //////////////////////////////////////////
+
+  PixmanBackend::PixmanBackend(Output& output, SurfaceImages& surfaces) noexcept
+    : output(output),
+      renderer(*wlr_backend_get_renderer(output.wlr_output.backend)),
+      surfaces(surfaces)
+  {}
+
+  PixmanBackend::~PixmanBackend() noexcept
+  {
+    if (_frame) pixman_image_unref(_frame);
+    if (_texture) wlr_texture_destroy(_texture);
+    for (auto& mask : _shadow_masks) pixman_image_unref(mask.image);
+  }
+
+  auto PixmanBackend::begin() -> void
+  {
+    int width, height;
+    wlr_output_transformed_resolution(&output.wlr_output, &width, &height);
+    if (_frame && pixman_image_get_width(_frame) == width &&
+        pixman_image_get_height(_frame) == height) {
+      return;
+    }
+
+    // Outputs that change size are damaged whole, so all of the new frame is drawn
+    if (_frame) pixman_image_unref(_frame);
+    if (_texture) wlr_texture_destroy(_texture);
+    _texture = nullptr;
+    _frame = pixman_image_create_bits_no_clear(PIXMAN_a8r8g8b8, width, height, nullptr, 0);
+  }
+
+  auto PixmanBackend::end(pixman_region32_t& damage) -> void
+  {
+    int width = pixman_image_get_width(_frame);
+    int height = pixman_image_get_height(_frame);
+    int stride = pixman_image_get_stride(_frame);
+    auto* data = pixman_image_get_data(_frame);
+
+    pixman_region32_t upload;
+    pixman_region32_init_rect(&upload, 0, 0, width, height);
+    pixman_region32_intersect(&upload, &upload, &damage);
+    int nrects;
+    pixman_box32_t* rects = pixman_region32_rectangles(&upload, &nrects);
+
+    // Only the damage is uploaded, a full frame is only for new textures
+    if (_texture == nullptr) {
+      _texture =
+        wlr_texture_from_pixels(&renderer, WL_SHM_FORMAT_ARGB8888, stride, width, height, data);
+    } else {
+      for (int i = 0; i < nrects; ++i) {
+        auto& rect = rects[i];
+        wlr_texture_write_pixels(_texture, stride, rect.x2 - rect.x1, rect.y2 - rect.y1, rect.x1,
+                                 rect.y1, rect.x1, rect.y1, data);
+      }
+    }
+
+    if (_texture == nullptr) {
+      LOGE("Could not upload the frame of {}", output.wlr_output.name);
+    } else {
+      wlr_renderer_begin(&renderer, output.wlr_output.width, output.wlr_output.height);
+      wlr::box_t box = {.x = 0, .y = 0, .width = width, .height = height};
+      float matrix[9];
+      wlr_matrix_project_box(matrix, &box, WL_OUTPUT_TRANSFORM_NORMAL, 0,
+                             output.wlr_output.transform_matrix);
+      for (int i = 0; i < nrects; ++i) {
+        scissor_output(output, &rects[i]);
+        wlr_render_texture_with_matrix(&renderer, _texture, matrix, 1.f);
+      }
+      wlr_renderer_scissor(&renderer, nullptr);
+      wlr_renderer_end(&renderer);
+    }
+
+    pixman_region32_fini(&upload);
+  }
+
+  auto PixmanBackend::clear(pixman_region32_t& clip, std::array<float, 4> color) -> void
+  {
+    auto pixman_color = to_pixman_color(color);
+    int nrects;
+    pixman_box32_t* rects = pixman_region32_rectangles(&clip, &nrects);
+    pixman_image_fill_boxes(PIXMAN_OP_SRC, _frame, &pixman_color, nrects, rects);
+  }
+
+  auto PixmanBackend::draw_rect(pixman_region32_t& clip,
+                                wlr::box_t box,
+                                float rotation,
+                                std::array<float, 4> color) -> void
+  {
+    if (box.width <= 0 || box.height <= 0) return;
+
+    auto pixman_color = to_pixman_color(color);
+    pixman_image_t* solid = pixman_image_create_solid_fill(&pixman_color);
+    pixman_image_set_clip_region32(_frame, &clip);
+
+    if (rotation == 0) {
+      pixman_image_composite32(PIXMAN_OP_OVER, solid, nullptr, _frame, 0, 0, 0, 0, box.x, box.y,
+                               box.width, box.height);
+    } else {
+      // One opaque pixel stretched over the rotated box, as the mask
+      uint32_t opaque = 0xffffffff;
+      pixman_image_t* mask = pixman_image_create_bits(PIXMAN_a8, 1, 1, &opaque, 4);
+      auto transform = box_transform(box, rotation, 1, 1);
+      pixman_image_set_transform(mask, &transform);
+
+      auto* extents = pixman_region32_extents(&clip);
+      pixman_image_composite32(PIXMAN_OP_OVER, solid, mask, _frame, 0, 0, extents->x1,
+                               extents->y1, extents->x1, extents->y1, extents->x2 - extents->x1,
+                               extents->y2 - extents->y1);
+      pixman_image_unref(mask);
+    }
+
+    pixman_image_set_clip_region32(_frame, nullptr);
+    pixman_image_unref(solid);
+  }
+
+  auto PixmanBackend::composite(pixman_region32_t& clip,
+                                pixman_image_t& image,
+                                wlr::box_t box,
+                                float rotation,
+                                float alpha) -> void
+  {
+    if (box.width <= 0 || box.height <= 0) return;
+
+    int width = pixman_image_get_width(&image);
+    int height = pixman_image_get_height(&image);
+
+    pixman_image_t* mask = nullptr;
+    if (alpha < 1.f) {
+      pixman_color_t color = {0, 0, 0, uint16_t(std::max(alpha, 0.f) * 0xffff)};
+      mask = pixman_image_create_solid_fill(&color);
+    }
+
+    pixman_image_set_clip_region32(_frame, &clip);
+    auto* extents = pixman_region32_extents(&clip);
+    int x = extents->x1;
+    int y = extents->y1;
+    int w = extents->x2 - extents->x1;
+    int h = extents->y2 - extents->y1;
+
+    if (rotation == 0 && width == box.width && height == box.height) {
+      // Not sampled at all, which pixman does fastest
+      pixman_image_composite32(PIXMAN_OP_OVER, &image, mask, _frame, x - box.x, y - box.y, 0, 0, x,
+                               y, w, h);
+    } else {
+      auto transform = box_transform(box, rotation, width, height);
+      pixman_image_set_transform(&image, &transform);
+      pixman_image_set_filter(&image, PIXMAN_FILTER_BILINEAR, nullptr, 0);
+      pixman_image_composite32(PIXMAN_OP_OVER, &image, mask, _frame, x, y, 0, 0, x, y, w, h);
+      // Images are shared between outputs
+      pixman_image_set_transform(&image, nullptr);
+      pixman_image_set_filter(&image, PIXMAN_FILTER_NEAREST, nullptr, 0);
+    }
+
+    pixman_image_set_clip_region32(_frame, nullptr);
+    if (mask) pixman_image_unref(mask);
+  }
+
+  auto PixmanBackend::draw_surface(pixman_region32_t& clip,
+                                   wlr::surface_t& surface,
+                                   const SurfaceTransform& transform,
+                                   float alpha) -> void
+  {
+    auto* image = surfaces.get(surface);
+    if (image == nullptr) return;
+    composite(clip, *image, transform.box, transform.rotation, alpha);
+  }
+
+  auto PixmanBackend::draw_texture(pixman_region32_t& clip,
+                                   const Texture& texture,
+                                   wlr::box_t box,
+                                   float alpha) -> void
+  {
+    composite(clip, static_cast<const PixmanTexture&>(texture).image, box, 0, alpha);
+  }
+
+  auto PixmanBackend::draw_shadow(pixman_region32_t& clip,
+                                  wlr::box_t box,
+                                  float rotation,
+                                  float alpha,
+                                  float radius) -> void
+  {
+    if (box.width <= 0 || box.height <= 0) return;
+
+    auto& mask = shadow_mask(box.width, box.height, radius);
+    pixman_color_t color = {0, 0, 0, uint16_t(std::clamp(alpha, 0.f, 1.f) * 0xffff)};
+    pixman_image_t* solid = pixman_image_create_solid_fill(&color);
+
+    pixman_image_set_clip_region32(_frame, &clip);
+    auto* extents = pixman_region32_extents(&clip);
+    int x = extents->x1;
+    int y = extents->y1;
+    int w = extents->x2 - extents->x1;
+    int h = extents->y2 - extents->y1;
+
+    if (rotation == 0) {
+      pixman_image_composite32(PIXMAN_OP_OVER, solid, &mask, _frame, 0, 0, x - box.x, y - box.y, x,
+                               y, w, h);
+    } else {
+      auto transform = box_transform(box, rotation, box.width, box.height);
+      pixman_image_set_transform(&mask, &transform);
+      pixman_image_set_filter(&mask, PIXMAN_FILTER_BILINEAR, nullptr, 0);
+      pixman_image_composite32(PIXMAN_OP_OVER, solid, &mask, _frame, 0, 0, x, y, x, y, w, h);
+      pixman_image_set_transform(&mask, nullptr);
+      pixman_image_set_filter(&mask, PIXMAN_FILTER_NEAREST, nullptr, 0);
+    }
+
+    pixman_image_set_clip_region32(_frame, nullptr);
+    pixman_image_unref(solid);
+  }
+
+  auto PixmanBackend::shadow_mask(int width, int height, float radius) -> pixman_image_t&
+  {
+    auto found = util::find_if(_shadow_masks, [&](ShadowMask& mask) {
+      return mask.width == width && mask.height == height && mask.radius == radius;
+    });
+    if (found != _shadow_masks.end()) {
+      std::rotate(found, found + 1, _shadow_masks.end());
+      return *_shadow_masks.back().image;
+    }
+    if (int(_shadow_masks.size()) >= max_shadow_masks) {
+      pixman_image_unref(_shadow_masks.front().image);
+      _shadow_masks.erase(_shadow_masks.begin());
+    }
+
+    // The shadow is a ramp along x times a ramp along y
+    auto xs = shadow_ramp(width, radius);
+    auto ys = shadow_ramp(height, radius);
+    pixman_image_t* image = pixman_image_create_bits_no_clear(PIXMAN_a8, width, height, nullptr, 0);
+    auto* bits = reinterpret_cast<uint8_t*>(pixman_image_get_data(image));
+    int stride = pixman_image_get_stride(image);
+    for (int y = 0; y < height; y++) {
+      uint8_t* row = bits + y * stride;
+      uint16_t a = ys[y];
+      if (a == 255) {
+        std::memcpy(row, xs.data(), width);
+        continue;
+      }
+      // Simple enough for the compiler to vectorize
+      for (int x = 0; x < width; x++) row[x] = (xs[x] * a + 255) >> 8;
+    }
+
+    _shadow_masks.push_back({width, height, radius, image});
+    return *image;
+  }
+
+  auto PixmanBackend::create_texture(wl::shm_format_t format,
+                                     int stride,
+                                     int width,
+                                     int height,
+                                     const void* data) -> std::unique_ptr<Texture>
+  {
+    auto pixman_fmt = pixman_format(format);
+    if (pixman_fmt == 0) return nullptr;
+
+    pixman_image_t* image = pixman_image_create_bits_no_clear(pixman_fmt, width, height, nullptr, 0);
+    if (image == nullptr) return nullptr;
+    pixman_image_t* pixels =
+      pixman_image_create_bits_no_clear(pixman_fmt, width, height,
+                                        static_cast<uint32_t*>(const_cast<void*>(data)), stride);
+    pixman_image_composite32(PIXMAN_OP_SRC, pixels, nullptr, image, 0, 0, 0, 0, 0, 0, width, height);
+    pixman_image_unref(pixels);
+
+    auto res = std::make_unique<PixmanTexture>(*image);
+    res->width = width;
+    res->height = height;
+    return res;
+  }
+
+} // namespace cloth::render
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "render_backend.hpp"
+
+namespace cloth::render {
+
+  /// CPU copies of what client surfaces show, for the pixman backend.
+  ///
+  /// Copied from wl_shm buffers on commit, only where the commit damaged them. Buffers that only
+  /// live on a GPU, like dmabufs, have no copy and aren't drawn.
+  struct SurfaceImages {
+    SurfaceImages(wlr::compositor_t& compositor) noexcept;
+
+    SurfaceImages(const SurfaceImages&) = delete;
+    SurfaceImages& operator=(const SurfaceImages&) = delete;
+
+    /// The copy of a surface's buffer, or null if it has none
+    auto get(wlr::surface_t& surface) -> pixman_image_t*;
+
+  private:
+    struct Image {
+      pixman_image_t* image = nullptr;
+      wl::Listener on_commit;
+      wl::Listener on_destroy;
+
+      ~Image() noexcept;
+    };
+
+    auto handle_new_surface(wlr::surface_t& surface) -> void;
+    auto update(wlr::surface_t& surface, Image& image) -> void;
+
+    std::unordered_map<wlr::surface_t*, std::unique_ptr<Image>> _images;
+    wl::Listener on_new_surface;
+  };
+
+  /// Composites on the CPU with pixman, which picks SIMD fast paths for the CPU it runs on.
+  ///
+  /// Frames are drawn into an image in memory, of which only the damage is redrawn. wlroots can
+  /// only present EGL surfaces, so the damage is then uploaded and copied to the output, which
+  /// Mesa's software EGL does on machines without a GPU. Buffer transforms of client surfaces
+  /// aren't applied.
+  struct PixmanBackend final : Backend {
+    PixmanBackend(Output& output, SurfaceImages& surfaces) noexcept;
+    ~PixmanBackend() noexcept;
+
+    auto begin() -> void override;
+    auto end(pixman_region32_t& damage) -> void override;
+
+    auto clear(pixman_region32_t& clip, std::array<float, 4> color) -> void override;
+    auto draw_rect(pixman_region32_t& clip,
+                   wlr::box_t box,
+                   float rotation,
+                   std::array<float, 4> color) -> void override;
+    auto draw_surface(pixman_region32_t& clip,
+                      wlr::surface_t& surface,
+                      const SurfaceTransform& transform,
+                      float alpha) -> void override;
+    auto draw_texture(pixman_region32_t& clip, const Texture& texture, wlr::box_t box, float alpha)
+      -> void override;
+    auto draw_shadow(pixman_region32_t& clip,
+                     wlr::box_t box,
+                     float rotation,
+                     float alpha,
+                     float radius) -> void override;
+
+    auto create_texture(wl::shm_format_t format,
+                        int stride,
+                        int width,
+                        int height,
+                        const void* data) -> std::unique_ptr<Texture> override;
+
+  private:
+    /// Shadow masks kept, for the sizes of the last few shadows drawn
+    static constexpr int max_shadow_masks = 8;
+
+    struct ShadowMask {
+      int width;
+      int height;
+      float radius;
+      pixman_image_t* image;
+    };
+
+    /// Draw an image stretched over box, clipped to clip
+    auto composite(pixman_region32_t& clip,
+                   pixman_image_t& image,
+                   wlr::box_t box,
+                   float rotation,
+                   float alpha) -> void;
+    /// The alpha of a shadow of the given size, from the cache or drawn now
+    auto shadow_mask(int width, int height, float radius) -> pixman_image_t&;
+
+    Output& output;
+    wlr::renderer_t& renderer;
+    SurfaceImages& surfaces;
+
+    /// The frame, in output-local scaled coordinates. Kept between frames
+    pixman_image_t* _frame = nullptr;
+    /// The frame as shown on the output
+    wlr::texture_t* _texture = nullptr;
+    /// Least recently used first
+    std::vector<ShadowMask> _shadow_masks;
+  };
+
+} // namespace cloth::render
@@ -1,10 +1,128 @@
 #include "render_utils.hpp"
 
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+#include "util/logging.hpp"
+
 #include <GLES2/gl2.h>
+#include <GLES2/gl2ext.h>
 
 namespace cloth::render {
 
-  Shader::Shader(const std::string& vertex_shader, const std::string& frag_shader)
+  namespace fs = std::filesystem;
+
+  /// FNV-1a, which unlike std::hash is the same on every run
+  static auto fnv1a(std::string_view data) -> uint64_t
+  {
+    uint64_t hash = 0xcbf29ce484222325;
+    for (unsigned char c : data) {
+      hash ^= c;
+      hash *= 0x100000001b3;
+    }
+    return hash;
+  }
+
+  static auto gl_string(GLenum name) -> std::string
+  {
+    auto* str = reinterpret_cast<const char*>(glGetString(name));
+    return str ? str : "";
+  }
+
+  ProgramCache::ProgramCache()
+  {
+    auto extensions = gl_string(GL_EXTENSIONS);
+    if (extensions.find("GL_OES_get_program_binary") == std::string::npos) return;
+    GLint formats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS_OES, &formats);
+    if (formats == 0) return;
+
+    std::string dir;
+    if (auto* cache_home = getenv("XDG_CACHE_HOME"); cache_home && *cache_home) {
+      dir = cache_home;
+    } else if (auto* home = getenv("HOME"); home) {
+      dir = fmt::format("{}/.cache", home);
+    } else {
+      return;
+    }
+    dir += "/tablecloth/programs";
+    std::error_code ec;
+    fs::create_directories(dir, ec);
+    if (ec) {
+      LOGE("Could not create {}: {}", dir, ec.message());
+      return;
+    }
+
+    _dir = std::move(dir);
+    _driver = fmt::format("{}\n{}\n{}", gl_string(GL_VENDOR), gl_string(GL_RENDERER),
+                          gl_string(GL_VERSION));
+    _get_program_binary = reinterpret_cast<void*>(eglGetProcAddress("glGetProgramBinaryOES"));
+    _program_binary = reinterpret_cast<void*>(eglGetProcAddress("glProgramBinaryOES"));
+  }
+
+  auto ProgramCache::path(std::string_view key) const -> std::string
+  {
+    return fmt::format("{}/{:016x}.bin", _dir, fnv1a(_driver + '\0' + std::string(key)));
+  }
+
+  auto ProgramCache::load(unsigned program, std::string_view key) -> bool
+  {
+    if (_program_binary == nullptr) return false;
+
+    std::ifstream file(path(key), std::ios::binary);
+    GLenum format;
+    if (!file.read(reinterpret_cast<char*>(&format), sizeof(format))) return false;
+    std::vector<char> binary(std::istreambuf_iterator<char>(file), {});
+    if (binary.empty()) return false;
+
+    auto program_binary = reinterpret_cast<PFNGLPROGRAMBINARYOESPROC>(_program_binary);
+    program_binary(program, format, binary.data(), binary.size());
+    // Drivers reject binaries of other versions, and the program is compiled from source
+    GLint linked = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &linked);
+    return linked == GL_TRUE;
+  }
+
+  auto ProgramCache::save(unsigned program, std::string_view key) -> void
+  {
+    if (_get_program_binary == nullptr) return;
+
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH_OES, &length);
+    if (length <= 0) return;
+    std::vector<char> binary(length);
+    GLenum format;
+    auto get_program_binary = reinterpret_cast<PFNGLGETPROGRAMBINARYOESPROC>(_get_program_binary);
+    get_program_binary(program, length, &length, &format, binary.data());
+
+    // Written next to it and renamed, so an interrupted write never leaves half a binary
+    auto file_path = path(key);
+    auto tmp_path = file_path + ".tmp";
+    {
+      std::ofstream file(tmp_path, std::ios::binary | std::ios::trunc);
+      file.write(reinterpret_cast<const char*>(&format), sizeof(format));
+      file.write(binary.data(), length);
+      if (!file) {
+        LOGE("Could not write {}", tmp_path);
+        return;
+      }
+    }
+    std::error_code ec;
+    fs::rename(tmp_path, file_path, ec);
+  }
+
+  Shader::Shader(ProgramCache& cache, const std::string& vertex_shader, const std::string& frag_shader)
+  {
+    ID = glCreateProgram();
+    auto key = vertex_shader + '\0' + frag_shader;
+    if (cache.load(ID, key)) return;
+
+    compile(vertex_shader, frag_shader);
+    cache.save(ID, key);
+  }
+
+  auto Shader::compile(const std::string& vertex_shader, const std::string& frag_shader) -> void
   {
     const char* vcode = vertex_shader.c_str();
     const char* fcode = frag_shader.c_str();
@@ -21,55 +139,74 @@ namespace cloth::render {
     glCompileShader(fragment);
     check_compilation(fragment, "FRAGMENT");
 
-    ID = glCreateProgram();
     glAttachShader(ID, vertex);
     glAttachShader(ID, fragment);
     glLinkProgram(ID);
     check_compilation(ID, "PROGRAM");
 
+    glDetachShader(ID, vertex);
+    glDetachShader(ID, fragment);
     glDeleteShader(vertex);
     glDeleteShader(fragment);
   }
 
-  void Shader::use()
+  void Shader::use() const
   {
-    glGetIntegerv(GL_CURRENT_PROGRAM, (GLint*) &prevID);
     glUseProgram(ID);
   }
 
-  void Shader::restore()
-  {
-    glUseProgram(prevID);
-  }
-
-  void Shader::set(const std::string& name, bool value) const
+  auto Shader::uniform_location(const char* name) const -> int
   {
-    glUniform1i(glGetUniformLocation(ID, name.c_str()), (int) value);
+    int location = glGetUniformLocation(ID, name);
+    if (location < 0) LOGE("Shader {} has no uniform {}", ID, name);
+    return location;
   }
 
-  void Shader::set(const std::string& name, int value) const
+  void Shader::set(Uniform<int> uniform, int value) const
   {
-    glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+    glUniform1i(uniform.location, value);
   }
 
-  void Shader::set(const std::string& name, float value) const
+  void Shader::set(Uniform<float> uniform, float value) const
   {
-    glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
+    glUniform1f(uniform.location, value);
   }
 
-  void Shader::set(const std::string& name, float v1, float v2) const
+  void Shader::set(Uniform<vec4> uniform, const vec4& value) const
   {
-    glUniform2f(glGetUniformLocation(ID, name.c_str()), v1, v2);
+    glUniform4fv(uniform.location, 1, value.data());
   }
 
-  void Shader::set(const std::string& name, float v1, float v2, float v3) const
+  void Shader::set(Uniform<mat3> uniform, const mat3& value) const
   {
-    glUniform3f(glGetUniformLocation(ID, name.c_str()), v1, v2, v3);
+    glUniformMatrix3fv(uniform.location, 1, GL_FALSE, value.data());
   }
 
-  void Shader::set(const std::string& name, float v1, float v2, float v3, float v4) const
+  void draw_quad()
   {
-    glUniform4f(glGetUniformLocation(ID, name.c_str()), v1, v2, v3, v4);
+    GLfloat verts[] = {
+      1, 0, // top right
+      0, 0, // top left
+      1, 1, // bottom right
+      0, 1, // bottom left
+    };
+    GLfloat texcoord[] = {
+      1, 0, // top right
+      0, 0, // top left
+      1, 1, // bottom right
+      0, 1, // bottom left
+    };
+
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, verts);
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 0, texcoord);
+
+    glEnableVertexAttribArray(0);
+    glEnableVertexAttribArray(1);
+
+    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+
+    glDisableVertexAttribArray(0);
+    glDisableVertexAttribArray(1);
   }
 
   void Shader::check_compilation(unsigned int shader, std::string type)
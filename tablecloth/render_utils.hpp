@@ -1,5 +1,6 @@
 #pragma once
 
+#include <array>
 #include <string>
 #include <string_view>
 
@@ -8,29 +9,71 @@
 
 namespace cloth::render {
 
+  using vec4 = std::array<float, 4>;
+  /// Column major, like GLES2 takes them. Transpose wlr matrices first
+  using mat3 = std::array<float, 9>;
+
+  /// A uniform of a Shader, looked up once when the shader is built
+  template<typename T>
+  struct Uniform {
+    int location = -1;
+  };
+
+  /// Linked programs on disk, so they aren't compiled again on every start.
+  ///
+  /// Binaries are keyed by the GL driver and the shader sources. Without
+  /// GL_OES_get_program_binary, or without a cache directory, nothing is cached.
+  struct ProgramCache {
+    /// Needs a current context
+    ProgramCache();
+
+    /// Load the binary for key into program. Returns false if there is none that links
+    auto load(unsigned program, std::string_view key) -> bool;
+    /// Store the binary of a linked program
+    auto save(unsigned program, std::string_view key) -> void;
+
+  private:
+    auto path(std::string_view key) const -> std::string;
+
+    /// Vendor, renderer and version of the driver
+    std::string _driver;
+    std::string _dir;
+    void* _get_program_binary = nullptr;
+    void* _program_binary = nullptr;
+  };
+
+  /// A linked program. Programs live as long as the GL context, so they are never deleted
   struct Shader {
     /// the program ID
     unsigned int ID;
 
-    Shader(const std::string& vertex_shader, const std::string& frag_shader);
+    /// Link the program, from the binary in the cache if there is one. Needs a current context
+    Shader(ProgramCache& cache, const std::string& vertex_shader, const std::string& frag_shader);
 
-    /// use/activate the shader
-    void use();
-    void restore();
+    /// use/activate the shader. wlroots uses its own programs for everything it draws, so nothing
+    /// has to be restored
+    void use() const;
 
-    void set(const std::string& name, bool value) const;
-    void set(const std::string& name, int value) const;
-    void set(const std::string& name, float value) const;
-    void set(const std::string& name, float v1, float v2) const;
-    void set(const std::string& name, float v1, float v2, float v3) const;
-    void set(const std::string& name, float v1, float v2, float v3, float v4) const;
+    template<typename T>
+    auto uniform(const char* name) const -> Uniform<T>
+    {
+      return {uniform_location(name)};
+    }
+
+    void set(Uniform<int> uniform, int value) const;
+    void set(Uniform<float> uniform, float value) const;
+    void set(Uniform<vec4> uniform, const vec4& value) const;
+    void set(Uniform<mat3> uniform, const mat3& value) const;
 
   private:
+    auto uniform_location(const char* name) const -> int;
+    auto compile(const std::string& vertex_shader, const std::string& frag_shader) -> void;
     void check_compilation(unsigned int shader, std::string type);
-
-    unsigned int prevID;
   };
 
+  /// Draw the unit square, with positions in attribute 0 and texture coordinates in attribute 1
+  void draw_quad();
+
   /**
    * Rotate a child's position relative to a parent. The parent size is (pw, ph),
    * the child position is (*sx, *sy) and its size is (sw, sh).
@@ -68,4 +111,11 @@ namespace cloth::render {
 
   auto scissor_output(Output& output, pixman_box32_t* rect) -> void;
 
+  /// The largest box with the aspect ratio of width x height that fits centered in area.
+  /// Never scales up.
+  auto fit_box(wlr::box_t area, int width, int height) -> wlr::box_t;
+
+  /// Convert a box in layout coordinates to output-local, scaled coordinates
+  auto output_box_from_layout(Output& output, wlr::box_t box) -> wlr::box_t;
+
 } // namespace cloth::render
@@ -50,6 +50,8 @@ namespace cloth {
 
     on_destroy = [this] { util::erase_this(this->input.seats, *this); };
     on_destroy.add_to(wlr_seat->events.destroy);
+
+    input.server.desktop.power.add_seat(*this);
   }
 
   Seat::~Seat()
@@ -174,8 +176,8 @@ namespace cloth {
     on_map = handle_damage_whole;
     on_map.add_to(wlr_drag_icon.events.map);
     on_destroy = [this] {
-      auto keep_alive = util::erase_this(this->seat.drag_icons, this);
-      keep_alive->damage_whole();
+      damage_whole();
+      util::erase_this(this->seat.drag_icons, this);
     };
     on_destroy.add_to(wlr_drag_icon.events.destroy);
 
@@ -396,6 +398,8 @@ namespace cloth {
 
   SeatView::~SeatView() noexcept
   {
+    seat.view_handles.erase(&view);
+
     if (&view == seat.get_focus()) {
       seat._focused_view = nullptr;
       seat.has_focus = false;
@@ -407,9 +411,8 @@ namespace cloth {
     }
 
     // Focus first view
-    auto views = seat.input.server.desktop.visible_views();
-    if (!views.empty()) {
-      seat.set_focus(&views.back());
+    if (auto* focus = seat.input.server.desktop.current_workspace().focused_view(); focus) {
+      seat.set_focus(focus);
     }
   }
 
@@ -483,16 +486,16 @@ namespace cloth {
   SeatView& Seat::add_view(View& view)
   {
     auto& seat_view = views.emplace_back(*this, view);
+    view_handles[&view] = views.handle_of(seat_view);
     return seat_view;
   }
 
   SeatView& Seat::seat_view_from_view(View& view)
   {
-    auto found = util::find_if(views, [&](auto& sv) { return &sv.view == &view; });
-    if (found == views.end()) {
-      return add_view(view);
+    if (auto found = view_handles.find(&view); found != view_handles.end()) {
+      if (auto* seat_view = views.get(found->second); seat_view) return *seat_view;
     }
-    return *found;
+    return add_view(view);
   }
 
   bool Seat::allow_input(wl::resource_t& resource)
@@ -521,7 +524,7 @@ namespace cloth {
 
     // Deactivate the old view if it is not focused by some other seat
     if (prev_focus != nullptr && !input.view_has_focus(*prev_focus)) {
-      if (auto* xwl = dynamic_cast<XwaylandSurface*>(view);
+      if (auto* xwl = view_cast<XwaylandSurface>(view);
           xwl && xwl->xwayland_surface->override_redirect) {
         // NOTE:
         // This may not be the correct thing to do, but popup menus in chrome instantly disappear if
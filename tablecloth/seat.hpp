@@ -1,6 +1,9 @@
 #pragma once
 
+#include <unordered_map>
+
 #include "util/ptr_vec.hpp"
+#include "util/slab.hpp"
 
 #include "cursor.hpp"
 #include "keyboard.hpp"
@@ -73,22 +76,67 @@ namespace cloth {
     wl::Listener on_tablet_destroy;
   };
 
-  /// Not a separate device, just added on the tablet proximity event.
+  /// Not a separate device, created on the first proximity event of a tool. Owned by the seat
+  /// until the tool is destroyed.
   struct TabletTool {
-    TabletTool(Seat& seat, wlr::tablet_v2_tablet_tool_t&) noexcept;
-
-    Seat& seat;
+    /// Longest a hit test is reused for, so views raised or mapped under the tool are noticed
+    static constexpr uint32_t hit_lifetime_msec = 100;
 
+    /// Creates the tablet_v2 tool for the tool
+    TabletTool(Seat& seat, wlr::tablet_tool_t& tool) noexcept;
     ~TabletTool() noexcept;
 
+    /// Merge an axis event into the pending state, and send it once the event loop is idle.
+    void queue_axes(Tablet& tablet, wlr::event_tablet_tool_axis_t& event);
+    /// Send pending axes right away, before events that have to come after them
+    void flush_axes();
+    /// Forget the surface the last hit test found
+    void invalidate_hit();
+
+    Seat& seat;
+
+    /// Declared before tablet_v2_tool, so it is added to the tool's destroy signal before
+    /// wlroots adds the listener that frees tablet_v2_tool
+    wl::Listener on_tool_destroy;
     wlr::tablet_v2_tablet_tool_t& tablet_v2_tool;
-    Tablet* current_tablet;
+    /// The tablet the pending axes came from
+    Tablet* current_tablet = nullptr;
+
+    /// Axes updated since the last flush. Relative motion and wheel deltas add up, the other
+    /// axes keep their latest value.
+    struct Axes {
+      uint32_t updated = 0;
+      double x = 0, y = 0;
+      double dx = 0, dy = 0;
+      double pressure = 0;
+      double distance = 0;
+      double tilt_x = 0, tilt_y = 0;
+      double rotation = 0;
+      double slider = 0;
+      double wheel_delta = 0;
+      uint32_t time_msec = 0;
+    } pending;
+
+    /// The last full hit test. Reused while the tool stays within the surface and the view
+    /// hasn't moved.
+    struct Hit {
+      View* view = nullptr;
+      wlr::surface_t* surface = nullptr;
+      /// Layout coordinates of the surface origin
+      double lx = 0, ly = 0;
+      double view_x = 0, view_y = 0;
+      uint32_t time_msec = 0;
+    } hit;
 
     wl::Listener on_set_cursor;
-    wl::Listener on_tool_destroy;
     wl::Listener on_tablet_destroy;
+    wl::Listener on_hit_view_unmap;
+    wl::Listener on_hit_surface_destroy;
 
     bool in_fallback_mode = false;
+
+  private:
+    wl::event_source_t* _flush_idle = nullptr;
   };
 
   struct SeatView {
@@ -145,11 +193,14 @@ namespace cloth {
     // If non-null, only this client can receive input events
     wl::client_t* exclusive_client = nullptr;
 
-    util::ptr_vec<SeatView> views;
+    /// Declared before views, the SeatView destructor erases itself from it
+    std::unordered_map<const View*, util::handle<SeatView>> view_handles;
+    util::slab_vec<SeatView> views;
 
     bool has_focus;
 
-    util::ptr_vec<DragIcon> drag_icons;
+    util::slab_vec<DragIcon, 4> drag_icons;
+    util::slab_vec<TabletTool, 4> tablet_tools;
 
     util::ptr_vec<Keyboard> keyboards;
     util::ptr_vec<Pointer> pointers;
@@ -18,7 +18,12 @@ namespace cloth {
       data_device_manager(wlr_data_device_manager_create(wl_display)),
       config(argc, argv), desktop(*this, config), input(*this, config),
       workspace_manager(*this),
-      window_manager(*this)
+      window_manager(*this),
+      foreign_toplevel_manager(*this),
+      output_power_manager(*this),
+      output_manager(*this),
+      config_watcher(*this),
+      client_accounting(*this)
   {
     assert(wl_display && wl_event_loop);
 
@@ -32,6 +37,13 @@ namespace cloth {
 
   Server::~Server() noexcept
   {
+    // GL objects can only be freed while the backend's context is still around
+    if (auto* egl = backend ? wlr_backend_get_egl(backend) : nullptr; egl) {
+      if (wlr_egl_make_current(egl, EGL_NO_SURFACE, nullptr)) {
+        desktop.thumbnails.clear();
+        desktop.animations.clear();
+      }
+    }
     if (wl_display) {
       wl_display_destroy_clients(wl_display);
       wl_display_destroy(wl_display);
@@ -8,9 +8,14 @@
 #include <wayland-server.h>
 #include "wlroots.hpp"
 
+#include "client_accounting.hpp"
 #include "config.hpp"
+#include "config_watcher.hpp"
 #include "desktop.hpp"
 #include "input.hpp"
+#include "protocol/foreign_toplevel.hpp"
+#include "protocol/output_manager.hpp"
+#include "protocol/output_power_manager.hpp"
 #include "protocol/workspace_manager.hpp"
 #include "protocol/window_manager.hpp"
 
@@ -33,6 +38,11 @@ namespace cloth {
 
     WorkspaceManager workspace_manager;
     WindowManager window_manager;
+    ForeignToplevelManager foreign_toplevel_manager;
+    OutputPowerManager output_power_manager;
+    OutputManager output_manager;
+    ConfigWatcher config_watcher;
+    ClientAccounting client_accounting;
 
     Server(int argc, char* argv[]) noexcept;
   };
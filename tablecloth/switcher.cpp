@@ -0,0 +1,231 @@
+#include "switcher.hpp"
+
+#include <algorithm>
+
+#include <cairo.h>
+#include <pango/pangocairo.h>
+
+#include "util/algorithm.hpp"
+#include "util/iterators.hpp"
+
+#include "desktop.hpp"
+#include "output.hpp"
+#include "render.hpp"
+#include "render_utils.hpp"
+#include "view.hpp"
+#include "workspace.hpp"
+
+namespace cloth {
+
+  static constexpr int item_width = 240;
+  static constexpr int preview_height = 160;
+  static constexpr int title_height = 24;
+  static constexpr int padding = 16;
+
+  /// Render a line of text, centered and ellipsized to width
+  static auto render_title(render::Backend& backend,
+                           const std::string& text,
+                           int width,
+                           int height) -> std::unique_ptr<render::Texture>
+  {
+    cairo_surface_t* surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, width, height);
+    cairo_t* cr = cairo_create(surface);
+
+    PangoLayout* layout = pango_cairo_create_layout(cr);
+    PangoFontDescription* font = pango_font_description_from_string("Sans");
+    pango_font_description_set_absolute_size(font, height * 0.6 * PANGO_SCALE);
+    pango_layout_set_font_description(layout, font);
+    pango_font_description_free(font);
+    pango_layout_set_text(layout, text.c_str(), -1);
+    pango_layout_set_width(layout, width * PANGO_SCALE);
+    pango_layout_set_ellipsize(layout, PANGO_ELLIPSIZE_END);
+    pango_layout_set_alignment(layout, PANGO_ALIGN_CENTER);
+
+    int text_height;
+    pango_layout_get_pixel_size(layout, nullptr, &text_height);
+    cairo_set_source_rgba(cr, 1, 1, 1, 1);
+    cairo_move_to(cr, 0, (height - text_height) / 2.0);
+    pango_cairo_show_layout(cr, layout);
+    g_object_unref(layout);
+    cairo_destroy(cr);
+
+    // Cairo's ARGB32 is premultiplied and native endian, same as wl_shm's ARGB8888
+    cairo_surface_flush(surface);
+    auto texture =
+      backend.create_texture(WL_SHM_FORMAT_ARGB8888, cairo_image_surface_get_stride(surface),
+                             width, height, cairo_image_surface_get_data(surface));
+    cairo_surface_destroy(surface);
+    return texture;
+  }
+
+  Switcher::Switcher(Desktop& desktop) noexcept : desktop(desktop) {}
+
+  Switcher::~Switcher() noexcept = default;
+
+  auto Switcher::next() -> void
+  {
+    if (is_active())
+      select(1);
+    else
+      open(1);
+  }
+
+  auto Switcher::prev() -> void
+  {
+    if (is_active())
+      select(-1);
+    else
+      open(-1);
+  }
+
+  auto Switcher::open(int offset) -> void
+  {
+    if (desktop.outputs.empty()) return;
+    auto& workspace = desktop.current_workspace();
+    // Most recently focused first
+    for (auto& view : util::view::reverse(workspace.visible_views())) {
+      _items.push_back({&view});
+    }
+    if (_items.empty()) return;
+
+    _output = &desktop.focused_output();
+    _selected = 0;
+    arrange();
+    select(offset);
+  }
+
+  auto Switcher::select(int offset) -> void
+  {
+    int size = _items.size();
+    _selected = ((int(_selected) + offset) % size + size) % size;
+    damage();
+  }
+
+  auto Switcher::commit() -> void
+  {
+    if (!is_active()) return;
+    View* view = _items.at(_selected).view;
+    close();
+    view->workspace->set_focused_view(view);
+  }
+
+  auto Switcher::cancel() -> void
+  {
+    close();
+  }
+
+  auto Switcher::close() -> void
+  {
+    if (!is_active()) return;
+    damage();
+    _items.clear();
+    _output = nullptr;
+    commit_on_release = false;
+  }
+
+  auto Switcher::select_at(double lx, double ly) -> bool
+  {
+    if (!is_active()) return false;
+    auto item = util::find_if(_items, [&](Item& item) {
+      return wlr_box_contains_point(&item.box, lx, ly);
+    });
+    if (item == _items.end()) {
+      cancel();
+    } else {
+      _selected = item - _items.begin();
+      commit();
+    }
+    return true;
+  }
+
+  auto Switcher::forget(View& view) -> void
+  {
+    auto item = util::find_if(_items, [&](Item& item) { return item.view == &view; });
+    if (item == _items.end()) return;
+
+    damage();
+    std::size_t index = item - _items.begin();
+    _items.erase(item);
+    if (_items.empty()) {
+      _output = nullptr;
+      return;
+    }
+    if (_selected > index || _selected == _items.size()) {
+      _selected = (_selected + _items.size() - 1) % _items.size();
+    }
+    arrange();
+    damage();
+  }
+
+  auto Switcher::damage_view(View& view) -> void
+  {
+    if (!is_active()) return;
+    for (auto& item : _items) {
+      if (item.view == &view) _output->context.damage_box(item.preview_box);
+    }
+  }
+
+  auto Switcher::damage() -> void
+  {
+    if (is_active()) _output->context.damage_box(_box);
+  }
+
+  auto Switcher::arrange() -> void
+  {
+    auto area = _output->usable_layout_box();
+    int n = _items.size();
+    int width = std::clamp((area.width - padding * (n + 1)) / n, padding, item_width);
+    int height = width * preview_height / item_width + title_height;
+
+    _box.width = width * n + padding * (n + 1);
+    _box.height = height + padding * 2;
+    _box.x = area.x + (area.width - _box.width) / 2;
+    _box.y = area.y + (area.height - _box.height) / 2;
+
+    int x = _box.x + padding;
+    for (auto& item : _items) {
+      item.box = {.x = x, .y = _box.y + padding, .width = width, .height = height};
+      item.preview_box = item.box;
+      item.preview_box.height -= title_height;
+      item.title_box = item.box;
+      item.title_box.y += item.preview_box.height;
+      item.title_box.height = title_height;
+      x += width + padding;
+    }
+  }
+
+  auto Switcher::render(render::Context& context) -> void
+  {
+    float scale = context.output.wlr_output.scale;
+
+    context.draw_rect(_box, {0.f, 0.f, 0.f, 0.7f});
+    for (std::size_t i = 0; i < _items.size(); i++) {
+      auto& item = _items[i];
+      if (i == _selected) {
+        auto highlight = item.box;
+        highlight.x -= padding / 2;
+        highlight.y -= padding / 2;
+        highlight.width += padding;
+        highlight.height += padding;
+        context.draw_rect(highlight, {0.3f, 0.3f, 0.3f, 0.6f});
+      }
+
+      auto& view = *item.view;
+      context.draw_thumbnail(view, render::fit_box(item.preview_box, view.width, view.height),
+                             1.f);
+
+      // Titles are only rasterized again when they change
+      auto title = view.get_name();
+      if (item.title_texture == nullptr || title != item.title) {
+        item.title = std::move(title);
+        item.title_texture = render_title(*context.backend, item.title,
+                                          item.title_box.width * scale,
+                                          item.title_box.height * scale);
+      }
+      if (item.title_texture) context.draw_texture(*item.title_texture, item.title_box, 1.f);
+    }
+
+    if (desktop.thumbnails.has_pending()) wlr_output_schedule_frame(&context.output.wlr_output);
+  }
+
+} // namespace cloth
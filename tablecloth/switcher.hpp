@@ -0,0 +1,94 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "render_backend.hpp"
+#include "wlroots.hpp"
+
+namespace cloth {
+
+  struct Desktop;
+  struct Output;
+  struct View;
+
+  namespace render {
+    struct Context;
+  }
+
+  /// Alt-Tab style window switcher, showing previews of the views of the current workspace.
+  ///
+  /// Moving the selection only redraws the switcher. Focus, and with it restacking and
+  /// activating the client, only changes once the switcher is committed.
+  struct Switcher {
+    Switcher(Desktop& desktop) noexcept;
+    ~Switcher() noexcept;
+
+    Switcher(const Switcher&) = delete;
+    Switcher& operator=(const Switcher&) = delete;
+
+    auto is_active() const noexcept -> bool
+    {
+      return _output != nullptr;
+    }
+
+    /// Open the switcher on the next view, or move the selection forwards
+    auto next() -> void;
+    /// Open the switcher on the last view, or move the selection backwards
+    auto prev() -> void;
+    /// Close the switcher, focusing the selected view
+    auto commit() -> void;
+    /// Close the switcher, leaving focus as it was
+    auto cancel() -> void;
+
+    /// Commit the view at the given layout coordinates, or cancel if there is none.
+    /// Returns false if the switcher isn't open.
+    auto select_at(double lx, double ly) -> bool;
+
+    /// Is the switcher drawn on this output
+    auto covers(Output& output) const noexcept -> bool
+    {
+      return _output == &output;
+    }
+
+    /// Drop a view that was unmapped or destroyed
+    auto forget(View& view) -> void;
+
+    /// Damage the preview of a view
+    auto damage_view(View& view) -> void;
+
+    /// Draw the switcher on top of everything else
+    auto render(render::Context& context) -> void;
+
+    /// Opened by a binding with modifiers held, so releasing them commits.
+    /// Set by the keyboard, reset on close
+    bool commit_on_release = false;
+
+  private:
+    struct Item {
+      View* view;
+      wlr::box_t box;
+      wlr::box_t preview_box;
+      wlr::box_t title_box;
+      /// The title title_texture was rendered from
+      std::string title;
+      std::unique_ptr<render::Texture> title_texture;
+    };
+
+    auto open(int offset) -> void;
+    auto select(int offset) -> void;
+    auto close() -> void;
+    auto arrange() -> void;
+    auto damage() -> void;
+
+    Desktop& desktop;
+    /// The output the switcher is shown on, nullptr while closed
+    Output* _output = nullptr;
+    std::vector<Item> _items;
+    std::size_t _selected = 0;
+    /// The background panel, in layout coordinates
+    wlr::box_t _box = {};
+  };
+
+} // namespace cloth
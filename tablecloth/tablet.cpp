@@ -13,8 +13,14 @@
 
 namespace cloth {
 
-  TabletTool::TabletTool(Seat& seat, wlr::tablet_v2_tablet_tool_t& tool) noexcept
-    : seat(seat), tablet_v2_tool(tool)
+  TabletTool::TabletTool(Seat& seat, wlr::tablet_tool_t& tool) noexcept
+    : seat(seat),
+      on_tool_destroy([this] { util::erase_this(this->seat.tablet_tools, this); }),
+      tablet_v2_tool([&]() -> wlr::tablet_v2_tablet_tool_t& {
+        // Runs before wlroots frees tablet_v2_tool, so on_set_cursor can still be unlinked
+        on_tool_destroy.add_to(tool.events.destroy);
+        return *wlr_tablet_tool_create(seat.input.server.desktop.tablet_v2, seat.wlr_seat, &tool);
+      }())
   {
     LOGD("Create tablet tool");
     tablet_v2_tool.wlr_tool->data = this;
@@ -32,11 +38,62 @@ namespace cloth {
       this->seat.cursor.on_request_set_cursor((void*) &event);
     };
 
-    on_tool_destroy.add_to(tablet_v2_tool.wlr_tool->events.destroy);
-    on_tool_destroy = [] {  };
+    on_hit_view_unmap = [this] { invalidate_hit(); };
+    on_hit_surface_destroy = [this] { invalidate_hit(); };
   }
 
-  TabletTool::~TabletTool() noexcept {}
+  TabletTool::~TabletTool() noexcept
+  {
+    if (_flush_idle) wl_event_source_remove(_flush_idle);
+  }
+
+  void TabletTool::queue_axes(Tablet& tablet, wlr::event_tablet_tool_axis_t& event)
+  {
+    if (current_tablet != &tablet) flush_axes();
+    current_tablet = &tablet;
+
+    auto axes = event.updated_axes;
+    pending.updated |= axes;
+    pending.time_msec = event.time_msec;
+    if (axes & WLR_TABLET_TOOL_AXIS_X) pending.x = event.x;
+    if (axes & WLR_TABLET_TOOL_AXIS_Y) pending.y = event.y;
+    pending.dx += event.dx;
+    pending.dy += event.dy;
+    if (axes & WLR_TABLET_TOOL_AXIS_PRESSURE) pending.pressure = event.pressure;
+    if (axes & WLR_TABLET_TOOL_AXIS_DISTANCE) pending.distance = event.distance;
+    if (axes & WLR_TABLET_TOOL_AXIS_TILT_X) pending.tilt_x = event.tilt_x;
+    if (axes & WLR_TABLET_TOOL_AXIS_TILT_Y) pending.tilt_y = event.tilt_y;
+    if (axes & WLR_TABLET_TOOL_AXIS_ROTATION) pending.rotation = event.rotation;
+    if (axes & WLR_TABLET_TOOL_AXIS_SLIDER) pending.slider = event.slider;
+    if (axes & WLR_TABLET_TOOL_AXIS_WHEEL) pending.wheel_delta += event.wheel_delta;
+
+    if (_flush_idle) return;
+    // Everything libinput had queued is dispatched before the loop goes idle
+    _flush_idle = wl_event_loop_add_idle(seat.input.server.wl_event_loop,
+                                         [](void* data) {
+                                           auto& self = *(TabletTool*) data;
+                                           self._flush_idle = nullptr;
+                                           self.flush_axes();
+                                         },
+                                         this);
+  }
+
+  void TabletTool::flush_axes()
+  {
+    if (_flush_idle) {
+      wl_event_source_remove(_flush_idle);
+      _flush_idle = nullptr;
+    }
+    if (pending.updated == 0 || current_tablet == nullptr) return;
+    seat.cursor.send_tool_axes(*this);
+  }
+
+  void TabletTool::invalidate_hit()
+  {
+    hit = {};
+    on_hit_view_unmap.remove();
+    on_hit_surface_destroy.remove();
+  }
 
   // TABLET PAD //
 
@@ -147,6 +204,11 @@ namespace cloth {
 
   Tablet::~Tablet() noexcept
   {
+    for (auto& tool : seat.tablet_tools) {
+      if (tool.current_tablet != this) continue;
+      tool.pending = {};
+      tool.current_tablet = nullptr;
+    }
     wlr_cursor_detach_input_device(seat.cursor.wlr_cursor, &wlr_device);
     seat.update_capabilities();
   }
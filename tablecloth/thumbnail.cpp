@@ -0,0 +1,268 @@
+#include "thumbnail.hpp"
+
+#include <algorithm>
+#include <array>
+
+#include "util/logging.hpp"
+
+#include "desktop.hpp"
+#include "output.hpp"
+#include "server.hpp"
+#include "view.hpp"
+
+#include "render.hpp"
+#include "render_utils.hpp"
+
+#include <GLES2/gl2.h>
+
+namespace cloth::render {
+
+  /// The smallest power of two fitting size, at most ThumbnailCache::max_size
+  static int texture_size(double size)
+  {
+    int res = 1;
+    while (res < size && res < ThumbnailCache::max_size) res *= 2;
+    return res;
+  }
+
+  auto Framebuffer::resize(int width, int height) -> bool
+  {
+    if (texture == 0) {
+      glGenTextures(1, &texture);
+      glGenFramebuffers(1, &framebuffer);
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    if (this->width != width || this->height != height) {
+      glBindTexture(GL_TEXTURE_2D, texture);
+      glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE,
+                   nullptr);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
+                      mipmapped ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+      glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, 0);
+      glBindTexture(GL_TEXTURE_2D, 0);
+      this->width = width;
+      this->height = height;
+    }
+
+    return glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+  }
+
+  auto Framebuffer::destroy() noexcept -> void
+  {
+    if (texture) glDeleteTextures(1, &texture);
+    if (framebuffer) glDeleteFramebuffers(1, &framebuffer);
+    texture = framebuffer = 0;
+    width = height = 0;
+  }
+
+  struct ViewSurfaceData {
+    wlr::renderer_t& renderer;
+    /// Maps the target's pixels to clip space
+    std::array<float, 9> projection;
+    double x_scale;
+    double y_scale;
+  };
+
+  static void render_view_surface(wlr::surface_t* surface, int sx, int sy, void* _data)
+  {
+    auto& data = *(ViewSurfaceData*) _data;
+
+    wlr::texture_t* texture = wlr_surface_get_texture(surface);
+    if (texture == nullptr) return;
+
+    wlr::box_t box = {.x = int(sx * data.x_scale),
+                      .y = int(sy * data.y_scale),
+                      .width = int(surface->current.width * data.x_scale),
+                      .height = int(surface->current.height * data.y_scale)};
+
+    float matrix[9];
+    auto transform = wlr_output_transform_invert(surface->current.transform);
+    wlr_matrix_project_box(matrix, &box, transform, 0, data.projection.data());
+    wlr_render_texture_with_matrix(&data.renderer, texture, matrix, 1.f);
+  }
+
+  auto render_view(wlr::renderer_t& renderer, View& view, Framebuffer& target) -> bool
+  {
+    if (view.width == 0 || view.height == 0 || target.width == 0 || target.height == 0)
+      return false;
+
+    glBindFramebuffer(GL_FRAMEBUFFER, target.framebuffer);
+    std::array<float, 4> transparent = {0.f, 0.f, 0.f, 0.f};
+    wlr_renderer_begin(&renderer, target.width, target.height);
+    wlr_renderer_scissor(&renderer, nullptr);
+    wlr_renderer_clear(&renderer, transparent.data());
+    ViewSurfaceData data = {renderer, {}, target.width / double(view.width),
+                            target.height / double(view.height)};
+    wlr_matrix_projection(data.projection.data(), target.width, target.height,
+                          WL_OUTPUT_TRANSFORM_NORMAL);
+    view.for_each_surface(render_view_surface, &data);
+    wlr_renderer_end(&renderer);
+
+    if (target.mipmapped) {
+      glBindTexture(GL_TEXTURE_2D, target.texture);
+      glGenerateMipmap(GL_TEXTURE_2D);
+      glBindTexture(GL_TEXTURE_2D, 0);
+    }
+    return true;
+  }
+
+  ThumbnailCache::ThumbnailCache(Desktop& desktop) noexcept : desktop(desktop) {}
+
+  ThumbnailCache::~ThumbnailCache() noexcept
+  {
+    if (_timer) wl_event_source_remove(_timer);
+  }
+
+  auto ThumbnailCache::get(View& view, int width, int height) -> Thumbnail*
+  {
+    if (view.width == 0 || view.height == 0 || width <= 0 || height <= 0) return nullptr;
+
+    double scale = std::min({width / double(view.width), height / double(view.height), 1.0});
+    auto& thumb = _thumbnails[&view];
+    thumb.wanted_width = texture_size(view.width * scale);
+    thumb.wanted_height = texture_size(view.height * scale);
+
+    bool stale = !thumb.valid || thumb.commit_count != view.commit_count ||
+                 thumb.fb.width != thumb.wanted_width || thumb.fb.height != thumb.wanted_height;
+    if (stale && !thumb.queued) {
+      thumb.queued = true;
+      _queue.push_back(&view);
+    }
+    return thumb.valid ? &thumb : nullptr;
+  }
+
+  auto ThumbnailCache::has_pending() const noexcept -> bool
+  {
+    auto now = chrono::clock::now();
+    return std::any_of(_queue.begin(), _queue.end(), [&](View* view) {
+      auto& thumb = _thumbnails.at(view);
+      return !thumb.valid || now - thumb.rendered_at >= min_interval;
+    });
+  }
+
+  auto ThumbnailCache::forget(View& view) noexcept -> void
+  {
+    auto iter = _thumbnails.find(&view);
+    if (iter == _thumbnails.end()) return;
+    _dead.push_back(iter->second.fb);
+    _thumbnails.erase(iter);
+    _queue.erase(std::remove(_queue.begin(), _queue.end(), &view), _queue.end());
+  }
+
+  auto ThumbnailCache::clear() noexcept -> void
+  {
+    for (auto& [view, thumb] : _thumbnails) _dead.push_back(thumb.fb);
+    _thumbnails.clear();
+    _queue.clear();
+    collect_garbage();
+  }
+
+  auto ThumbnailCache::collect_garbage() noexcept -> void
+  {
+    for (auto& fb : _dead) fb.destroy();
+    _dead.clear();
+  }
+
+  auto ThumbnailCache::update(wlr::renderer_t& renderer) -> std::vector<View*>
+  {
+    collect_garbage();
+
+    std::vector<View*> updated;
+    if (_queue.empty()) return updated;
+
+    GLint prev_framebuffer;
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &prev_framebuffer);
+
+    auto now = chrono::clock::now();
+    // Rendered too recently, these stay queued
+    std::vector<View*> waiting;
+    chrono::time_point due = chrono::time_point::max();
+    auto iter = _queue.begin();
+    for (; iter != _queue.end() && int(updated.size()) < budget; ++iter) {
+      View& view = **iter;
+      auto& thumb = _thumbnails.at(&view);
+      if (thumb.valid && now - thumb.rendered_at < min_interval) {
+        waiting.push_back(&view);
+        due = std::min(due, thumb.rendered_at + min_interval);
+        continue;
+      }
+      thumb.queued = false;
+      if (!view.mapped || view.wlr_surface == nullptr) continue;
+      render(renderer, view, thumb);
+      thumb.rendered_at = now;
+      updated.push_back(&view);
+    }
+    _queue.erase(_queue.begin(), iter);
+    _queue.insert(_queue.end(), waiting.begin(), waiting.end());
+    if (!waiting.empty()) schedule_timer(due);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, prev_framebuffer);
+    return updated;
+  }
+
+  auto ThumbnailCache::schedule_timer(chrono::time_point at) -> void
+  {
+    if (!_timer) {
+      _timer = wl_event_loop_add_timer(desktop.server.wl_event_loop,
+                                       [](void* data) {
+                                         auto& desktop = ((ThumbnailCache*) data)->desktop;
+                                         for (auto& output : desktop.outputs) {
+                                           wlr_output_schedule_frame(&output.wlr_output);
+                                         }
+                                         return 0;
+                                       },
+                                       this);
+    }
+    auto ms = chrono::ceil<chrono::milliseconds>(at - chrono::clock::now()).count();
+    wl_event_source_timer_update(_timer, std::max<int>(ms, 1));
+  }
+
+  auto ThumbnailCache::render(wlr::renderer_t& renderer, View& view, Thumbnail& thumb) -> void
+  {
+    if (!thumb.fb.resize(thumb.wanted_width, thumb.wanted_height)) {
+      LOGE("Thumbnail framebuffer for {} is incomplete", view.get_name());
+      thumb.valid = false;
+      return;
+    }
+    thumb.valid = render_view(renderer, view, thumb.fb);
+    thumb.commit_count = view.commit_count;
+  }
+
+  auto Context::draw_thumbnail(View& view, wlr::box_t box, float alpha) -> void
+  {
+    if (!backend->has_framebuffers()) {
+      // Without framebuffers to cache them in, thumbnails are the views, scaled down
+      RenderData data = {.layout = {.x = (double) box.x,
+                                    .y = (double) box.y,
+                                    .width = (double) box.width,
+                                    .height = (double) box.height},
+                         .alpha = alpha};
+      for_each_surface(view, render_surface, data);
+      return;
+    }
+
+    float scale = output.wlr_output.scale;
+    auto* thumb = output.desktop.thumbnails.get(view, box.width * scale, box.height * scale);
+    if (thumb == nullptr) {
+      // Not rendered yet, show a placeholder until the budget gets to it
+      draw_rect(box, {0.f, 0.f, 0.f, 0.3f * alpha});
+      return;
+    }
+
+    draw_framebuffer(thumb->fb, box, alpha);
+  }
+
+  auto Context::draw_framebuffer(const Framebuffer& fb, wlr::box_t box, float alpha) -> void
+  {
+    box = output_box_from_layout(output, box);
+
+    pixman_region32_t damage;
+    if (clip(box, 0, damage)) backend->draw_framebuffer(damage, fb, box, alpha);
+    pixman_region32_fini(&damage);
+  }
+
+} // namespace cloth::render
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <unordered_map>
+#include <vector>
+
+#include "util/chrono.hpp"
+
+#include "wlroots.hpp"
+
+namespace cloth {
+
+  struct Desktop;
+  struct View;
+
+  namespace render {
+
+    /// A texture with a framebuffer to render into it.
+    ///
+    /// Owns GL objects, which can only be created and deleted while the renderer's context is
+    /// current, so they are freed explicitly with destroy() instead of in a destructor.
+    struct Framebuffer {
+      unsigned texture = 0;
+      unsigned framebuffer = 0;
+      int width = 0;
+      int height = 0;
+      /// Generate mipmaps after rendering. Needs power of two sizes
+      bool mipmapped = false;
+
+      /// Allocate the texture at the given size, if it isn't already.
+      /// Leaves the framebuffer bound. Returns false if it can't be rendered to
+      auto resize(int width, int height) -> bool;
+      auto destroy() noexcept -> void;
+    };
+
+    /// Render the surfaces of a view into a framebuffer, stretched to fill it.
+    /// Leaves the framebuffer bound.
+    auto render_view(wlr::renderer_t& renderer, View& view, Framebuffer& target) -> bool;
+
+    /// A downscaled copy of a view, rendered into a mipmapped texture
+    struct Thumbnail {
+      /// Sizes are always powers of two, so the texture can be mipmapped
+      Framebuffer fb = {.mipmapped = true};
+      /// Texture size asked for by the last get(), applied on the next render
+      int wanted_width = 0;
+      int wanted_height = 0;
+      /// View::commit_count when the texture was last rendered
+      unsigned commit_count = 0;
+      chrono::time_point rendered_at;
+      /// Has the texture been rendered at all
+      bool valid = false;
+      /// Waiting in the render queue
+      bool queued = false;
+    };
+
+    /// Thumbnails of views, re-rendered only after the view commits.
+    ///
+    /// Rendering is budgeted: requesting a stale thumbnail returns the old texture and queues the
+    /// view, and each frame renders only a few queued views. Views that commit every frame are
+    /// capped to min_interval, and a timer brings the next frame once they are due.
+    struct ThumbnailCache {
+      /// Longest side of a thumbnail texture
+      static constexpr int max_size = 512;
+      /// Thumbnails rendered per output frame
+      static constexpr int budget = 4;
+      /// A thumbnail is re-rendered at most this often, however fast its view commits
+      static constexpr chrono::duration min_interval = chrono::milliseconds(50);
+
+      ThumbnailCache(Desktop& desktop) noexcept;
+      ThumbnailCache(const ThumbnailCache&) = delete;
+      ThumbnailCache& operator=(const ThumbnailCache&) = delete;
+      ~ThumbnailCache() noexcept;
+
+      /// The thumbnail of a view, to be drawn at most width x height large.
+      /// Returns nullptr if it hasn't been rendered yet. Missing or stale thumbnails are queued.
+      auto get(View& view, int width, int height) -> Thumbnail*;
+
+      /// Render up to `budget` queued thumbnails. Needs the renderer's context to be current.
+      /// Returns the views whose thumbnails changed
+      auto update(wlr::renderer_t& renderer) -> std::vector<View*>;
+
+      /// Are there queued thumbnails that the next frame may render.
+      /// Thumbnails held back by min_interval don't count, the timer takes care of those
+      auto has_pending() const noexcept -> bool;
+
+      /// Drop the thumbnail of a view that is going away
+      auto forget(View& view) noexcept -> void;
+
+      /// Free all thumbnails. Needs the renderer's context to be current, so the server does
+      /// this before destroying the backend.
+      auto clear() noexcept -> void;
+
+    private:
+      auto render(wlr::renderer_t& renderer, View& view, Thumbnail& thumb) -> void;
+      /// Free GL objects of forgotten thumbnails. They can only be deleted while the
+      /// context is current.
+      auto collect_garbage() noexcept -> void;
+      /// Schedule frames on all outputs once the first held back thumbnail is due
+      auto schedule_timer(chrono::time_point at) -> void;
+
+      Desktop& desktop;
+      wl_event_source* _timer = nullptr;
+      std::unordered_map<View*, Thumbnail> _thumbnails;
+      std::vector<View*> _queue;
+      std::vector<Framebuffer> _dead;
+    };
+
+  } // namespace render
+} // namespace cloth
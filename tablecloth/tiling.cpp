@@ -0,0 +1,409 @@
+#include "tiling.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#include "util/algorithm.hpp"
+#include "util/exception.hpp"
+#include "util/logging.hpp"
+
+#include "desktop.hpp"
+#include "output.hpp"
+#include "transaction.hpp"
+#include "view.hpp"
+#include "workspace.hpp"
+
+namespace cloth::tiling {
+
+  auto is_horizontal(Layout layout) noexcept -> bool
+  {
+    return layout == Layout::split_h || layout == Layout::tabbed;
+  }
+
+  auto parse_layout(std::string_view str) -> Layout
+  {
+    if (str == "splith" || str == "h") return Layout::split_h;
+    if (str == "splitv" || str == "v") return Layout::split_v;
+    if (str == "tabbed") return Layout::tabbed;
+    if (str == "stacking" || str == "stacked") return Layout::stacked;
+    throw util::exception("Invalid layout. Expected splith, splitv, tabbed or stacking. Got {}",
+                          str);
+  }
+
+  auto parse_direction(std::string_view str) -> Direction
+  {
+    if (str == "left") return Direction::left;
+    if (str == "right") return Direction::right;
+    if (str == "up") return Direction::up;
+    if (str == "down") return Direction::down;
+    throw util::exception("Invalid direction. Expected left, right, up or down. Got {}", str);
+  }
+
+  // Container //
+
+  Container::Container(Container* parent, Layout layout) noexcept : parent(parent), layout(layout)
+  {}
+
+  Container::Container(Container* parent, View& view) noexcept : parent(parent), view(&view) {}
+
+  auto Container::is_leaf() const noexcept -> bool
+  {
+    return view != nullptr;
+  }
+
+  auto Container::mark_dirty() noexcept -> void
+  {
+    dirty = true;
+    for (auto* p = parent; p != nullptr && !p->child_dirty; p = p->parent) {
+      p->child_dirty = true;
+    }
+  }
+
+  auto Container::index() const noexcept -> std::size_t
+  {
+    assert(parent != nullptr);
+    auto& siblings = parent->children.underlying();
+    auto iter = util::find_if(siblings, [this](auto& uptr) { return uptr.get() == this; });
+    return iter - siblings.begin();
+  }
+
+  // Tree //
+
+  Tree::Tree(Workspace& workspace) noexcept
+    : workspace(workspace), _root(std::make_unique<Container>(nullptr, Layout::split_h))
+  {}
+
+  auto Tree::enabled() const noexcept -> bool
+  {
+    return _enabled;
+  }
+
+  auto Tree::set_enabled(bool enabled) -> void
+  {
+    if (_enabled == enabled) return;
+    _enabled = enabled;
+    if (enabled) {
+      // Laid out once, below
+      for (auto& view : workspace.visible_views()) {
+        attach_view(view);
+      }
+    } else {
+      auto forget = [](Container& con, auto& self) -> void {
+        if (con.view) con.view->tile = nullptr;
+        for (auto& child : con.children) self(child, self);
+      };
+      forget(*_root, forget);
+      _root = std::make_unique<Container>(nullptr, Layout::split_h);
+    }
+    arrange();
+  }
+
+  auto Tree::insert(View& view) -> bool
+  {
+    if (!attach_view(view)) return false;
+    arrange();
+    raise_tabs(view);
+    return true;
+  }
+
+  auto Tree::attach_view(View& view) -> bool
+  {
+    if (!_enabled || view.floating) return false;
+    if (view.tile != nullptr) return true;
+
+    // Open the new tile next to the most recently focused one
+    Container* target = nullptr;
+    for (auto& v : util::view::reverse(workspace.visible_views())) {
+      if (&v != &view && v.tile) {
+        target = v.tile;
+        break;
+      }
+    }
+
+    Container& parent = target ? *target->parent : *_root;
+    std::size_t index = target ? target->index() + 1 : parent.children.size();
+    view.tile = &attach(std::make_unique<Container>(&parent, view), parent, index);
+    return true;
+  }
+
+  auto Tree::remove(View& view) -> void
+  {
+    if (view.tile == nullptr) return;
+    auto& parent = *view.tile->parent;
+    detach(*view.tile);
+    view.tile = nullptr;
+    collapse(parent);
+    arrange();
+  }
+
+  auto Tree::set_layout(View& view, Layout layout) -> void
+  {
+    if (view.tile == nullptr) return;
+    auto& parent = *view.tile->parent;
+    parent.layout = layout;
+    parent.mark_dirty();
+    arrange();
+    raise_tabs(view);
+  }
+
+  auto Tree::split(View& view, Layout layout) -> void
+  {
+    auto* leaf = view.tile;
+    if (leaf == nullptr) return;
+    auto& parent = *leaf->parent;
+    if (parent.children.size() == 1) {
+      set_layout(view, layout);
+      return;
+    }
+    auto index = leaf->index();
+    float weight = leaf->weight;
+    auto owned = detach(*leaf);
+    owned->weight = 1.f;
+    auto& con = attach(std::make_unique<Container>(&parent, layout), parent, index);
+    con.weight = weight;
+    attach(std::move(owned), con, 0);
+    arrange();
+    raise_tabs(view);
+  }
+
+  auto Tree::resize(View& view, float delta) -> void
+  {
+    if (view.tile == nullptr) return;
+    auto& leaf = *view.tile;
+    leaf.weight = std::clamp(leaf.weight + delta, 0.1f, 10.f);
+    leaf.parent->mark_dirty();
+    arrange();
+  }
+
+  auto Tree::neighbour(View& view, Direction dir) -> View*
+  {
+    bool horizontal = dir == Direction::left || dir == Direction::right;
+    bool forward = dir == Direction::right || dir == Direction::down;
+    for (auto* cur = view.tile; cur != nullptr && cur->parent != nullptr; cur = cur->parent) {
+      auto& parent = *cur->parent;
+      if (is_horizontal(parent.layout) != horizontal) continue;
+      auto index = cur->index();
+      if (forward ? index + 1 >= parent.children.size() : index == 0) continue;
+
+      auto* next = &parent.children[forward ? index + 1 : index - 1];
+      while (!next->is_leaf()) {
+        if (next->children.empty()) return nullptr;
+        next = forward ? &next->children.front() : &next->children.back();
+      }
+      return next->view;
+    }
+    return nullptr;
+  }
+
+  auto Tree::move(View& view, Direction dir) -> void
+  {
+    auto* leaf = view.tile;
+    if (leaf == nullptr) return;
+    bool horizontal = dir == Direction::left || dir == Direction::right;
+    bool forward = dir == Direction::right || dir == Direction::down;
+    for (auto* cur = leaf; cur->parent != nullptr; cur = cur->parent) {
+      auto& parent = *cur->parent;
+      if (is_horizontal(parent.layout) != horizontal) continue;
+      auto index = cur->index();
+      if (cur == leaf) {
+        // At the edge of this container, try the next one up
+        if (forward ? index + 1 >= parent.children.size() : index == 0) continue;
+        auto& siblings = parent.children.underlying();
+        std::swap(siblings[index], siblings[forward ? index + 1 : index - 1]);
+        parent.mark_dirty();
+      } else {
+        // Move out of the nested container, next to it in the given direction
+        auto& old_parent = *leaf->parent;
+        auto owned = detach(*leaf);
+        owned->weight = 1.f;
+        attach(std::move(owned), parent, forward ? index + 1 : index);
+        collapse(old_parent);
+      }
+      arrange();
+      raise_tabs(view);
+      return;
+    }
+  }
+
+  auto Tree::arrange() -> void
+  {
+    if (!_enabled) return;
+    // Workspaces that aren't visible are laid out when they are shown
+    auto box = output_box();
+    if (!box) return;
+    TransactionScope scope(workspace.desktop);
+    layout(*_root, *box, scope.transaction);
+  }
+
+  auto Tree::raise_tabs(View& view) -> void
+  {
+    if (view.tile == nullptr) return;
+    auto is_in = [](View& view, Container& c) {
+      for (auto* p = view.tile; p != nullptr; p = p->parent) {
+        if (p == &c) return true;
+      }
+      return false;
+    };
+
+    View* focused = workspace.focused_view();
+    // Innermost first, so each tab keeps its own focused tab on top when the outer one is raised
+    for (auto* tab = view.tile; tab->parent != nullptr; tab = tab->parent) {
+      // A single view is already on top of the other tabs
+      if (tab->parent->layout != Layout::tabbed || tab->is_leaf()) continue;
+      util::ref_vec<View> views;
+      for (auto& v : workspace.visible_views()) {
+        if (is_in(v, *tab)) views.push_back(v);
+      }
+      // In stacking order, so the views of the tab stay stacked as they were
+      for (auto& v : views) workspace.raise(v);
+    }
+    // The focused view goes back on top, so focus doesn't change
+    if (focused != nullptr && focused != workspace.focused_view()) workspace.raise(*focused);
+  }
+
+  auto Tree::layout(Container& con, wlr::box_t box, Transaction& transaction) -> void
+  {
+    bool moved = box != con.box;
+    if (!moved && !con.dirty && !con.child_dirty) return;
+    bool relayout = moved || con.dirty;
+    con.box = box;
+    con.dirty = con.child_dirty = false;
+
+    if (con.is_leaf()) {
+      configure(con, transaction);
+      return;
+    }
+
+    if (!relayout) {
+      // Only some descendants changed, keep the boxes of our children
+      for (auto& child : con.children) {
+        layout(child, child.box, transaction);
+      }
+      return;
+    }
+
+    int n = con.children.size();
+    if (n == 0) return;
+
+    switch (con.layout) {
+      case Layout::split_h:
+      case Layout::split_v: {
+        bool horizontal = con.layout == Layout::split_h;
+        float total = util::accumulate(con.children, 0.f,
+                                       [](float sum, Container& c) { return sum + c.weight; });
+        float acc = 0.f;
+        int start = horizontal ? box.x : box.y;
+        for (auto& child : con.children) {
+          acc += child.weight;
+          auto child_box = box;
+          if (horizontal) {
+            int end = box.x + std::lround(box.width * acc / total);
+            child_box.x = start;
+            child_box.width = end - start;
+            start = end;
+          } else {
+            int end = box.y + std::lround(box.height * acc / total);
+            child_box.y = start;
+            child_box.height = end - start;
+            start = end;
+          }
+          layout(child, child_box, transaction);
+        }
+        break;
+      }
+      case Layout::tabbed:
+        // All tabs share the box, raise_tabs keeps the focused one on top
+        for (auto& child : con.children) {
+          layout(child, box, transaction);
+        }
+        break;
+      case Layout::stacked: {
+        // Cascade the children, so every one of them stays grabbable
+        int offset = std::min(stack_offset, std::min(box.width, box.height) / (2 * n));
+        int i = 0;
+        for (auto& child : con.children) {
+          wlr::box_t child_box = {.x = box.x + i * offset,
+                                  .y = box.y + i * offset,
+                                  .width = box.width - (n - 1) * offset,
+                                  .height = box.height - (n - 1) * offset};
+          layout(child, child_box, transaction);
+          i++;
+        }
+        break;
+      }
+    }
+  }
+
+  auto Tree::configure(Container& leaf, Transaction& transaction) -> void
+  {
+    View& view = *leaf.view;
+    if (view.fullscreen_output != nullptr || view.maximized) return;
+
+    int border = view.deco.is_visible() ? view.deco.border_width() : 0;
+    int titlebar = view.deco.is_visible() ? view.deco.titlebar_height() : 0;
+    int inset = gap + border;
+
+    auto box = leaf.box;
+    box.x += inset;
+    box.y += inset + titlebar;
+    box.width = std::max(1, box.width - 2 * inset);
+    box.height = std::max(1, box.height - 2 * inset - titlebar);
+    transaction.add(view, box);
+  }
+
+  auto Tree::output_box() -> std::optional<wlr::box_t>
+  {
+    auto& outputs = workspace.desktop.outputs;
+    auto iter = util::find_if(outputs, [this](Output& o) { return o.workspace == &workspace; });
+    if (iter == outputs.end()) return std::nullopt;
+    auto& output = *iter;
+    auto* layout_box = wlr_output_layout_get_box(workspace.desktop.layout, &output.wlr_output);
+    if (layout_box == nullptr) return std::nullopt;
+    auto box = output.usable_area;
+    box.x += layout_box->x;
+    box.y += layout_box->y;
+    return box;
+  }
+
+  auto Tree::detach(Container& con) -> std::unique_ptr<Container>
+  {
+    auto& parent = *con.parent;
+    auto& siblings = parent.children.underlying();
+    auto iter = siblings.begin() + con.index();
+    auto owned = std::move(*iter);
+    siblings.erase(iter);
+    parent.mark_dirty();
+    owned->parent = nullptr;
+    return owned;
+  }
+
+  auto Tree::attach(std::unique_ptr<Container>&& con, Container& parent, std::size_t index)
+    -> Container&
+  {
+    auto& res = *con;
+    con->parent = &parent;
+    auto& siblings = parent.children.underlying();
+    siblings.insert(siblings.begin() + std::min(index, siblings.size()), std::move(con));
+    parent.mark_dirty();
+    res.mark_dirty();
+    return res;
+  }
+
+  auto Tree::collapse(Container& con) -> void
+  {
+    if (&con == _root.get() || con.is_leaf()) return;
+    auto& parent = *con.parent;
+    if (con.children.empty()) {
+      detach(con);
+      collapse(parent);
+    } else if (con.children.size() == 1) {
+      auto index = con.index();
+      auto only = detach(con.children.front());
+      only->weight = con.weight;
+      // Keep con alive until we are done with it
+      auto keep_alive = detach(con);
+      attach(std::move(only), parent, index);
+    }
+  }
+
+} // namespace cloth::tiling
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <optional>
+#include <string_view>
+
+#include "util/ptr_vec.hpp"
+
+#include "wlroots.hpp"
+
+namespace cloth {
+
+  struct Transaction;
+  struct View;
+  struct Workspace;
+
+  namespace tiling {
+
+    enum struct Layout {
+      split_h,
+      split_v,
+      tabbed,
+      stacked,
+    };
+
+    enum struct Direction {
+      left,
+      right,
+      up,
+      down,
+    };
+
+    /// A node in the layout tree. Leaves hold exactly one view, inner nodes arrange their
+    /// children according to their layout.
+    struct Container {
+      Container(Container* parent, Layout layout) noexcept;
+      Container(Container* parent, View& view) noexcept;
+
+      auto is_leaf() const noexcept -> bool;
+      /// Mark this container as needing relayout, and let its ancestors know
+      auto mark_dirty() noexcept -> void;
+      auto index() const noexcept -> std::size_t;
+
+      Container* parent;
+      Layout layout = Layout::split_h;
+      util::ptr_vec<Container> children;
+      View* view = nullptr;
+
+      /// Share of the parent's size, relative to the siblings
+      float weight = 1.f;
+      /// The box assigned in the last layout pass
+      wlr::box_t box = {0, 0, 0, 0};
+
+      /// This container's children need to be laid out again
+      bool dirty = true;
+      /// Some descendant is dirty
+      bool child_dirty = false;
+    };
+
+    /// The tiling layout of a single workspace.
+    ///
+    /// Changes only mark the affected containers dirty, and arrange() walks down to those,
+    /// so the cost of a relayout is proportional to the changed subtree, not the workspace.
+    struct Tree {
+      Tree(Workspace& workspace) noexcept;
+
+      auto enabled() const noexcept -> bool;
+      auto set_enabled(bool enabled) -> void;
+
+      /// Add a view next to the focused tile. Returns false if the view stays floating
+      auto insert(View& view) -> bool;
+      auto remove(View& view) -> void;
+
+      auto set_layout(View& view, Layout layout) -> void;
+      /// Put the view in a new container with the given layout
+      auto split(View& view, Layout layout) -> void;
+      auto resize(View& view, float delta) -> void;
+      /// The view in the given direction, if any
+      auto neighbour(View& view, Direction dir) -> View*;
+      auto move(View& view, Direction dir) -> void;
+
+      /// Lay out all dirty containers
+      auto arrange() -> void;
+      /// Raise all of the tab holding the view, in every tabbed container above it, so the
+      /// whole tab shows. Laying out never restacks, this runs when focus or the tabs change
+      auto raise_tabs(View& view) -> void;
+
+      static constexpr int gap = 4;
+      static constexpr int stack_offset = 32;
+
+      Workspace& workspace;
+
+    private:
+      auto layout(Container& con, wlr::box_t box, Transaction& transaction) -> void;
+      auto configure(Container& leaf, Transaction& transaction) -> void;
+      /// Put the tile next to the focused one, without laying it out
+      auto attach_view(View& view) -> bool;
+      auto output_box() -> std::optional<wlr::box_t>;
+      auto detach(Container& con) -> std::unique_ptr<Container>;
+      /// Remove a container if it is empty, or replace it with its child if it only has one
+      auto collapse(Container& con) -> void;
+      auto attach(std::unique_ptr<Container>&& con, Container& parent, std::size_t index)
+        -> Container&;
+
+      std::unique_ptr<Container> _root;
+      bool _enabled = false;
+    };
+
+    auto is_horizontal(Layout) noexcept -> bool;
+    auto parse_layout(std::string_view) -> Layout;
+    auto parse_direction(std::string_view) -> Direction;
+
+  } // namespace tiling
+} // namespace cloth
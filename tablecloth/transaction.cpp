@@ -0,0 +1,187 @@
+#include "transaction.hpp"
+
+#include "util/algorithm.hpp"
+#include "util/logging.hpp"
+
+#include "desktop.hpp"
+#include "output.hpp"
+#include "server.hpp"
+#include "view.hpp"
+
+namespace cloth {
+
+  Transaction::Transaction(Desktop& desktop) noexcept : desktop(desktop) {}
+
+  Transaction::~Transaction() noexcept
+  {
+    if (timer) wl_event_source_remove(timer);
+    for (auto& entry : entries) {
+      if (entry.view->transaction == this) entry.view->transaction = nullptr;
+    }
+  }
+
+  auto Transaction::find(View& view) -> Entry*
+  {
+    auto iter = util::find_if(entries, [&](Entry& e) { return e.view == &view; });
+    return iter == entries.end() ? nullptr : &*iter;
+  }
+
+  auto Transaction::add(View& view, wlr::box_t box) -> void
+  {
+    assert(!committed);
+    if (auto* entry = find(view); entry) {
+      entry->target = box;
+      return;
+    }
+    if (view.get_box() == box) return;
+    entries.push_back({.view = &view, .before = view.get_box(), .target = box});
+  }
+
+  auto Transaction::commit() -> void
+  {
+    assert(!committed);
+
+    for (auto& entry : entries) {
+      View& view = *entry.view;
+      auto& box = entry.target;
+      entry.staged = {(double) box.x, (double) box.y, view.width, view.height};
+      // Pure moves don't need anything from the client
+      entry.acked = box.width == entry.before.width && box.height == entry.before.height;
+      view.transaction = this;
+
+      bool update_x = box.x != entry.before.x;
+      bool update_y = box.y != entry.before.y;
+      if (update_x || update_y) {
+        view.do_move_resize(box.x, box.y, box.width, box.height);
+      } else {
+        view.do_resize(box.width, box.height);
+      }
+    }
+    // Set afterwards, so views staging geometry synchronously can't apply us mid-loop
+    committed = true;
+
+    if (util::all_of(entries, [](Entry& e) { return e.acked; })) {
+      done();
+      return;
+    }
+
+    LOGD("Transaction waiting for {} views", entries.size());
+    timer = wl_event_loop_add_timer(desktop.server.wl_event_loop,
+                                    [](void* data) {
+                                      auto& self = *(Transaction*) data;
+                                      LOGD("Transaction timed out, applying anyway");
+                                      self.done();
+                                      return 0;
+                                    },
+                                    this);
+    wl_event_source_timer_update(timer, timeout.count());
+  }
+
+  auto Transaction::stage(View& view, double x, double y, uint32_t width, uint32_t height, bool acked)
+    -> void
+  {
+    auto* entry = find(view);
+    if (!entry) return;
+    entry->staged = {x, y, width, height};
+    entry->acked = entry->acked || acked;
+
+    if (committed && util::all_of(entries, [](Entry& e) { return e.acked; })) {
+      done();
+    }
+  }
+
+  auto Transaction::remove(View& view) -> void
+  {
+    auto iter = util::find_if(entries, [&](Entry& e) { return e.view == &view; });
+    if (iter == entries.end()) return;
+    if (view.transaction == this) view.transaction = nullptr;
+    entries.erase(iter);
+
+    if (committed && util::all_of(entries, [](Entry& e) { return e.acked; })) {
+      done();
+    }
+  }
+
+  auto Transaction::apply() -> void
+  {
+    for (auto& output : desktop.outputs) {
+      if (affects(output)) output.context.damage_whole();
+    }
+
+    auto applied = std::move(entries);
+    entries.clear();
+    for (auto& entry : applied) {
+      View& view = *entry.view;
+      if (view.transaction == this) view.transaction = nullptr;
+      view.update_size(entry.staged.width, entry.staged.height);
+      view.update_position(entry.staged.x, entry.staged.y);
+      view.update_output(entry.before);
+    }
+  }
+
+  auto Transaction::done() -> void
+  {
+    apply();
+    if (desktop.pending_transaction.get() == this) {
+      // Destroys this
+      auto keep_alive = std::move(desktop.pending_transaction);
+    }
+  }
+
+  auto Transaction::empty() const noexcept -> bool
+  {
+    return entries.empty();
+  }
+
+  auto Transaction::is_committed() const noexcept -> bool
+  {
+    return committed;
+  }
+
+  auto Transaction::affects(Output& output) const -> bool
+  {
+    for (auto& entry : entries) {
+      for (auto box : {entry.before, entry.target}) {
+        if (wlr_output_layout_intersects(desktop.layout, &output.wlr_output, &box)) return true;
+      }
+    }
+    return false;
+  }
+
+  auto Desktop::begin_transaction() -> Transaction&
+  {
+    if (!open_transaction) {
+      open_transaction = std::make_unique<Transaction>(*this);
+    }
+    transaction_depth++;
+    return *open_transaction;
+  }
+
+  auto Desktop::end_transaction() -> void
+  {
+    assert(transaction_depth > 0);
+    if (--transaction_depth > 0) return;
+
+    auto transaction = std::move(open_transaction);
+    if (transaction->empty()) return;
+
+    // Only one transaction waits for acks at a time
+    if (pending_transaction) {
+      auto keep_alive = std::move(pending_transaction);
+      keep_alive->apply();
+    }
+    pending_transaction = std::move(transaction);
+    // May apply and destroy the transaction right away
+    pending_transaction->commit();
+  }
+
+  TransactionScope::TransactionScope(Desktop& desktop)
+    : desktop(desktop), transaction(desktop.begin_transaction())
+  {}
+
+  TransactionScope::~TransactionScope() noexcept
+  {
+    desktop.end_transaction();
+  }
+
+} // namespace cloth
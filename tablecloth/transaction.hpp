@@ -0,0 +1,84 @@
+#pragma once
+
+#include <vector>
+
+#include "util/chrono.hpp"
+
+#include "wlroots.hpp"
+
+namespace cloth {
+
+  struct Desktop;
+  struct Output;
+  struct View;
+
+  /// A set of geometry changes for multiple views, which are applied together.
+  ///
+  /// Configures are sent to all views at once when the transaction is committed. Geometry that
+  /// clients commit in response is staged, and only applied once every view has acked, or the
+  /// timeout expires. Outputs touched by a pending transaction don't render until it is applied,
+  /// so the new layout appears in a single frame.
+  struct Transaction {
+    Transaction(Desktop& desktop) noexcept;
+    ~Transaction() noexcept;
+
+    Transaction(const Transaction&) = delete;
+    Transaction& operator=(const Transaction&) = delete;
+
+    /// Add the geometry a view should end up with. Replaces any box previously added for the view.
+    auto add(View& view, wlr::box_t box) -> void;
+    /// Send configures to all views, and start waiting for acks
+    auto commit() -> void;
+    /// Stage geometry committed by a client. Applies the transaction once all views have acked.
+    auto stage(View& view, double x, double y, uint32_t width, uint32_t height, bool acked)
+      -> void;
+    /// Forget about a view, i.e. because it was unmapped or destroyed
+    auto remove(View& view) -> void;
+    /// Apply the staged geometry of all views, regardless of whether they have acked
+    auto apply() -> void;
+
+    auto empty() const noexcept -> bool;
+    auto is_committed() const noexcept -> bool;
+    /// Does this transaction change any view visible on the given output
+    auto affects(Output& output) const -> bool;
+
+    /// How long to wait for clients before applying anyway
+    static constexpr chrono::milliseconds timeout = chrono::milliseconds(150);
+
+    Desktop& desktop;
+
+  private:
+    struct Entry {
+      View* view;
+      wlr::box_t before;
+      wlr::box_t target;
+      struct {
+        double x, y;
+        uint32_t width, height;
+      } staged;
+      bool acked = true;
+    };
+
+    auto find(View& view) -> Entry*;
+    auto done() -> void;
+
+    std::vector<Entry> entries;
+    bool committed = false;
+    wl::event_source_t* timer = nullptr;
+  };
+
+  /// Batch all geometry changes made while this is alive into a single transaction.
+  ///
+  /// Scopes nest, the transaction is committed when the outermost scope ends.
+  struct TransactionScope {
+    TransactionScope(Desktop& desktop);
+    ~TransactionScope() noexcept;
+
+    TransactionScope(const TransactionScope&) = delete;
+    TransactionScope& operator=(const TransactionScope&) = delete;
+
+    Desktop& desktop;
+    Transaction& transaction;
+  };
+
+} // namespace cloth
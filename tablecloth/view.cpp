@@ -7,6 +7,7 @@
 #include "layers.hpp"
 #include "seat.hpp"
 #include "server.hpp"
+#include "transaction.hpp"
 #include "wlroots.hpp"
 #include "workspace.hpp"
 #include "xcursor.hpp"
@@ -15,7 +16,10 @@
 
 namespace cloth {
 
-  View::View(Workspace& workspace) : workspace(&workspace), desktop(workspace.desktop)
+  static uint32_t next_view_id = 1;
+
+  View::View(Workspace& workspace, ViewType type)
+    : workspace(&workspace), desktop(workspace.desktop), id(next_view_id++), _type(type)
   {
     deco.set_visible(true);
   }
@@ -23,18 +27,19 @@ namespace cloth {
   View::~View() noexcept
   {
     events.destroy.emit();
-    if (wlr_surface) unmap();
+    // Shells unmap their views before destroying them, since unmapping calls into the derived
+    // view, which is already gone here
+    wlr_surface = nullptr;
+    workspace->layout_tree.remove(*this);
+    leave_transactions();
+    desktop.thumbnails.forget(*this);
+    desktop.animations.forget(*this);
   }
 
-  ViewType View::type() noexcept
+  auto View::leave_transactions() -> void
   {
-    if (util::dynamic_is<XdgSurfaceV6>(this)) return ViewType::xdg_shell_v6;
-    if (util::dynamic_is<XdgSurface>(this)) return ViewType::xdg_shell;
-    if (util::dynamic_is<WlShellSurface>(this)) return ViewType::wl_shell;
-#ifdef WLR_HAS_XWAYLAND
-    if (util::dynamic_is<XwaylandSurface>(this)) return ViewType::xwayland;
-#endif
-    assert(false);
+    if (desktop.open_transaction) desktop.open_transaction->remove(*this);
+    if (transaction) transaction->remove(*this);
   }
 
   auto View::is_focused() -> bool
@@ -89,6 +94,13 @@ namespace cloth {
     active = activate;
     do_activate(activate);
     deco.damage();
+    changed();
+  }
+
+  auto View::changed() -> void
+  {
+    desktop.server.window_manager.send_view(*this);
+    desktop.server.foreign_toplevel_manager.update_view(*this);
   }
 
   auto View::resize(int width, int height) -> void
@@ -101,6 +113,7 @@ namespace cloth {
 
   auto View::do_move_resize(double x, double y, int width, int height) -> void
   {
+    do_resize(width, height);
     pending_move_resize.update_x = x != this->x;
     pending_move_resize.update_y = y != this->y;
     pending_move_resize.x = x;
@@ -175,24 +188,21 @@ namespace cloth {
         if (after.width > usable_area.width) after.width = usable_area.width;
         if (after.height > usable_area.height) after.height = usable_area.height;
       }
-      if (after == usable_area && before != usable_area) {
+      if (tile == nullptr && after == usable_area && before != usable_area) {
         maximize(true);
         return;
       }
     }
     LOGD("arrange, box before: {}, box after: {}", before, after);
-    bool update_x = after.x != before.x;
-    bool update_y = after.y != before.y;
-    if (update_x || update_y) {
-      do_move_resize(after.x, after.y, after.width, after.height);
-    } else if (before != after) {
-      do_resize(after.width, after.height);
-      update_output(before);
+    if (before != after) {
+      TransactionScope scope(desktop);
+      scope.transaction.add(*this, after);
     }
   }
 
   auto View::maximize(bool maximized) -> void
   {
+    TransactionScope scope(desktop);
     const auto before = get_box();
     if (this->maximized != maximized) do_maximize(maximized);
 
@@ -210,9 +220,36 @@ namespace cloth {
     if (this->maximized && !maximized) {
       this->maximized = false;
 
-      move_resize(saved);
+      scope.transaction.add(*this, saved);
       rotate(saved.rotation);
     }
+    changed();
+  }
+
+  auto View::minimize(bool minimized) -> void
+  {
+    if (!mapped || this->minimized == minimized) return;
+
+    if (minimized) {
+      desktop.animations.minimize(*this);
+      if (fullscreen_output != nullptr) set_fullscreen(false, nullptr);
+      damage_whole();
+      this->minimized = true;
+      workspace->layout_tree.remove(*this);
+      workspace->view_unmapped(*this);
+      // Hand focus to the next view, like an unmap would
+      for (auto& seat : desktop.server.input.seats) {
+        if (seat.get_focus() == this) seat.set_focus(workspace->focused_view());
+      }
+    } else {
+      this->minimized = false;
+      workspace->view_mapped(*this);
+      workspace->layout_tree.insert(*this);
+      desktop.animations.open(*this);
+      workspace->set_focused_view(this);
+    }
+    desktop.server.input.update_cursor_focus();
+    changed();
   }
 
   auto View::set_fullscreen(bool fullscreen, wlr::output_t* wlr_output) -> void
@@ -223,6 +260,8 @@ namespace cloth {
       return;
     }
 
+    TransactionScope scope(desktop);
+
     // TODO: check if client is focused?
     do_set_fullscreen(fullscreen);
 
@@ -245,7 +284,7 @@ namespace cloth {
       this->saved.height = view_box.height;
 
       auto output_box = *wlr_output_layout_get_box(desktop.layout, wlr_output);
-      move_resize(output_box);
+      scope.transaction.add(*this, output_box);
       rotate(0);
 
       output.workspace->fullscreen_view = this;
@@ -254,13 +293,14 @@ namespace cloth {
     }
 
     if (was_fullscreen && !fullscreen) {
-      move_resize(saved);
+      scope.transaction.add(*this, saved);
       rotate(saved.rotation);
       fullscreen_output->context.damage_whole();
 
       fullscreen_output->workspace->fullscreen_view = nullptr;
       fullscreen_output = nullptr;
     }
+    changed();
   }
 
   auto View::rotate(float rotation) -> void
@@ -328,6 +368,7 @@ namespace cloth {
 
   void ViewChild::handle_commit(void* data)
   {
+    auto timer = view.desktop.server.client_accounting.time(*wlr_surface);
     view.apply_damage();
   }
 
@@ -386,16 +427,29 @@ namespace cloth {
     on_new_subsurface.add_to(wlr_surface->events.new_subsurface);
 
     this->mapped = true;
+    if (workspace) workspace->view_mapped(*this);
     damage_whole();
+    desktop.animations.open(*this);
     desktop.server.input.update_cursor_focus();
+    desktop.server.foreign_toplevel_manager.add_view(*this);
+    changed();
   }
 
   auto View::unmap() -> void
   {
     assert(this->wlr_surface != nullptr);
+    // Take the snapshot while the surfaces still have their buffers
+    if (!minimized) desktop.animations.close(*this);
+    desktop.animations.forget(*this);
+    leave_transactions();
+    workspace->layout_tree.remove(*this);
     this->wlr_surface->data = nullptr;
     this->mapped = false;
+    this->minimized = false;
+    workspace->view_unmapped(*this);
     events.unmap.emit(this);
+    desktop.server.window_manager.send_view_removed(*this);
+    desktop.server.foreign_toplevel_manager.remove_view(*this);
     damage_whole();
 
     on_new_subsurface.remove();
@@ -424,7 +478,8 @@ namespace cloth {
   {
     initial_focus();
 
-    if (fullscreen_output == nullptr && !maximized) {
+    bool tiled = workspace->layout_tree.insert(*this);
+    if (!tiled && fullscreen_output == nullptr && !maximized) {
       center();
     }
     update_output();
@@ -432,7 +487,13 @@ namespace cloth {
 
   auto View::apply_damage() -> void
   {
+    commit_count++;
+    if (minimized) return;
+    if (!desktop.server.client_accounting.allow_repaint(*this)) return;
+    if (desktop.overview.is_active()) desktop.overview.damage_view(*this);
+    desktop.switcher.damage_view(*this);
     for (auto& output : desktop.outputs) {
+      if (desktop.overview.covers(output)) continue;
       output.context.damage_from_view(*this);
     }
   }
@@ -454,6 +515,7 @@ namespace cloth {
     this->x = x;
     this->y = y;
     damage_whole();
+    changed();
   }
 
   auto View::update_size(uint32_t width, uint32_t height) -> void
@@ -466,14 +528,25 @@ namespace cloth {
     this->width = width;
     this->height = height;
     damage_whole();
+    changed();
+  }
+
+  auto View::apply_geometry(double x, double y, uint32_t width, uint32_t height, bool acked)
+    -> void
+  {
+    if (transaction) {
+      transaction->stage(*this, x, y, width, height, acked);
+      return;
+    }
+    update_size(width, height);
+    update_position(x, y);
   }
 
   auto View::at(double lx, double ly, wlr::surface_t*& wlr_surface, double& sx, double& sy) -> bool
   {
     if (!this->wlr_surface || !this->mapped) return false;
-    if (util::dynamic_is<WlShellSurface>(this) &&
-        dynamic_cast<WlShellSurface*>(this)->wl_shell_surface->state ==
-          WLR_WL_SHELL_SURFACE_STATE_POPUP) {
+    if (auto* wl_shell = view_cast<WlShellSurface>(this);
+        wl_shell && wl_shell->wl_shell_surface->state == WLR_WL_SHELL_SURFACE_STATE_POPUP) {
       return false;
     }
 
@@ -498,20 +571,7 @@ namespace cloth {
     }
 
     double _sx, _sy;
-    wlr::surface_t* _surface = nullptr;
-    if (util::dynamic_is<XdgSurfaceV6>(this)) {
-      _surface = wlr_xdg_surface_v6_surface_at(dynamic_cast<XdgSurfaceV6&>(*this).xdg_surface,
-                                               view_sx, view_sy, &_sx, &_sy);
-    } else if (util::dynamic_is<XdgSurface>(this)) {
-      _surface = wlr_xdg_surface_surface_at(dynamic_cast<XdgSurface&>(*this).xdg_surface, view_sx,
-                                            view_sy, &_sx, &_sy);
-#ifdef WLR_HAS_XWAYLAND
-    } else if (util::dynamic_is<XwaylandSurface>(this)) {
-      _surface =
-        wlr_surface_surface_at(dynamic_cast<XwaylandSurface&>(*this).xwayland_surface->surface,
-                               view_sx, view_sy, &_sx, &_sy);
-#endif
-    }
+    wlr::surface_t* _surface = surface_at(view_sx, view_sy, _sx, _sy);
     if (_surface != nullptr) {
       sx = _sx;
       sy = _sy;
@@ -14,9 +14,14 @@ namespace cloth {
 
   struct Output;
   struct Desktop;
+  struct Transaction;
   struct View;
   struct Workspace;
 
+  namespace tiling {
+    struct Container;
+  }
+
   struct ViewChild {
     ViewChild(View& view, wlr::surface_t* wlr_surface);
     virtual ~ViewChild() noexcept;
@@ -82,14 +87,12 @@ namespace cloth {
     wl_shell,
     xdg_shell_v6,
     xdg_shell,
-#ifdef WLR_HAS_XWAYLAND
     xwayland,
-#endif
   };
 
 
   struct View {
-    View(Workspace& workspace);
+    View(Workspace& workspace, ViewType type);
     virtual ~View() noexcept;
 
     wlr::box_t get_box() const;
@@ -99,6 +102,8 @@ namespace cloth {
     void move_resize(double x, double y, int width, int height);
     void move_resize(wlr::box_t);
     void maximize(bool maximized);
+    /// Hide the view from its workspace without unmapping it, or bring it back
+    void minimize(bool minimized);
     void set_fullscreen(bool fullscreen, wlr::output_t* output);
     void rotate(float rotation);
     void cycle_alpha();
@@ -111,6 +116,9 @@ namespace cloth {
     void damage_whole();
     void update_position(double x, double y);
     void update_size(uint32_t width, uint32_t height);
+    /// Apply geometry committed by the client, or stage it if the view is part of a transaction.
+    /// \param acked whether the client has acked all configures sent so far
+    void apply_geometry(double x, double y, uint32_t width, uint32_t height, bool acked);
     void initial_focus();
     void map(wlr::surface_t& surface);
     void unmap();
@@ -119,13 +127,26 @@ namespace cloth {
 
     /// Is this view the currently focused view in its workspace
     bool is_focused();
+    /// Tell IPC clients that the title, geometry or state of the view changed
+    void changed();
 
     ViewChild& create_child(wlr::surface_t&);
     Subsurface& create_subsurface(wlr::subsurface_t& wlr_subsurface);
 
     bool at(double lx, double ly, wlr::surface_t*& surface, double& sx, double& sy);
 
-    ViewType type() noexcept;
+    /// The shell of this view, fixed at construction. Use view_cast instead of dynamic_cast.
+    ViewType type() const noexcept;
+
+    /// Call the iterator for the main surface, its subsurfaces and popups
+    virtual void for_each_surface(wlr_surface_iterator_func_t iterator, void* data) = 0;
+    /// The surface at view-local coordinates, and the coordinates relative to it
+    virtual wlr::surface_t* surface_at(double sx, double sy, double& sub_x, double& sub_y)
+    {
+      return nullptr;
+    }
+    /// Does this view have popups or child windows
+    virtual bool has_popups() = 0;
 
     util::non_null_ptr<Workspace> workspace;
     Desktop& desktop;
@@ -136,12 +157,23 @@ namespace cloth {
     uint32_t width = 0, height = 0;
     float rotation = 0;
     float alpha = 1;
+    /// Incremented whenever a surface of the view commits, so caches can tell when they are stale
+    unsigned commit_count = 0;
 
     bool maximized = false;
+    /// Mapped, but left out of the workspace's visible views
+    bool minimized = false;
+    /// Floating views are never tiled
+    bool floating = false;
 
     Output* fullscreen_output = nullptr;
     wlr::surface_t* wlr_surface = nullptr;
 
+    /// The committed transaction this view is waiting on, if any
+    Transaction* transaction = nullptr;
+    /// The tile holding this view, if it is tiled
+    tiling::Container* tile = nullptr;
+
     util::ptr_vec<ViewChild> children;
 
     struct : wlr::box_t {
@@ -158,6 +190,11 @@ namespace cloth {
     } events;
 
     virtual auto get_name() -> std::string = 0;
+    /// The app id, or the window class for X11 windows
+    virtual auto get_app_id() -> std::string = 0;
+
+    /// Identifies the view over IPC. Never 0, and never reused
+    const uint32_t id;
 
     Decoration deco = {*this};
 
@@ -174,7 +211,12 @@ namespace cloth {
     virtual void do_destroy() {}
 
   private:
+    friend struct Transaction;
+
+    const ViewType _type;
+
     void update_output(std::optional<wlr::box_t> before = std::nullopt) const;
+    void leave_transactions();
     wlr::output_t* get_output();
     void child_handle_commit(void* data);
     void child_handle_new_subsurface(void* data);
@@ -182,13 +224,40 @@ namespace cloth {
 
   };
 
+  /// Cast a view to a shell type, checking its type tag instead of using RTTI.
+  /// Returns nullptr if the view has a different type.
+  template<typename T>
+  T* view_cast(View* view) noexcept
+  {
+    if (view == nullptr || view->type() != T::view_type) return nullptr;
+    return static_cast<T*>(view);
+  }
+
+  template<typename T>
+  T& view_cast(View& view) noexcept
+  {
+    assert(view.type() == T::view_type);
+    return static_cast<T&>(view);
+  }
+
+  inline ViewType View::type() const noexcept
+  {
+    return _type;
+  }
+
   struct WlShellSurface : View {
+    static constexpr ViewType view_type = ViewType::wl_shell;
+
     WlShellSurface(Workspace& workspace, wlr::wl_shell_surface_t* wlr_surface);
     wlr::wl_shell_surface_t* wl_shell_surface;
 
     WlShellPopup& create_popup(wlr::wl_shell_surface_t& wlr_popup);
 
     auto get_name() -> std::string override;
+    auto get_app_id() -> std::string override;
+    void for_each_surface(wlr_surface_iterator_func_t iterator, void* data) override;
+    wlr::surface_t* surface_at(double sx, double sy, double& sub_x, double& sub_y) override;
+    bool has_popups() override;
 
   protected:
     wl::Listener on_destroy;
@@ -206,6 +275,8 @@ namespace cloth {
   };
 
   struct XdgSurfaceV6 : View {
+    static constexpr ViewType view_type = ViewType::xdg_shell_v6;
+
     XdgSurfaceV6(Workspace& workspace, wlr::xdg_surface_v6_t* wlr_surface);
     wlr::xdg_surface_v6_t* xdg_surface;
 
@@ -214,6 +285,10 @@ namespace cloth {
     XdgPopupV6& create_popup(wlr::xdg_popup_v6_t& wlr_popup);
 
     auto get_name() -> std::string override;
+    auto get_app_id() -> std::string override;
+    void for_each_surface(wlr_surface_iterator_func_t iterator, void* data) override;
+    wlr::surface_t* surface_at(double sx, double sy, double& sub_x, double& sub_y) override;
+    bool has_popups() override;
 
   protected:
     wl::Listener on_destroy;
@@ -244,6 +319,8 @@ namespace cloth {
   struct XdgToplevelDecoration;
 
   struct XdgSurface : View {
+    static constexpr ViewType view_type = ViewType::xdg_shell;
+
     XdgSurface(Workspace& workspace, wlr::xdg_surface_t* wlr_surface);
     ~XdgSurface() noexcept;
 
@@ -255,6 +332,10 @@ namespace cloth {
 
     XdgPopup& create_popup(wlr::xdg_popup_t& wlr_popup);
     auto get_name() -> std::string override;
+    auto get_app_id() -> std::string override;
+    void for_each_surface(wlr_surface_iterator_func_t iterator, void* data) override;
+    wlr::surface_t* surface_at(double sx, double sy, double& sub_x, double& sub_y) override;
+    bool has_popups() override;
 
   protected:
     wl::Listener on_destroy;
@@ -264,7 +345,9 @@ namespace cloth {
     wl::Listener on_request_move;
     wl::Listener on_request_resize;
     wl::Listener on_request_maximize;
+    wl::Listener on_request_minimize;
     wl::Listener on_request_fullscreen;
+    wl::Listener on_set_title;
 
     wl::Listener on_surface_commit;
 
@@ -293,6 +376,8 @@ namespace cloth {
   };
 
   struct XwaylandSurface : View {
+    static constexpr ViewType view_type = ViewType::xwayland;
+
     XwaylandSurface(Workspace& workspace, wlr::xwayland_surface_t* wlr_surface);
     wlr::xwayland_surface_t* xwayland_surface;
 
@@ -310,6 +395,10 @@ namespace cloth {
     }
 
     auto get_name() -> std::string override;
+    auto get_app_id() -> std::string override;
+    void for_each_surface(wlr_surface_iterator_func_t iterator, void* data) override;
+    wlr::surface_t* surface_at(double sx, double sy, double& sub_x, double& sub_y) override;
+    bool has_popups() override;
 
   protected:
     wl::Listener on_destroy;
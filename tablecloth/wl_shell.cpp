@@ -20,7 +20,7 @@ namespace cloth {
     on_set_state = [this] { util::erase_this(view.children, this); };
     on_new_popup.add_to(wlr_popup->events.new_popup);
     on_new_popup = [this](void* data) {
-      dynamic_cast<WlShellSurface&>(view).create_popup(*(wlr::wl_shell_surface_t*) data);
+      view_cast<WlShellSurface>(view).create_popup(*(wlr::wl_shell_surface_t*) data);
     };
   }
 
@@ -35,7 +35,7 @@ namespace cloth {
   }
 
   WlShellSurface::WlShellSurface(Workspace& p_workspace, wlr::wl_shell_surface_t* p_wl_shell_surface)
-   : View(p_workspace), wl_shell_surface(p_wl_shell_surface) 
+   : View(p_workspace, view_type), wl_shell_surface(p_wl_shell_surface) 
   {
     View::wlr_surface = wl_shell_surface->surface;
     width = wl_shell_surface->surface->current.width;
@@ -87,12 +87,11 @@ namespace cloth {
 
     on_surface_commit.add_to(wl_shell_surface->surface->events.commit);
     on_surface_commit = [this](void* data) {
+      auto timer = desktop.server.client_accounting.time(*wl_shell_surface->surface);
       apply_damage();
 
       int width = wl_shell_surface->surface->current.width;
       int height = wl_shell_surface->surface->current.height;
-      update_size(width, height);
-
       double x = this->x;
       double y = this->y;
       if (this->pending_move_resize.update_x) {
@@ -103,7 +102,8 @@ namespace cloth {
         y = this->pending_move_resize.y + this->pending_move_resize.height - height;
         this->pending_move_resize.update_y = false;
       }
-      update_position(x, y);
+      // No configure serials here, any commit counts as an ack
+      apply_geometry(x, y, width, height, true);
     };
 
     on_new_popup.add_to(wl_shell_surface->events.new_popup);
@@ -112,7 +112,10 @@ namespace cloth {
     };
 
     on_destroy.add_to(wl_shell_surface->events.destroy);
-    on_destroy = [this] { workspace->erase_view(*this); };
+    on_destroy = [this] {
+      if (mapped) unmap();
+      workspace->erase_view(*this);
+    };
   }
 
   WlShellPopup& WlShellSurface::create_popup(wlr::wl_shell_surface_t& wlr_popup) {
@@ -126,6 +129,26 @@ namespace cloth {
     return util::nonull(wl_shell_surface->title);
   }
 
+  auto WlShellSurface::get_app_id() -> std::string {
+    if (wl_shell_surface == nullptr) return "";
+    return util::nonull(wl_shell_surface->class_);
+  }
+
+  void WlShellSurface::for_each_surface(wlr_surface_iterator_func_t iterator, void* data)
+  {
+    wlr_wl_shell_surface_for_each_surface(wl_shell_surface, iterator, data);
+  }
+
+  wlr::surface_t* WlShellSurface::surface_at(double sx, double sy, double& sub_x, double& sub_y)
+  {
+    return wlr_wl_shell_surface_surface_at(wl_shell_surface, sx, sy, &sub_x, &sub_y);
+  }
+
+  bool WlShellSurface::has_popups()
+  {
+    return !wl_list_empty(&wl_shell_surface->popups);
+  }
+
   void Desktop::handle_wl_shell_surface(void* data)
   {
     auto& surface = *(wlr::wl_shell_surface_t*) data;
@@ -138,7 +161,7 @@ namespace cloth {
     LOGD("new wl shell surface: title={}, class={}", util::nonull(surface.title), util::nonull(surface.class_));
     wlr_wl_shell_surface_ping(&surface);
 
-    auto& workspace = *outputs.front().workspace;
+    auto& workspace = current_workspace();
     auto view_ptr = std::make_unique<WlShellSurface>(workspace, &surface);
     auto& view = *view_ptr;
     workspace.add_view(std::move(view_ptr));
@@ -149,7 +172,7 @@ namespace cloth {
     if (surface.state == WLR_WL_SHELL_SURFACE_STATE_TRANSIENT) {
       // We need to map it relative to the parent
       auto parent = util::find_if(view.workspace->views(), [&] (auto& parent) { 
-        auto* ptr = dynamic_cast<WlShellSurface*>(&parent);
+        auto* ptr = view_cast<WlShellSurface>(&parent);
         return ptr && ptr->wl_shell_surface == surface.parent;
       });
       if (parent != view.workspace->views().end()) {
@@ -46,6 +46,7 @@ extern "C" {
 #include <wlr/backend/libinput.h>
 #include <wlr/backend/multi.h>
 #include <wlr/config.h>
+#include <wlr/render/egl.h>
 #include <wlr/render/wlr_renderer.h>
 #include <wlr/types/wlr_buffer.h>
 #include <wlr/types/wlr_compositor.h>
@@ -65,7 +66,9 @@ extern "C" {
 #include <wlr/types/wlr_output.h>
 #include <wlr/types/wlr_output_damage.h>
 #include <wlr/types/wlr_output_layout.h>
+#include <wlr/types/wlr_pointer_constraints_v1.h>
 #include <wlr/types/wlr_primary_selection.h>
+#include <wlr/types/wlr_relative_pointer_v1.h>
 #include <wlr/types/wlr_screencopy_v1.h>
 #include <wlr/types/wlr_screenshooter.h>
 #include <wlr/types/wlr_seat.h>
@@ -144,6 +147,12 @@ namespace cloth::wlr {
   using event_pointer_button_t = struct wlr_event_pointer_button;
   using event_pointer_motion_absolute_t = struct wlr_event_pointer_motion_absolute;
   using event_pointer_motion_t = struct wlr_event_pointer_motion;
+  using event_pointer_pinch_begin_t = struct wlr_event_pointer_pinch_begin;
+  using event_pointer_pinch_end_t = struct wlr_event_pointer_pinch_end;
+  using event_pointer_pinch_update_t = struct wlr_event_pointer_pinch_update;
+  using event_pointer_swipe_begin_t = struct wlr_event_pointer_swipe_begin;
+  using event_pointer_swipe_end_t = struct wlr_event_pointer_swipe_end;
+  using event_pointer_swipe_update_t = struct wlr_event_pointer_swipe_update;
   using event_tablet_tool_axis_t = struct wlr_event_tablet_tool_axis;
   using event_tablet_tool_tip_t = struct wlr_event_tablet_tool_tip;
   using event_tablet_tool_button_t = struct wlr_event_tablet_tool_button;
@@ -185,9 +194,12 @@ namespace cloth::wlr {
   using output_layout_t = struct wlr_output_layout;
   using output_mode_t = struct wlr_output_mode;
   using output_t = struct wlr_output;
+  using pointer_constraint_v1_t = struct wlr_pointer_constraint_v1;
+  using pointer_constraints_v1_t = struct wlr_pointer_constraints_v1;
   using pointer_impl_t = struct wlr_pointer_impl;
   using pointer_t = struct wlr_pointer;
   using primary_selection_device_manager_t = struct wlr_primary_selection_device_manager;
+  using relative_pointer_manager_v1_t = struct wlr_relative_pointer_manager_v1;
   using renderer_impl_t = struct wlr_renderer_impl;
   using renderer_t = struct wlr_renderer;
   using screencopy_frame_v1_t = struct wlr_screencopy_frame_v1;
@@ -1,6 +1,9 @@
 #include "workspace.hpp"
 
+#include <charconv>
+
 #include "util/chrono.hpp"
+#include "util/exception.hpp"
 #include "util/ptr_vec.hpp"
 
 #include "desktop.hpp"
@@ -16,20 +19,19 @@
 
 namespace cloth {
 
-  util::ref_vec<View> Workspace::visible_views()
+  auto Workspace::focused_view() -> View*
   {
-    return util::view::filter(_views, [](auto& v) { return v.mapped; });
+    return _mapped.empty() ? nullptr : &_mapped.back();
   }
 
-  auto Workspace::focused_view() -> View*
+  auto ShowsWorkspace::operator()(const Output& output) const noexcept -> bool
   {
-    auto visviews = visible_views();
-    return visviews.begin() == visviews.end() ? nullptr : &visviews.back();
+    return output.workspace == workspace;
   }
 
-  auto Workspace::outputs() -> util::ref_vec<Output>
+  auto Workspace::outputs() -> util::view::filter<util::ptr_vec<Output>&, ShowsWorkspace>
   {
-    return util::view::filter(desktop.outputs, [this](Output& o) { return o.workspace == this; });
+    return {desktop.outputs, ShowsWorkspace{this}};
   }
 
   auto Workspace::is_current() -> bool
@@ -39,7 +41,7 @@ namespace cloth {
 
   auto Workspace::is_visible() -> bool
   {
-    return util::any_of(desktop.outputs, [this](Output& o) { return o.workspace == this; });
+    return !outputs().empty();
   }
 
   auto Workspace::set_focused_view(View* view) -> View*
@@ -51,6 +53,8 @@ namespace cloth {
     View* prev_focus = focused_view();
 
     _views.rotate_to_back(*view);
+    _mapped.rotate_to_back(*view);
+    layout_tree.raise_tabs(*view);
 
     if (is_current()) {
       for (auto&& seat : desktop.server.input.seats) {
@@ -61,7 +65,7 @@ namespace cloth {
     bool unfullscreen = true;
 
 #ifdef WLR_HAS_XWAYLAND
-    if (auto* xwl_view = dynamic_cast<XwaylandSurface*>(view);
+    if (auto* xwl_view = view_cast<XwaylandSurface>(view);
         xwl_view && xwl_view->xwayland_surface->override_redirect) {
       unfullscreen = false;
     }
@@ -78,14 +82,18 @@ namespace cloth {
       }
     }
 
-    desktop.server.window_manager.send_focused_window_name(*this);
+    auto& window_manager = desktop.server.window_manager;
+    window_manager.send_focused_window_name(*this);
+    window_manager.send_workspace(*this);
+    if (prev_focus && prev_focus != view) prev_focus->changed();
+    view->changed();
 
     if (view == prev_focus) {
       return view;
     }
 
 #ifdef WLR_HAS_XWAYLAND
-    if (auto* xwl_view = dynamic_cast<XwaylandSurface*>(view);
+    if (auto* xwl_view = view_cast<XwaylandSurface>(view);
         xwl_view && !wlr_xwayland_or_surface_wants_focus(xwl_view->xwayland_surface)) {
       return view;
     }
@@ -96,9 +104,8 @@ namespace cloth {
 
   auto Workspace::cycle_focus() -> View*
   {
-    auto views = visible_views();
-    auto rviews = util::view::reverse(views);
-    if (views.empty()) {
+    auto rviews = util::view::reverse(_mapped);
+    if (_mapped.empty()) {
       return focused_view();
     }
 
@@ -112,23 +119,137 @@ namespace cloth {
       auto nvp = set_focused_view(&*next_view);
       // Move the first view to the front of the list
       _views.rotate_to_front(*first_view);
+      _mapped.rotate_to_front(*first_view);
       return nvp;
     }
     return nullptr;
   }
 
+  auto Workspace::raise(View& view) -> void
+  {
+    _views.rotate_to_back(view);
+    _mapped.rotate_to_back(view);
+    view.damage_whole();
+  }
+
   auto Workspace::add_view(std::unique_ptr<View>&& view_ptr) -> View&
   {
     view_ptr->workspace = this;
     view_ptr->damage_whole();
-    return _views.push_back(std::move(view_ptr));
+    auto& view = _views.push_back(std::move(view_ptr));
+    if (view.mapped && !view.minimized) {
+      _mapped.push_back(view);
+      layout_tree.insert(view);
+      desktop.overview.invalidate();
+    }
+    view.changed();
+    return view;
   }
 
   auto Workspace::erase_view(View& v) -> std::unique_ptr<View>
   {
+    layout_tree.remove(v);
     v.damage_whole();
-    return _views.erase(v);
+    if (_mapped.erase(v)) desktop.overview.invalidate();
+    desktop.switcher.forget(v);
+    auto res = _views.erase(v);
+    if (_views.empty()) desktop.collect_workspaces();
+    return res;
+  }
+
+  auto Workspace::view_mapped(View& v) -> void
+  {
+    if (util::find_if(_mapped, [&](View& m) { return &m == &v; }) != _mapped.end()) return;
+    // Keep the stacking order of _views. Views mapped after v in _views come after it.
+    auto& order = _mapped.underlying();
+    auto pos = order.begin();
+    for (auto& view : _views) {
+      if (&view == &v) break;
+      if (pos != order.end() && *pos == &view) ++pos;
+    }
+    order.insert(pos, &v);
+    desktop.overview.invalidate();
+  }
+
+  auto Workspace::view_unmapped(View& v) -> void
+  {
+    if (_mapped.erase(v)) desktop.overview.invalidate();
+    desktop.switcher.forget(v);
+  }
+
+
+  // Desktop workspace management //
+
+  auto Desktop::find_workspace(int index) -> Workspace*
+  {
+    auto found = workspaces.find(index);
+    return found == workspaces.end() ? nullptr : found->second.get();
+  }
+
+  auto Desktop::get_workspace(int index) -> Workspace&
+  {
+    if (index < 0) throw util::exception("Invalid workspace index {}", index);
+    if (auto* ws = find_workspace(index); ws) return *ws;
+    return create_workspace(index, "");
+  }
+
+  auto Desktop::get_workspace(std::string_view name) -> Workspace&
+  {
+    if (name.empty()) throw util::exception("Workspace name can't be empty");
+    int index = -1;
+    auto [end, err] = std::from_chars(name.data(), name.data() + name.size(), index);
+    if (err == std::errc() && end == name.data() + name.size()) return get_workspace(index);
+
+    auto found = _named_workspaces.find(std::string(name));
+    if (found != _named_workspaces.end()) return *found->second;
+    int max = -1;
+    for (auto& [i, ws] : workspaces) max = std::max(max, i);
+    return create_workspace(max + 1, std::string(name));
+  }
+
+  auto Desktop::create_workspace(int index, std::string name) -> Workspace&
+  {
+    LOGD("Creating workspace {} '{}'", index, name);
+    auto& ws = *workspaces.emplace(index, std::make_unique<Workspace>(*this, index, std::move(name)))
+                  .first->second;
+    if (!ws.name.empty()) _named_workspaces.emplace(ws.name, &ws);
+    server.workspace_manager.send_workspace_added(ws);
+    server.window_manager.send_workspace(ws);
+    overview.invalidate();
+    // Not used yet, clean it up unless something is put on it
+    collect_workspaces();
+    return ws;
+  }
+
+  auto Desktop::collect_workspaces() -> void
+  {
+    if (_collect_idle) return;
+    _collect_idle = wl_event_loop_add_idle(server.wl_event_loop,
+                                           [](void* data) {
+                                             auto& self = *(Desktop*) data;
+                                             self._collect_idle = nullptr;
+                                             self.destroy_unused_workspaces();
+                                           },
+                                           this);
   }
 
+  auto Desktop::destroy_unused_workspaces() -> void
+  {
+    for (auto iter = workspaces.begin(); iter != workspaces.end();) {
+      auto& ws = *iter->second;
+      if (!ws.views().empty() || ws.is_visible()) {
+        ++iter;
+        continue;
+      }
+      LOGD("Destroying workspace {} '{}'", ws.index, ws.name);
+      for (auto& output : outputs) output.forget_workspace(ws);
+      overview.invalidate();
+      if (!ws.name.empty()) _named_workspaces.erase(ws.name);
+      int index = ws.index;
+      iter = workspaces.erase(iter);
+      server.workspace_manager.send_workspace_removed(index);
+      server.window_manager.send_workspace_removed(index);
+    }
+  }
 
 } // namespace cloth
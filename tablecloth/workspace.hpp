@@ -1,28 +1,49 @@
 #pragma once
 
+#include <string>
+
 #include "util/chrono.hpp"
+#include "util/iterators.hpp"
 #include "util/ptr_vec.hpp"
 
 #include "layers.hpp"
+#include "tiling.hpp"
 #include "view.hpp"
 #include "wlroots.hpp"
 
 namespace cloth {
 
   struct Output;
+  struct Workspace;
+
+  /// Matches the outputs a workspace is shown on
+  struct ShowsWorkspace {
+    const Workspace* workspace;
+    auto operator()(const Output& output) const noexcept -> bool;
+  };
 
   struct Workspace {
-    Workspace(Desktop& desktop, int index) : index(index), desktop(desktop){};
+    Workspace(Desktop& desktop, int index, std::string name = "")
+      : index(index), name(std::move(name)), desktop(desktop), layout_tree(*this){};
+
+    Workspace(const Workspace&) = delete;
+    Workspace& operator=(const Workspace&) = delete;
 
     const int index;
+    /// Empty for workspaces only known by their index
+    const std::string name;
     Desktop& desktop;
     View* fullscreen_view = nullptr;
+    tiling::Tree layout_tree;
 
     auto views() const noexcept -> const util::ptr_vec<View>&;
-    auto visible_views() -> util::ref_vec<View>;
+    /// The mapped views in stacking order, topmost last. Kept up to date on map, unmap and
+    /// restack, so iterating it doesn't allocate.
+    auto visible_views() const noexcept -> const util::ref_vec<View>&;
 
-    /// Get all the outputs that this workspace is currently visible on
-    auto outputs() -> util::ref_vec<Output>;
+    /// The outputs that this workspace is currently visible on. A lazy range, so it doesn't
+    /// allocate
+    auto outputs() -> util::view::filter<util::ptr_vec<Output>&, ShowsWorkspace>;
 
     /// Is this the workspace displayed on the currently active output?
     auto is_current() -> bool;
@@ -32,18 +53,31 @@ namespace cloth {
     auto focused_view() -> View*;
     auto set_focused_view(View* view) -> View*;
     auto cycle_focus() -> View*;
+    /// Put a view on top of the others without focusing it
+    auto raise(View& view) -> void;
 
     auto add_view(std::unique_ptr<View>&& v) -> View&;
     auto erase_view(View& v) -> std::unique_ptr<View>;
 
+    /// Called by the view when it is mapped or unmapped, and when it is restored or minimized
+    auto view_mapped(View& v) -> void;
+    auto view_unmapped(View& v) -> void;
+
   private:
     util::ptr_vec<View> _views;
+    /// Subsequence of _views with only the mapped ones that aren't minimized
+    util::ref_vec<View> _mapped;
   };
 
 
   inline auto Workspace::views() const noexcept -> const util::ptr_vec<View>&
   {
     return _views;
-  } 
+  }
+
+  inline auto Workspace::visible_views() const noexcept -> const util::ref_vec<View>&
+  {
+    return _mapped;
+  }
 
 } // namespace cloth
@@ -19,7 +19,7 @@ namespace cloth {
     on_destroy = [this] { util::erase_this(view.children, this); };
     on_new_popup.add_to(wlr_popup->base->events.new_popup);
     on_new_popup = [this](void* data) {
-      dynamic_cast<XdgSurface&>(view).create_popup(*((wlr::xdg_popup_t*) data));
+      view_cast<XdgSurface>(view).create_popup(*((wlr::xdg_popup_t*) data));
     };
     on_unmap.add_to(wlr_popup->base->events.unmap);
     on_unmap = [this] { view.damage_whole(); };
@@ -120,7 +120,17 @@ namespace cloth {
     int constrained_width, constrained_height;
     apply_size_constraints(width, height, constrained_width, constrained_height);
 
-    wlr_xdg_toplevel_set_size(xdg_surface, constrained_width, constrained_height);
+    uint32_t serial = wlr_xdg_toplevel_set_size(xdg_surface, constrained_width, constrained_height);
+    if (serial > 0) {
+      // The commit handler only applies the new size once the client acked it
+      pending_move_resize.update_x = false;
+      pending_move_resize.update_y = false;
+      pending_move_resize.x = x;
+      pending_move_resize.y = y;
+      pending_move_resize.width = constrained_width;
+      pending_move_resize.height = constrained_height;
+      pending_move_resize_configure_serial = serial;
+    }
   }
 
   void XdgSurface::do_move_resize(double x, double y, int width, int height)
@@ -153,7 +163,7 @@ namespace cloth {
     if (serial > 0) {
       pending_move_resize_configure_serial = serial;
     } else if (pending_move_resize_configure_serial == 0) {
-      update_position(x, y);
+      apply_geometry(x, y, this->width, this->height, true);
     }
   }
 
@@ -202,8 +212,33 @@ namespace cloth {
     }
   }
 
+  auto XdgSurface::get_app_id() -> std::string
+  {
+    if (!xdg_surface) return "";
+    if (xdg_surface->role == WLR_XDG_SURFACE_ROLE_TOPLEVEL) {
+      return util::nonull(xdg_surface->toplevel->app_id);
+    } else {
+      return "";
+    }
+  }
+
+  void XdgSurface::for_each_surface(wlr_surface_iterator_func_t iterator, void* data)
+  {
+    wlr_xdg_surface_for_each_surface(xdg_surface, iterator, data);
+  }
+
+  wlr::surface_t* XdgSurface::surface_at(double sx, double sy, double& sub_x, double& sub_y)
+  {
+    return wlr_xdg_surface_surface_at(xdg_surface, sx, sy, &sub_x, &sub_y);
+  }
+
+  bool XdgSurface::has_popups()
+  {
+    return !wl_list_empty(&xdg_surface->popups);
+  }
+
   XdgSurface::XdgSurface(Workspace& p_workspace, wlr::xdg_surface_t* p_xdg_surface)
-    : View(p_workspace), xdg_surface(p_xdg_surface)
+    : View(p_workspace, view_type), xdg_surface(p_xdg_surface)
   {
     View::wlr_surface = xdg_surface->surface;
     xdg_surface->data = this;
@@ -240,6 +275,18 @@ namespace cloth {
       maximize(xdg_surface->toplevel->client_pending.maximized);
     };
 
+    on_request_minimize.add_to(xdg_surface->toplevel->events.request_minimize);
+    on_request_minimize = [this](void* data) {
+      if (xdg_surface->role != WLR_XDG_SURFACE_ROLE_TOPLEVEL) return;
+      minimize(true);
+    };
+
+    on_set_title.add_to(xdg_surface->toplevel->events.set_title);
+    on_set_title = [this] {
+      changed();
+      if (is_focused()) desktop.server.window_manager.send_focused_window_name(*workspace);
+    };
+
     on_request_fullscreen.add_to(xdg_surface->toplevel->events.request_fullscreen);
     on_request_fullscreen = [this](void* data) {
       if (xdg_surface->role != WLR_XDG_SURFACE_ROLE_TOPLEVEL) return;
@@ -250,28 +297,28 @@ namespace cloth {
     on_surface_commit.add_to(xdg_surface->surface->events.commit);
     on_surface_commit = [this](void* data) {
       if (!xdg_surface->mapped) return;
+      auto timer = desktop.server.client_accounting.time(*xdg_surface->surface);
 
       apply_damage();
 
       auto size = get_size();
-      update_size(size.width, size.height);
+      double x = this->x;
+      double y = this->y;
 
       uint32_t pending_serial = pending_move_resize_configure_serial;
       if (pending_serial > 0 && pending_serial >= xdg_surface->configure_serial) {
-        double x = this->x;
-        double y = this->y;
         if (pending_move_resize.update_x) {
           x = pending_move_resize.x + pending_move_resize.width - size.width;
         }
         if (pending_move_resize.update_y) {
           y = pending_move_resize.y + pending_move_resize.height - size.height;
         }
-        update_position(x, y);
 
         if (pending_serial == xdg_surface->configure_serial) {
           pending_move_resize_configure_serial = 0;
         }
       }
+      apply_geometry(x, y, size.width, size.height, pending_move_resize_configure_serial == 0);
     };
 
     on_new_popup.add_to(xdg_surface->events.new_popup);
@@ -292,7 +339,10 @@ namespace cloth {
     on_unmap = [this](void* data) { unmap(); };
 
     on_destroy.add_to(xdg_surface->events.destroy);
-    on_destroy = [this] { workspace->erase_view(*this); };
+    on_destroy = [this] {
+      if (mapped) unmap();
+      workspace->erase_view(*this);
+    };
   }
 
   XdgSurface::~XdgSurface() noexcept
@@ -313,10 +363,10 @@ namespace cloth {
          util::nonull(surface.toplevel->app_id));
     wlr_xdg_surface_ping(&surface);
 
-    auto& workspace = outputs.front().workspace;
-    auto view_ptr = std::make_unique<XdgSurface>(*workspace, &surface);
+    auto& workspace = current_workspace();
+    auto view_ptr = std::make_unique<XdgSurface>(workspace, &surface);
     auto& view = *view_ptr;
-    workspace->add_view(std::move(view_ptr));
+    workspace.add_view(std::move(view_ptr));
 
     if (surface.toplevel->client_pending.maximized) {
       view.maximize(true);
@@ -119,9 +119,31 @@ namespace cloth {
     return "";
   }
 
+  auto XwaylandSurface::get_app_id() -> std::string
+  {
+    if (xwayland_surface) return util::nonull(xwayland_surface->class_);
+    return "";
+  }
+
+  void XwaylandSurface::for_each_surface(wlr_surface_iterator_func_t iterator, void* data)
+  {
+    // Child windows are views of their own
+    wlr_surface_for_each_surface(xwayland_surface->surface, iterator, data);
+  }
+
+  wlr::surface_t* XwaylandSurface::surface_at(double sx, double sy, double& sub_x, double& sub_y)
+  {
+    return wlr_surface_surface_at(xwayland_surface->surface, sx, sy, &sub_x, &sub_y);
+  }
+
+  bool XwaylandSurface::has_popups()
+  {
+    return !wl_list_empty(&xwayland_surface->children);
+  }
+
   XwaylandSurface::XwaylandSurface(Workspace& p_workspace,
                                    wlr::xwayland_surface_t* p_xwayland_surface)
-    : View(p_workspace), xwayland_surface(p_xwayland_surface)
+    : View(p_workspace, view_type), xwayland_surface(p_xwayland_surface)
   {
     View::wlr_surface = xwayland_surface->surface;
     x = xwayland_surface->x;
@@ -167,12 +189,11 @@ namespace cloth {
     // Added/removed on map/unmap
     on_surface_commit = [this](void* data) {
       LOGD("XWL surface committed");
+      auto timer = desktop.server.client_accounting.time(*xwayland_surface->surface);
       apply_damage();
 
       int width = xwayland_surface->surface->current.width;
       int height = xwayland_surface->surface->current.height;
-      update_size(width, height);
-
       double x = this->x;
       double y = this->y;
       if (pending_move_resize.update_x) {
@@ -183,7 +204,8 @@ namespace cloth {
         y = pending_move_resize.y + pending_move_resize.height - height;
         pending_move_resize.update_y = false;
       }
-      update_position(x, y);
+      // No configure serials here, any commit counts as an ack
+      apply_geometry(x, y, width, height, true);
     };
 
     on_map.add_to(xwayland_surface->events.map);
@@ -226,13 +248,15 @@ namespace cloth {
     };
 
     on_set_title.add_to(xwayland_surface->events.set_title);
-    on_set_title = [this](void* data) {
-      workspace->desktop.server.window_manager.send_focused_window_name(*workspace);
+    on_set_title = [this] {
+      changed();
+      if (is_focused()) desktop.server.window_manager.send_focused_window_name(*workspace);
     };
 
     on_destroy.add_to(xwayland_surface->events.destroy);
     on_destroy = [this] {
       LOGD("Destroyed");
+      if (mapped) unmap();
       workspace->erase_view(*this);
     };
   }
@@ -246,8 +270,8 @@ namespace cloth {
          util::nonull(surface.class_), util::nonull(surface.instance));
     wlr_xwayland_surface_ping(&surface);
 
-    auto& output = outputs.front();
-    auto view_ptr = std::make_unique<XwaylandSurface>(*output.workspace, &surface);
-    output.workspace->add_view(std::move(view_ptr));
+    auto& workspace = current_workspace();
+    auto view_ptr = std::make_unique<XwaylandSurface>(workspace, &surface);
+    workspace.add_view(std::move(view_ptr));
   }
 } // namespace cloth